@@ -7,5 +7,6 @@ namespace Artemis.Plugins.Wrappers.Logitech.DataModelExpansion.DataModels
     {
         public SKColor BackgroundColor { get; set; }
         public LogitechKeysDataModel Keys { get; set; } = new();
+        public LogitechZonesDataModel Zones { get; set; } = new();
     }
 }
\ No newline at end of file
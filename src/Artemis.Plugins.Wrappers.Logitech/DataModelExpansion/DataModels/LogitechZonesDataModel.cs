@@ -0,0 +1,6 @@
+﻿using Artemis.Core.DataModelExpansions;
+
+namespace Artemis.Plugins.Wrappers.Logitech.DataModelExpansion.DataModels
+{
+    public class LogitechZonesDataModel : DataModel { }
+}
\ No newline at end of file
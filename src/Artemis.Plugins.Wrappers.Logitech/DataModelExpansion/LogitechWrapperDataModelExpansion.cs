@@ -14,6 +14,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.DataModelExpansion
         private readonly ILogger _logger;
         private readonly LogitechWrapperListenerService _wrapperService;
         private readonly Dictionary<LedId, DynamicChild<SKColor>> _colorsCache = new();
+        private readonly Dictionary<(LogiDeviceType Device, int Zone), DynamicChild<SKColor>> _zoneColorsCache = new();
 
         public LogitechWrapperDataModelExpansion(ILogger logger, LogitechWrapperListenerService service)
         {
@@ -47,6 +48,18 @@ namespace Artemis.Plugins.Wrappers.Logitech.DataModelExpansion
 
                 colorDataModel.Value = item.Value;
             }
+
+            //zones have no leds of their own, profiles pick them up by device and zone number
+            foreach (KeyValuePair<(LogiDeviceType Device, int Zone), SKColor> item in _wrapperService.ZoneColors)
+            {
+                if (!_zoneColorsCache.TryGetValue(item.Key, out DynamicChild<SKColor> colorDataModel))
+                {
+                    colorDataModel = DataModel.Zones.AddDynamicChild<SKColor>($"{item.Key.Device}Zone{item.Key.Zone}", default);
+                    _zoneColorsCache.Add(item.Key, colorDataModel);
+                }
+
+                colorDataModel.Value = item.Value;
+            }
         }
     }
 }
\ No newline at end of file
@@ -34,5 +34,13 @@
         StopEffectsOnKey,
         SetLightingForTargetZone,
         Shutdown,
+        AttachSharedMemory,
+        SetLightingForKeys,
+        Batch,
+        SetLightingFromBitmapDelta,
+        InitAck,
+        SetLightingForKeysCompact,
+        SetLightingForLeds,
+        SetLightingSnapshot,
     }
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+﻿namespace Artemis.Plugins.Wrappers.Logitech.Services
+{
+    /// <summary>
+    /// Header layout of a connection, settled by the handshake on Init.
+    /// </summary>
+    public enum PacketFormat
+    {
+        /// <summary>
+        /// [u32 length][u32 command]
+        /// </summary>
+        Legacy,
+
+        /// <summary>
+        /// [u32 length][u32 command][u32 sequence][i64 QueryPerformanceCounter timestamp]
+        /// </summary>
+        SequenceHeader,
+
+        /// <summary>
+        /// [varint length of the rest][u8 command][u8 low byte of the sequence]
+        /// </summary>
+        Compact
+    }
+}
@@ -0,0 +1,20 @@
+﻿using System;
+
+namespace Artemis.Plugins.Wrappers.Logitech.Services
+{
+    /// <summary>
+    /// Negotiated on Init, must match the FEATURE_ defines of the wrapper dll.
+    /// </summary>
+    [Flags]
+    public enum ProtocolFeatures : uint
+    {
+        None = 0,
+        SequenceHeader = 1 << 0,
+        Batching = 1 << 1,
+        DeltaFrames = 1 << 2,
+        CompactHeader = 1 << 3,
+        SharedMemory = 1 << 4,
+        LedIndex = 1 << 5,
+        Snapshot = 1 << 6,
+    }
+}
\ No newline at end of file
@@ -125,6 +125,130 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             { LogitechLedId.G_BADGE, LedId.Keyboard_Custom1 },
         };
 
+        /// <summary>
+        /// Dense LED index used by SetLightingForLeds. The wrapper dll translates key names, scan codes
+        /// and HID codes to these positions with the same mappings as above, keep both in the same order.
+        /// </summary>
+        internal static readonly LedId[] DenseLedIds =
+        {
+            LedId.Keyboard_Escape,
+            LedId.Keyboard_F1,
+            LedId.Keyboard_F2,
+            LedId.Keyboard_F3,
+            LedId.Keyboard_F4,
+            LedId.Keyboard_F5,
+            LedId.Keyboard_F6,
+            LedId.Keyboard_F7,
+            LedId.Keyboard_F8,
+            LedId.Keyboard_F9,
+            LedId.Keyboard_F10,
+            LedId.Keyboard_F11,
+            LedId.Keyboard_GraveAccentAndTilde,
+            LedId.Keyboard_1,
+            LedId.Keyboard_2,
+            LedId.Keyboard_3,
+            LedId.Keyboard_4,
+            LedId.Keyboard_5,
+            LedId.Keyboard_6,
+            LedId.Keyboard_7,
+            LedId.Keyboard_8,
+            LedId.Keyboard_9,
+            LedId.Keyboard_0,
+            LedId.Keyboard_MinusAndUnderscore,
+            LedId.Keyboard_Tab,
+            LedId.Keyboard_Q,
+            LedId.Keyboard_W,
+            LedId.Keyboard_E,
+            LedId.Keyboard_R,
+            LedId.Keyboard_T,
+            LedId.Keyboard_Y,
+            LedId.Keyboard_U,
+            LedId.Keyboard_I,
+            LedId.Keyboard_O,
+            LedId.Keyboard_P,
+            LedId.Keyboard_BracketLeft,
+            LedId.Keyboard_CapsLock,
+            LedId.Keyboard_A,
+            LedId.Keyboard_S,
+            LedId.Keyboard_D,
+            LedId.Keyboard_F,
+            LedId.Keyboard_G,
+            LedId.Keyboard_H,
+            LedId.Keyboard_J,
+            LedId.Keyboard_K,
+            LedId.Keyboard_L,
+            LedId.Keyboard_SemicolonAndColon,
+            LedId.Keyboard_ApostropheAndDoubleQuote,
+            LedId.Keyboard_LeftShift,
+            LedId.Keyboard_Z,
+            LedId.Keyboard_X,
+            LedId.Keyboard_C,
+            LedId.Keyboard_V,
+            LedId.Keyboard_B,
+            LedId.Keyboard_N,
+            LedId.Keyboard_M,
+            LedId.Keyboard_CommaAndLessThan,
+            LedId.Keyboard_PeriodAndBiggerThan,
+            LedId.Keyboard_SlashAndQuestionMark,
+            LedId.Keyboard_LeftCtrl,
+            LedId.Keyboard_LeftGui,
+            LedId.Keyboard_LeftAlt,
+            LedId.Keyboard_Space,
+            LedId.Keyboard_RightAlt,
+            LedId.Keyboard_RightGui,
+            LedId.Keyboard_Application,
+            LedId.Keyboard_F12,
+            LedId.Keyboard_PrintScreen,
+            LedId.Keyboard_ScrollLock,
+            LedId.Keyboard_PauseBreak,
+            LedId.Keyboard_Insert,
+            LedId.Keyboard_Home,
+            LedId.Keyboard_PageUp,
+            LedId.Keyboard_BracketRight,
+            LedId.Keyboard_NonUsBackslash,
+            LedId.Keyboard_Enter,
+            LedId.Keyboard_EqualsAndPlus,
+            LedId.Keyboard_Backspace,
+            LedId.Keyboard_Delete,
+            LedId.Keyboard_End,
+            LedId.Keyboard_PageDown,
+            LedId.Keyboard_RightShift,
+            LedId.Keyboard_RightCtrl,
+            LedId.Keyboard_ArrowUp,
+            LedId.Keyboard_ArrowLeft,
+            LedId.Keyboard_ArrowDown,
+            LedId.Keyboard_ArrowRight,
+            LedId.Keyboard_NumLock,
+            LedId.Keyboard_NumSlash,
+            LedId.Keyboard_NumAsterisk,
+            LedId.Keyboard_NumMinus,
+            LedId.Keyboard_NumPlus,
+            LedId.Keyboard_NumEnter,
+            LedId.Keyboard_Num7,
+            LedId.Keyboard_Num8,
+            LedId.Keyboard_Num9,
+            LedId.Keyboard_Num4,
+            LedId.Keyboard_Num5,
+            LedId.Keyboard_Num6,
+            LedId.Keyboard_Num1,
+            LedId.Keyboard_Num2,
+            LedId.Keyboard_Num3,
+            LedId.Keyboard_Num0,
+            LedId.Keyboard_NumPeriodAndDelete,
+            LedId.Keyboard_Programmable1,
+            LedId.Keyboard_Programmable2,
+            LedId.Keyboard_Programmable3,
+            LedId.Keyboard_Programmable4,
+            LedId.Keyboard_Programmable5,
+            LedId.Keyboard_Programmable6,
+            LedId.Keyboard_Programmable7,
+            LedId.Keyboard_Programmable8,
+            LedId.Keyboard_Programmable9,
+            LedId.Logo,
+            LedId.Keyboard_Custom1,
+            LedId.Keyboard_Backslash,
+        };
+
         internal static readonly Dictionary<DirectInputScanCode, LedId> DirectInputScanCodes = new()
         {
             [DirectInputScanCode.DIK_ESCAPE] = LedId.Keyboard_Escape,
@@ -4,7 +4,9 @@ using Serilog;
 using SkiaSharp;
 using System;
 using System.Collections.Generic;
+using System.IO;
 using System.IO.Pipes;
+using System.Net.Sockets;
 using System.Security.AccessControl;
 using System.Security.Principal;
 using System.Text;
@@ -19,21 +21,35 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
         private readonly object _lock;
         private readonly List<LogitechWrapperReader> _readers;
         private readonly Dictionary<LedId, SKColor> _colors;
-        private readonly List<LedId> _excluded;
+        private readonly Dictionary<(LogiDeviceType Device, int Zone), SKColor> _zoneColors;
+        //indexed by bitmap key, newer wrappers leave excluded pixels out before sending
+        private readonly bool[] _excludedBitmapKeys;
         private readonly Task _serverLoop;
+        private readonly Task _socketServerLoop;
         private readonly CancellationTokenSource _serverLoopCancellationTokenSource;
+        private bool _bitmapChanged;
 
         private const string PIPE_NAME = "Artemis\\Logitech";
+        private static readonly string SOCKET_PATH = Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.CommonApplicationData), "Artemis", "Logitech.sock");
         private const int LOGI_LED_BITMAP_WIDTH = 21;
         private const int LOGI_LED_BITMAP_HEIGHT = 6;
         private const int LOGI_LED_BITMAP_BYTES_PER_KEY = 4;
 
         private const int LOGI_LED_BITMAP_SIZE = (LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT * LOGI_LED_BITMAP_BYTES_PER_KEY);
+        private const int LOGI_LED_BITMAP_KEYS = LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT;
+        private const int BITMAP_DELTA_MASK_SIZE = (LOGI_LED_BITMAP_KEYS + 7) / 8;
+        private const int KEY_RECORD_SIZE = 8;
+        private const int COMPACT_KEY_RECORD_SIZE = 5;
+        private const int LED_RECORD_SIZE = 4;
+        private const int SNAPSHOT_HEADER_SIZE = 8 + BITMAP_DELTA_MASK_SIZE;
+        private const byte SNAPSHOT_HAS_BACKGROUND = 0x01;
+        private const byte SNAPSHOT_HAS_BITMAP = 0x02;
 
         public event EventHandler BitmapChanged;
         public event EventHandler ClientConnected;
 
         public IReadOnlyDictionary<LedId, SKColor> Colors => _colors;
+        public IReadOnlyDictionary<(LogiDeviceType Device, int Zone), SKColor> ZoneColors => _zoneColors;
         public SKColor BackgroundColor { get; private set; }
         public LogiSetTargetDeviceType DeviceType { get; private set; }
 
@@ -42,10 +58,12 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             _logger = logger;
             _lock = new();
             _colors = new();
+            _zoneColors = new();
             _readers = new();
-            _excluded = new();
+            _excludedBitmapKeys = new bool[LOGI_LED_BITMAP_KEYS];
             _serverLoopCancellationTokenSource = new();
             _serverLoop = Task.Run(ServerLoop);
+            _socketServerLoop = Task.Run(SocketServerLoop);
         }
 
         private async Task ServerLoop()
@@ -61,7 +79,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
 
                     NamedPipeServerStream pipeStream = NamedPipeServerStreamAcl.Create(
                         PIPE_NAME,
-                        PipeDirection.In,
+                        PipeDirection.InOut,
                         NamedPipeServerStream.MaxAllowedServerInstances,
                         PipeTransmissionMode.Byte,
                         PipeOptions.Asynchronous,
@@ -75,11 +93,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
 
                     _logger.Information("Client Connected, starting dedicated reader...");
 
-                    LogitechWrapperReader reader = new LogitechWrapperReader(_logger, pipeStream, new CancellationTokenSource());
-                    reader.CommandReceived += OnCommandReceived;
-                    _readers.Add(reader);
-
-                    ClientConnected?.Invoke(this, EventArgs.Empty);
+                    AddReader(pipeStream);
                 }
                 catch (Exception e)
                 {
@@ -88,40 +102,135 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             }
         }
 
+        private async Task SocketServerLoop()
+        {
+            Socket listener;
+            try
+            {
+                //a socket file left behind by a previous run makes Bind fail
+                File.Delete(SOCKET_PATH);
+                listener = new(AddressFamily.Unix, SocketType.Stream, ProtocolType.Unspecified);
+                listener.Bind(new UnixDomainSocketEndPoint(SOCKET_PATH));
+                listener.Listen();
+            }
+            catch (Exception e)
+            {
+                //AF_UNIX needs Windows 10 1803, clients can still use the pipe
+                _logger.Warning(e, "Could not listen on unix socket {path}", SOCKET_PATH);
+                return;
+            }
+
+            _logger.Information("Listening on unix socket {path}", SOCKET_PATH);
+            using (listener)
+            using (_serverLoopCancellationTokenSource.Token.Register(listener.Dispose))
+            {
+                while (!_serverLoopCancellationTokenSource.IsCancellationRequested)
+                {
+                    try
+                    {
+                        Socket socket = await listener.AcceptAsync().ConfigureAwait(false);
+
+                        _logger.Information("Client Connected over unix socket, starting dedicated reader...");
+
+                        AddReader(new NetworkStream(socket, true));
+                    }
+                    catch (Exception e) when (!_serverLoopCancellationTokenSource.IsCancellationRequested)
+                    {
+                        _logger.Error("Error processing client", e);
+                    }
+                    catch
+                    {
+                        //listener disposed on shutdown
+                    }
+                }
+            }
+
+            try { File.Delete(SOCKET_PATH); } catch { }//ignore
+        }
+
+        private void AddReader(Stream stream)
+        {
+            LogitechWrapperReader reader = new LogitechWrapperReader(_logger, stream, new CancellationTokenSource());
+            reader.CommandReceived += OnCommandReceived;
+            lock (_readers)
+            {
+                _readers.Add(reader);
+            }
+
+            ClientConnected?.Invoke(this, EventArgs.Empty);
+        }
+
         private void OnCommandReceived(object sender, WrapperPacket e)
         {
             lock (_lock)
             {
-                ReadOnlySpan<byte> span = e.Packet.Span;
-                switch (e.Command)
+                HandleCommand(e.Command, e.Packet.Span, e.Format);
+
+                //a batch of commands only recomposites once
+                if (_bitmapChanged)
                 {
-                    case LogitechCommand.Init: Init(span); break;
-                    case LogitechCommand.Shutdown: Shutdown(span); break;
-                    case LogitechCommand.SetTargetDevice: SetTargetDevice(span); break;
-                    case LogitechCommand.SetLighting: SetLighting(span); break;
-                    case LogitechCommand.SetLightingForKeyWithKeyName: SetLightingForKeyWithKeyName(span); break;
-                    case LogitechCommand.SetLightingForKeyWithScanCode: SetLightingForKeyWithScanCode(span); break;
-                    case LogitechCommand.SetLightingForKeyWithHidCode: SetLightingForKeyWithHidCode(span); break;
-                    case LogitechCommand.SetLightingFromBitmap: SetLightingFromBitmap(span); break;
-                    case LogitechCommand.ExcludeKeysFromBitmap: ExcludeKeysFromBitmap(span); break;
-                    default: _logger.Information("Unknown command id: {commandId}.", e.Command); break;
+                    _bitmapChanged = false;
+                    BitmapChanged?.Invoke(this, EventArgs.Empty);
                 }
             }
         }
 
+        private void HandleCommand(LogitechCommand command, ReadOnlySpan<byte> span, PacketFormat format)
+        {
+            switch (command)
+            {
+                case LogitechCommand.Init: Init(span); break;
+                case LogitechCommand.Shutdown: Shutdown(span); break;
+                case LogitechCommand.SetTargetDevice: SetTargetDevice(span); break;
+                case LogitechCommand.SetLighting: SetLighting(span); break;
+                case LogitechCommand.SetLightingForKeyWithKeyName: SetLightingForKeyWithKeyName(span); break;
+                case LogitechCommand.SetLightingForKeyWithScanCode: SetLightingForKeyWithScanCode(span); break;
+                case LogitechCommand.SetLightingForKeyWithHidCode: SetLightingForKeyWithHidCode(span); break;
+                case LogitechCommand.SetLightingForKeys: SetLightingForKeys(span); break;
+                case LogitechCommand.SetLightingForKeysCompact: SetLightingForKeysCompact(span); break;
+                case LogitechCommand.SetLightingForLeds: SetLightingForLeds(span); break;
+                case LogitechCommand.SetLightingFromBitmap: SetLightingFromBitmap(span); break;
+                case LogitechCommand.SetLightingFromBitmapDelta: SetLightingFromBitmapDelta(span); break;
+                case LogitechCommand.ExcludeKeysFromBitmap: ExcludeKeysFromBitmap(span); break;
+                case LogitechCommand.SetLightingForTargetZone: SetLightingForTargetZone(span); break;
+                case LogitechCommand.SetLightingSnapshot: SetLightingSnapshot(span); break;
+                case LogitechCommand.Batch: Batch(span, format); break;
+                default: _logger.Information("Unknown command id: {commandId}.", command); break;
+            }
+        }
+
+        private void Batch(ReadOnlySpan<byte> span, PacketFormat format)
+        {
+            //each sub-command keeps its own header, in the format of the connection
+            while (!span.IsEmpty)
+            {
+                if (!WrapperPacket.TryReadHeader(span, format, out LogitechCommand command, out _, out _, out int headerLength, out int length) || length > span.Length)
+                {
+                    _logger.Error("Malformed batch entry, dropping the rest of the batch");
+                    return;
+                }
+
+                HandleCommand(command, span[headerLength..length], format);
+                span = span[length..];
+            }
+        }
+
         private void Init(ReadOnlySpan<byte> span)
         {
-            _logger.Information("LogiLedInit: {name}", Encoding.UTF8.GetString(span));
+            //the handshake fields after the name are handled by the reader
+            int nameEnd = span.IndexOf((byte)0);
+            _logger.Information("LogiLedInit: {name}", Encoding.UTF8.GetString(nameEnd < 0 ? span : span[..nameEnd]));
         }
 
         private void Shutdown(ReadOnlySpan<byte> span)
         {
             _logger.Information("LogiLedShutdown: {name}", Encoding.UTF8.GetString(span));
-            _excluded.Clear();
+            Array.Clear(_excludedBitmapKeys, 0, _excludedBitmapKeys.Length);
             _colors.Clear();
+            _zoneColors.Clear();
             DeviceType = LogiSetTargetDeviceType.All;
             BackgroundColor = SKColors.Empty;
-            BitmapChanged?.Invoke(this, EventArgs.Empty);
+            _bitmapChanged = true;
         }
 
         private void SetTargetDevice(ReadOnlySpan<byte> span)
@@ -146,7 +255,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             }
 
             _logger.Verbose("SetLighting: {color}", color);
-            BitmapChanged?.Invoke(this, EventArgs.Empty);
+            _bitmapChanged = true;
         }
 
         private void SetLightingForKeyWithKeyName(ReadOnlySpan<byte> span)
@@ -161,7 +270,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             }
 
             _logger.Verbose("SetLightingForKeyWithKeyName: {keyName} ({keyNameIdx}) - {color}", keyName, keyNameIdx, color2);
-            BitmapChanged?.Invoke(this, EventArgs.Empty);
+            _bitmapChanged = true;
         }
 
         private void SetLightingForKeyWithScanCode(ReadOnlySpan<byte> span)
@@ -176,7 +285,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             }
 
             _logger.Verbose("SetLightingForKeyWithScanCode: {scanCode} ({scanCodeIdx}) - {color}", scanCode, scanCodeIdx, color3);
-            BitmapChanged?.Invoke(this, EventArgs.Empty);
+            _bitmapChanged = true;
         }
 
         private void SetLightingForKeyWithHidCode(ReadOnlySpan<byte> span)
@@ -191,23 +300,227 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             }
 
             _logger.Verbose("SetLightingForKeyWithHidCode: {hidCode} ({hidCodeIdx}) - {color}", hidCode, hidCodeIdx, color4);
-            BitmapChanged?.Invoke(this, EventArgs.Empty);
+            _bitmapChanged = true;
         }
 
-        private void SetLightingFromBitmap(ReadOnlySpan<byte> span)
+        private void SetLightingForKeys(ReadOnlySpan<byte> span)
         {
-            for (int i = 0; i < LOGI_LED_BITMAP_SIZE; i += 4)
+            int keyCount = span.Length >= sizeof(int) ? BitConverter.ToInt32(span) : -1;
+            if (keyCount < 0 || (long)keyCount * KEY_RECORD_SIZE > span.Length - sizeof(int))
             {
-                ReadOnlySpan<byte> colorBuff = span.Slice(i, 4);
-                if (LedMapping.BitmapMap.TryGetValue(i, out LedId l) && !_excluded.Contains(l))
+                _logger.Error("Malformed SetLightingForKeys of {keyCount} keys in {length} bytes", keyCount, span.Length);
+                return;
+            }
+
+            for (int i = 0; i < keyCount; i++)
+            {
+                //keyCode (int), original command (byte), r, g, b
+                ReadOnlySpan<byte> record = span.Slice(sizeof(int) + i * KEY_RECORD_SIZE, KEY_RECORD_SIZE);
+                int keyCode = BitConverter.ToInt32(record);
+                SKColor color = FromSpan(record[5..]);
+
+                switch ((LogitechCommand)record[4])
                 {
-                    //BGRA
-                    _colors[l] = new SKColor(colorBuff[2], colorBuff[1], colorBuff[0], colorBuff[3]);
+                    case LogitechCommand.SetLightingForKeyWithKeyName: SetKeyColor(LedMapping.LogitechLedIds, (LogitechLedId)keyCode, color); break;
+                    case LogitechCommand.SetLightingForKeyWithScanCode: SetKeyColor(LedMapping.DirectInputScanCodes, (DirectInputScanCode)keyCode, color); break;
+                    case LogitechCommand.SetLightingForKeyWithHidCode: SetKeyColor(LedMapping.HidCodes, (HidCode)keyCode, color); break;
                 }
             }
+
+            _logger.Verbose("SetLightingForKeys: {keyCount} keys", keyCount);
+            _bitmapChanged = true;
+        }
+
+        private void SetLightingForKeysCompact(ReadOnlySpan<byte> span)
+        {
+            //runs of [original command (byte)][count (byte)] followed by count records of [keyCode (ushort)][r][g][b]
+            int keyCount = 0;
+            while (span.Length >= 2)
+            {
+                LogitechCommand command = (LogitechCommand)span[0];
+                int count = span[1];
+                span = span[2..];
+                if (span.Length < count * COMPACT_KEY_RECORD_SIZE)
+                {
+                    _logger.Error("Malformed compact key run of {count} keys", count);
+                    break;
+                }
+
+                for (int i = 0; i < count; i++)
+                {
+                    ReadOnlySpan<byte> record = span.Slice(i * COMPACT_KEY_RECORD_SIZE, COMPACT_KEY_RECORD_SIZE);
+                    ushort keyCode = BitConverter.ToUInt16(record);
+                    SKColor color = FromSpan(record[2..]);
+
+                    switch (command)
+                    {
+                        case LogitechCommand.SetLightingForKeyWithKeyName: SetKeyColor(LedMapping.LogitechLedIds, (LogitechLedId)keyCode, color); break;
+                        case LogitechCommand.SetLightingForKeyWithScanCode: SetKeyColor(LedMapping.DirectInputScanCodes, (DirectInputScanCode)keyCode, color); break;
+                        case LogitechCommand.SetLightingForKeyWithHidCode: SetKeyColor(LedMapping.HidCodes, (HidCode)keyCode, color); break;
+                    }
+                }
+
+                span = span[(count * COMPACT_KEY_RECORD_SIZE)..];
+                keyCount += count;
+            }
+
+            _logger.Verbose("SetLightingForKeysCompact: {keyCount} keys", keyCount);
+            _bitmapChanged = true;
+        }
+
+        private void SetLightingForLeds(ReadOnlySpan<byte> span)
+        {
+            //records of [dense led index (byte)][r][g][b], the index is resolved by the wrapper
+            if (span.Length % LED_RECORD_SIZE != 0)
+            {
+                _logger.Error("Malformed SetLightingForLeds of {length} bytes", span.Length);
+                return;
+            }
+
+            int ledCount = span.Length / LED_RECORD_SIZE;
+            for (int i = 0; i < ledCount; i++)
+            {
+                ReadOnlySpan<byte> record = span.Slice(i * LED_RECORD_SIZE, LED_RECORD_SIZE);
+                if (record[0] < LedMapping.DenseLedIds.Length)
+                    _colors[LedMapping.DenseLedIds[record[0]]] = FromSpan(record[1..]);
+            }
+
+            _logger.Verbose("SetLightingForLeds: {ledCount} leds", ledCount);
+            _bitmapChanged = true;
+        }
+
+        private void SetLightingForTargetZone(ReadOnlySpan<byte> span)
+        {
+            //deviceType (int), zone (int), r, g, b
+            LogiDeviceType deviceType = (LogiDeviceType)BitConverter.ToInt32(span);
+            int zone = BitConverter.ToInt32(span[4..]);
+            SKColor color = FromSpan(span[8..]);
+
+            _zoneColors[(deviceType, zone)] = color;
+
+            _logger.Verbose("SetLightingForTargetZone: {deviceType} zone {zone} - {color}", deviceType, zone, color);
+            _bitmapChanged = true;
+        }
+
+        private void SetLightingSnapshot(ReadOnlySpan<byte> span)
+        {
+            //targetDevice (int), flags (byte), background r, g, b, exclusion mask with one bit per bitmap key,
+            //then the bitmap when flagged and the key records of SetLightingForKeys.
+            //sent after the wrapper reconnected, it replaces whatever is left of the previous connection
+            if (span.Length < SNAPSHOT_HEADER_SIZE)
+            {
+                _logger.Error("Malformed SetLightingSnapshot of {length} bytes", span.Length);
+                return;
+            }
+
+            LogiSetTargetDeviceType deviceType = (LogiSetTargetDeviceType)BitConverter.ToInt32(span);
+            byte flags = span[4];
+            ReadOnlySpan<byte> mask = span.Slice(8, BITMAP_DELTA_MASK_SIZE);
+            ReadOnlySpan<byte> body = span[SNAPSHOT_HEADER_SIZE..];
+            ReadOnlySpan<byte> bitmap = ReadOnlySpan<byte>.Empty;
+            if ((flags & SNAPSHOT_HAS_BITMAP) != 0)
+            {
+                if (body.Length < LOGI_LED_BITMAP_SIZE)
+                {
+                    _logger.Error("Malformed SetLightingSnapshot bitmap of {length} bytes", body.Length);
+                    return;
+                }
+                bitmap = body[..LOGI_LED_BITMAP_SIZE];
+                body = body[LOGI_LED_BITMAP_SIZE..];
+            }
+
+            //checked up front so a bad snapshot leaves the previous lighting alone
+            int keyCount = body.Length >= sizeof(int) ? BitConverter.ToInt32(body) : -1;
+            if (keyCount < 0 || (long)keyCount * KEY_RECORD_SIZE > body.Length - sizeof(int))
+            {
+                _logger.Error("Malformed SetLightingSnapshot of {keyCount} keys in {length} bytes", keyCount, body.Length);
+                return;
+            }
+
+            _colors.Clear();
+            BackgroundColor = (flags & SNAPSHOT_HAS_BACKGROUND) != 0 ? FromSpan(span[5..]) : SKColors.Empty;
+            for (int i = 0; i < LOGI_LED_BITMAP_KEYS; i++)
+            {
+                _excludedBitmapKeys[i] = (mask[i / 8] & (1 << (i % 8))) != 0;
+            }
+
+            if (!bitmap.IsEmpty)
+            {
+                SetLightingFromBitmap(bitmap);
+            }
+            SetLightingForKeys(body);
+            DeviceType = deviceType;
+
+            _logger.Verbose("SetLightingSnapshot: {deviceType}, flags {flags}", deviceType, flags);
+            _bitmapChanged = true;
+        }
+
+        private void SetKeyColor<T>(Dictionary<T, LedId> mapping, T key, SKColor color)
+        {
+            if (mapping.TryGetValue(key, out LedId idx))
+            {
+                _colors[idx] = color;
+            }
+        }
+
+        private void SetLightingFromBitmap(ReadOnlySpan<byte> span)
+        {
+            for (int i = 0; i < LOGI_LED_BITMAP_SIZE; i += 4)
+            {
+                SetBitmapPixel(i, span.Slice(i, 4));
+            }
             _logger.Verbose("SetLightingFromBitmap");
 
-            BitmapChanged?.Invoke(this, EventArgs.Empty);
+            _bitmapChanged = true;
+        }
+
+        private void SetLightingFromBitmapDelta(ReadOnlySpan<byte> span)
+        {
+            //change mask with one bit per key, followed by the changed pixels in key order
+            if (span.Length < BITMAP_DELTA_MASK_SIZE)
+            {
+                _logger.Error("Malformed SetLightingFromBitmapDelta of {length} bytes", span.Length);
+                return;
+            }
+
+            ReadOnlySpan<byte> mask = span[..BITMAP_DELTA_MASK_SIZE];
+            ReadOnlySpan<byte> pixels = span[BITMAP_DELTA_MASK_SIZE..];
+            int keyCount = 0;
+            for (int i = 0; i < LOGI_LED_BITMAP_KEYS; i++)
+            {
+                if ((mask[i / 8] & (1 << (i % 8))) != 0)
+                    keyCount++;
+            }
+
+            //checked up front so a short packet leaves the bitmap alone
+            if (pixels.Length < keyCount * LOGI_LED_BITMAP_BYTES_PER_KEY)
+            {
+                _logger.Error("Malformed SetLightingFromBitmapDelta of {keyCount} keys in {length} bytes", keyCount, span.Length);
+                return;
+            }
+
+            int pixelPtr = 0;
+
+            for (int i = 0; i < LOGI_LED_BITMAP_KEYS; i++)
+            {
+                if ((mask[i / 8] & (1 << (i % 8))) == 0)
+                    continue;
+
+                SetBitmapPixel(i * LOGI_LED_BITMAP_BYTES_PER_KEY, pixels.Slice(pixelPtr, LOGI_LED_BITMAP_BYTES_PER_KEY));
+                pixelPtr += LOGI_LED_BITMAP_BYTES_PER_KEY;
+            }
+            _logger.Verbose("SetLightingFromBitmapDelta: {keyCount} keys", pixelPtr / LOGI_LED_BITMAP_BYTES_PER_KEY);
+
+            _bitmapChanged = true;
+        }
+
+        private void SetBitmapPixel(int offset, ReadOnlySpan<byte> colorBuff)
+        {
+            if (!_excludedBitmapKeys[offset / LOGI_LED_BITMAP_BYTES_PER_KEY] && LedMapping.BitmapMap.TryGetValue(offset, out LedId l))
+            {
+                //BGRA
+                _colors[l] = new SKColor(colorBuff[2], colorBuff[1], colorBuff[0], colorBuff[3]);
+            }
         }
 
         private void ExcludeKeysFromBitmap(ReadOnlySpan<byte> span)
@@ -216,11 +529,8 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
             for (int i = 0; i < excludeCount; i++)
             {
                 var excludedLogitechLedId = (LogitechLedId)BitConverter.ToInt32(span[(4 + (i * 4))..]);
-                if (!LedMapping.LogitechLedIds.TryGetValue(excludedLogitechLedId, out var excludedLedId))
-                    continue;
-
-                if (!_excluded.Contains(excludedLedId))
-                    _excluded.Add(excludedLedId);
+                if (LedMapping.ReversedBitmapMap.TryGetValue(excludedLogitechLedId, out int excludedOffset))
+                    _excludedBitmapKeys[excludedOffset / LOGI_LED_BITMAP_BYTES_PER_KEY] = true;
             }
         }
 
@@ -231,6 +541,7 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
         {
             _serverLoopCancellationTokenSource.Cancel();
             _serverLoop.Wait();
+            _socketServerLoop.Wait();
             _serverLoopCancellationTokenSource.Dispose();
 
             for (int i = _readers.Count - 1; i >= 0; i--)
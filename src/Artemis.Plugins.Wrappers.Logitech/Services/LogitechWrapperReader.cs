@@ -1,7 +1,7 @@
 ﻿using Serilog;
 using System;
 using System.IO;
-using System.IO.Pipes;
+using System.Text;
 using System.Threading;
 using System.Threading.Tasks;
 
@@ -10,55 +10,201 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
     internal class LogitechWrapperReader : IDisposable
     {
         private readonly ILogger _logger;
-        private readonly NamedPipeServerStream _pipe;
+        private readonly Stream _stream;
         private readonly CancellationTokenSource _cancellationTokenSource;
         private readonly Task _listenerTask;
+        private readonly PacketSequenceTracker _sequenceTracker;
+        private SharedMemoryRingReader _ring;
+        private byte[] _buffer;
+        private PacketFormat _format;
+
+        private const uint PROTOCOL_VERSION = 1;
+        private const ProtocolFeatures SUPPORTED_FEATURES = ProtocolFeatures.SequenceHeader | ProtocolFeatures.Batching | ProtocolFeatures.DeltaFrames | ProtocolFeatures.CompactHeader | ProtocolFeatures.SharedMemory | ProtocolFeatures.LedIndex | ProtocolFeatures.Snapshot;
+        private const int INIT_ACK_SIZE = 16;
 
         public event EventHandler<WrapperPacket> CommandReceived;
 
-        public LogitechWrapperReader(ILogger logger, NamedPipeServerStream pipe, CancellationTokenSource cancellationTokenSource)
+        public LogitechWrapperReader(ILogger logger, Stream stream, CancellationTokenSource cancellationTokenSource)
         {
             _logger = logger;
-            _pipe = pipe;
+            _stream = stream;
             _cancellationTokenSource = cancellationTokenSource;
+            _buffer = new byte[1024];
+            _sequenceTracker = new PacketSequenceTracker();
             _listenerTask = Task.Run(ReadLoop);
         }
 
         public async Task<WrapperPacket> ReadWrapperPacket()
         {
-            byte[] lengthBuffer = new byte[4];
+            int lengthBytes = 0;
+            int packetLength;
+            int minimumLength;
+            if (_format == PacketFormat.Compact)
+            {
+                //compact lengths are varints, read them a byte at a time
+                do
+                {
+                    await ReadExactlyAsync(_buffer, lengthBytes, 1);
+                    lengthBytes++;
+                    packetLength = WrapperPacket.GetPacketLength(_buffer.AsSpan(0, lengthBytes), _format);
+                } while (packetLength == 0);
+                minimumLength = lengthBytes;
+            }
+            else
+            {
+                //the length covers the whole header, anything shorter can't be a packet
+                lengthBytes = sizeof(uint);
+                await ReadExactlyAsync(_buffer, 0, lengthBytes);
+                packetLength = WrapperPacket.GetPacketLength(_buffer.AsSpan(0, lengthBytes), _format);
+                minimumLength = _format == PacketFormat.SequenceHeader ? WrapperPacket.HEADER_SIZE : WrapperPacket.LEGACY_HEADER_SIZE;
+            }
 
-            if (await _pipe.ReadAsync(lengthBuffer, _cancellationTokenSource.Token) != 4)
+            if (packetLength < minimumLength)
             {
-                throw new IOException();
+                throw new IOException($"Invalid packet length {packetLength}");
             }
 
-            uint packetLength = BitConverter.ToUInt32(lengthBuffer, 0);
+            //the packet is handled synchronously before the next read, so one buffer is reused for every packet
+            if (_buffer.Length < packetLength)
+            {
+                byte[] buffer = new byte[packetLength];
+                Buffer.BlockCopy(_buffer, 0, buffer, 0, lengthBytes);
+                _buffer = buffer;
+            }
 
-            byte[] packet = new byte[packetLength - sizeof(uint)];
+            await ReadExactlyAsync(_buffer, lengthBytes, packetLength - lengthBytes);
 
-            if (await _pipe.ReadAsync(packet, _cancellationTokenSource.Token) != packetLength - sizeof(uint))
+            try
             {
-                throw new IOException();
+                return WrapperPacket.FromBuffer(_buffer.AsMemory(0, packetLength), _format);
             }
+            catch (FormatException e)
+            {
+                throw new IOException(e.Message, e);
+            }
+        }
 
-            LogitechCommand commandId = (LogitechCommand)BitConverter.ToUInt32(packet, 0);
-
-            return new WrapperPacket(commandId, packet.AsMemory(4));
+        private async Task ReadExactlyAsync(byte[] buffer, int offset, int count)
+        {
+            int end = offset + count;
+            while (offset < end)
+            {
+                int read = await _stream.ReadAsync(buffer.AsMemory(offset, end - offset), _cancellationTokenSource.Token);
+                if (read == 0)
+                {
+                    throw new IOException();
+                }
+                offset += read;
+            }
         }
 
         private async Task ReadLoop()
         {
-            //read and fill in Program Name.
-            while (!_cancellationTokenSource.IsCancellationRequested && _pipe.IsConnected)
+            try
+            {
+                //read and fill in Program Name.
+                while (!_cancellationTokenSource.IsCancellationRequested)
+                {
+                    WrapperPacket packet = await ReadWrapperPacket();
+                    _sequenceTracker.Track(packet);
+
+                    if (packet.Command == LogitechCommand.Init)
+                        await Negotiate(packet.Packet);
+
+                    if (packet.Command == LogitechCommand.AttachSharedMemory)
+                    {
+                        AttachSharedMemory(packet.Packet.Span);
+                        continue;
+                    }
+
+                    _ring?.Drain();
+                    CommandReceived?.Invoke(this, packet);
+                }
+            }
+            catch (IOException)
+            {
+                //client went away mid-packet
+            }
+            finally
+            {
+                _logger.Information("Client stream disconnected, stopping thread...");
+                DetachSharedMemory();
+                _logger.Information("Received {received} packets, lost {lost}, reordered {reordered}, late {late}, max latency {latency:0.0}ms",
+                    _sequenceTracker.Received, _sequenceTracker.Lost, _sequenceTracker.Reordered, _sequenceTracker.Late, _sequenceTracker.MaxLatencyMs);
+                _stream.Close();
+                await _stream.DisposeAsync();
+            }
+        }
+
+        /// <summary>
+        /// Init carries the program name, then the protocol version and features of the client.
+        /// Clients from before the handshake send only the name and get no reply.
+        /// </summary>
+        private async Task Negotiate(ReadOnlyMemory<byte> init)
+        {
+            int nameEnd = init.Span.IndexOf((byte)0);
+            if (nameEnd < 0 || init.Length - nameEnd - 1 < sizeof(uint) * 2)
             {
-                WrapperPacket packet = await ReadWrapperPacket();
+                _logger.Information("Client does not support the handshake, using the legacy protocol");
+                return;
+            }
+
+            uint version = BitConverter.ToUInt32(init.Span[(nameEnd + 1)..]);
+            ProtocolFeatures features = (ProtocolFeatures)BitConverter.ToUInt32(init.Span[(nameEnd + 1 + sizeof(uint))..]) & SUPPORTED_FEATURES;
+            //everything else builds on the sequence header
+            if (!features.HasFlag(ProtocolFeatures.SequenceHeader))
+                features = ProtocolFeatures.None;
+
+            byte[] reply = new byte[INIT_ACK_SIZE];
+            BitConverter.TryWriteBytes(reply.AsSpan(0), INIT_ACK_SIZE);
+            BitConverter.TryWriteBytes(reply.AsSpan(4), (uint)LogitechCommand.InitAck);
+            BitConverter.TryWriteBytes(reply.AsSpan(8), PROTOCOL_VERSION);
+            BitConverter.TryWriteBytes(reply.AsSpan(12), (uint)features);
+
+            //the client only switches format once it has this reply, and sends nothing in between
+            await _stream.WriteAsync(reply, _cancellationTokenSource.Token);
+            await _stream.FlushAsync(_cancellationTokenSource.Token);
+            if (features.HasFlag(ProtocolFeatures.CompactHeader))
+                _format = PacketFormat.Compact;
+            else if (features.HasFlag(ProtocolFeatures.SequenceHeader))
+                _format = PacketFormat.SequenceHeader;
+
+            _logger.Information("Client speaks protocol version {version}, using features {features}", version, features);
+        }
+
+        private void AttachSharedMemory(ReadOnlySpan<byte> span)
+        {
+            string name = Encoding.UTF8.GetString(span).TrimEnd('\0');
+            DetachSharedMemory();
 
-                CommandReceived?.Invoke(this, packet);
+            try
+            {
+                _ring = new SharedMemoryRingReader(_logger, name, _format);
+                _ring.CommandReceived += OnRingCommandReceived;
+                _logger.Information("Attached to shared memory ring {name}", name);
+            }
+            catch (Exception e)
+            {
+                _logger.Error(e, "Failed to attach to shared memory ring {name}", name);
             }
-            _logger.Information("Pipe stream disconnected, stopping thread...");
-            _pipe.Close();
-            await _pipe.DisposeAsync();
+        }
+
+        private void DetachSharedMemory()
+        {
+            if (_ring == null)
+                return;
+
+            //whatever the client wrote before going away, shutdown included, still counts
+            _ring.Drain();
+            _ring.CommandReceived -= OnRingCommandReceived;
+            _ring.Dispose();
+            _ring = null;
+        }
+
+        private void OnRingCommandReceived(object sender, WrapperPacket packet)
+        {
+            _sequenceTracker.Track(packet);
+            CommandReceived?.Invoke(this, packet);
         }
 
         public void Dispose()
@@ -0,0 +1,89 @@
+﻿using System;
+using System.Diagnostics;
+
+namespace Artemis.Plugins.Wrappers.Logitech.Services
+{
+    /// <summary>
+    /// Turns the sequence numbers and timestamps of one connection into loss, reorder and latency counters.
+    /// The client stamps with QueryPerformanceCounter, which is what Stopwatch uses, so timestamps compare across processes.
+    /// </summary>
+    internal class PacketSequenceTracker
+    {
+        private const int LATE_PACKET_MS = 50;
+        private static readonly long LatePacketTicks = Stopwatch.Frequency * LATE_PACKET_MS / 1000;
+
+        private readonly object _lock = new();
+        private uint _expectedSequence;
+
+        public long Received { get; private set; }
+        public long Lost { get; private set; }
+        public long Reordered { get; private set; }
+        public long Late { get; private set; }
+        public double MaxLatencyMs { get; private set; }
+
+        /// <summary>
+        /// Called from both the pipe and the shared memory reader.
+        /// </summary>
+        public void Track(in WrapperPacket packet)
+        {
+            if (packet.Format == PacketFormat.Legacy)
+                return;
+
+            lock (_lock)
+            {
+                //the envelope is not numbered, its contents are
+                if (packet.Command == LogitechCommand.Batch)
+                    TrackBatch(packet.Packet.Span, packet.Format);
+                else
+                    Track(packet.Sequence, packet.Timestamp, packet.Format);
+            }
+        }
+
+        private void TrackBatch(ReadOnlySpan<byte> span, PacketFormat format)
+        {
+            while (WrapperPacket.TryReadHeader(span, format, out _, out uint sequence, out long timestamp, out _, out int length) && length <= span.Length)
+            {
+                Track(sequence, timestamp, format);
+                span = span[length..];
+            }
+        }
+
+        private void Track(uint sequence, long timestamp, PacketFormat format)
+        {
+            Received++;
+
+            //compact headers carry no timestamp
+            if (format != PacketFormat.Compact)
+            {
+                long latency = Stopwatch.GetTimestamp() - timestamp;
+                if (latency > LatePacketTicks)
+                    Late++;
+                double latencyMs = latency * 1000.0 / Stopwatch.Frequency;
+                if (latencyMs > MaxLatencyMs)
+                    MaxLatencyMs = latencyMs;
+            }
+
+            //signed distance, so a wrapped counter still reads as "ahead".
+            //compact headers only carry the low byte, so gaps are measured within a 256 packet window.
+            int distance = format == PacketFormat.Compact
+                ? (sbyte)(byte)(sequence - _expectedSequence)
+                : (int)(sequence - _expectedSequence);
+            if (distance == 0)
+            {
+                _expectedSequence++;
+            }
+            else if (distance > 0)
+            {
+                Lost += distance;
+                _expectedSequence += (uint)distance + 1;
+            }
+            else
+            {
+                //counted as lost when we skipped past it
+                Reordered++;
+                if (Lost > 0)
+                    Lost--;
+            }
+        }
+    }
+}
@@ -0,0 +1,142 @@
+﻿using Serilog;
+using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Artemis.Plugins.Wrappers.Logitech.Services
+{
+    internal class SharedMemoryRingReader : IDisposable
+    {
+        private const uint RING_MAGIC = 0x41524C47;
+        private const string EVENT_SUFFIX = ".Event";
+        private const int MAGIC_OFFSET = 0;
+        private const int CAPACITY_OFFSET = 4;
+        private const int WRITE_INDEX_OFFSET = 64;
+        private const int READ_INDEX_OFFSET = 128;
+        private const int DATA_OFFSET = 192;
+        private const int IDLE_WAIT_MS = 100;
+
+        private readonly ILogger _logger;
+        private readonly MemoryMappedFile _file;
+        private readonly MemoryMappedViewAccessor _accessor;
+        private readonly EventWaitHandle _dataAvailable;
+        private readonly CancellationTokenSource _cancellationTokenSource;
+        private readonly Task _listenerTask;
+        private readonly object _drainLock;
+        private readonly uint _capacity;
+        private readonly PacketFormat _format;
+        private byte[] _buffer;
+
+        public event EventHandler<WrapperPacket> CommandReceived;
+
+        public SharedMemoryRingReader(ILogger logger, string name, PacketFormat format)
+        {
+            _logger = logger;
+            _format = format;
+            _file = MemoryMappedFile.OpenExisting(name);
+            _accessor = _file.CreateViewAccessor();
+            _dataAvailable = EventWaitHandle.OpenExisting(name + EVENT_SUFFIX);
+
+            if (_accessor.ReadUInt32(MAGIC_OFFSET) != RING_MAGIC)
+            {
+                Dispose(false);
+                throw new InvalidDataException($"Shared memory {name} is not a wrapper ring");
+            }
+
+            _capacity = _accessor.ReadUInt32(CAPACITY_OFFSET);
+            _buffer = new byte[1024];
+            _drainLock = new();
+            _cancellationTokenSource = new();
+            _listenerTask = Task.Factory.StartNew(ReadLoop, TaskCreationOptions.LongRunning);
+        }
+
+        /// <summary>
+        /// Dispatches every packet currently in the ring. Called from the pipe reader too,
+        /// so packets written before a pipe command are handled before it.
+        /// </summary>
+        public void Drain()
+        {
+            lock (_drainLock)
+            {
+                uint read = _accessor.ReadUInt32(READ_INDEX_OFFSET);
+                while (true)
+                {
+                    Interlocked.MemoryBarrier();
+                    uint write = _accessor.ReadUInt32(WRITE_INDEX_OFFSET);
+                    if (read == write)
+                        return;
+
+                    //enough for either length field, the client never splits a packet
+                    int lengthBytes = (int)Math.Min(write - read, WrapperPacket.MAX_VARINT_SIZE);
+                    Copy(read, _buffer, lengthBytes);
+                    int packetLength = WrapperPacket.GetPacketLength(_buffer.AsSpan(0, lengthBytes), _format);
+                    if (packetLength <= 0 || packetLength > write - read)
+                    {
+                        _logger.Error("Corrupt packet of {length} bytes in shared memory ring, skipping to the end", packetLength);
+                        _accessor.Write(READ_INDEX_OFFSET, write);
+                        return;
+                    }
+
+                    if (_buffer.Length < packetLength)
+                        _buffer = new byte[packetLength];
+
+                    Copy(read, _buffer, packetLength);
+                    read += (uint)packetLength;
+
+                    //free the space before dispatching, the packet lives in our buffer now
+                    _accessor.Write(READ_INDEX_OFFSET, read);
+                    Interlocked.MemoryBarrier();
+
+                    CommandReceived?.Invoke(this, WrapperPacket.FromBuffer(_buffer.AsMemory(0, packetLength), _format));
+                }
+            }
+        }
+
+        private void Copy(uint index, byte[] destination, int count)
+        {
+            int position = (int)(index & (_capacity - 1));
+            int firstPart = Math.Min(count, (int)_capacity - position);
+            _accessor.ReadArray(DATA_OFFSET + position, destination, 0, firstPart);
+            if (firstPart < count)
+                _accessor.ReadArray(DATA_OFFSET, destination, firstPart, count - firstPart);
+        }
+
+        private void ReadLoop()
+        {
+            WaitHandle[] waitHandles = { _dataAvailable, _cancellationTokenSource.Token.WaitHandle };
+            while (!_cancellationTokenSource.IsCancellationRequested)
+            {
+                //the client only signals on empty -> non-empty, the timeout covers anything we might miss
+                WaitHandle.WaitAny(waitHandles, IDLE_WAIT_MS);
+                try
+                {
+                    Drain();
+                }
+                catch (Exception e)
+                {
+                    _logger.Error(e, "Error reading from shared memory ring");
+                }
+            }
+        }
+
+        private void Dispose(bool stopListener)
+        {
+            if (stopListener)
+            {
+                _cancellationTokenSource.Cancel();
+                try { _listenerTask.Wait(); } catch { }//ignore
+                _cancellationTokenSource.Dispose();
+            }
+            _dataAvailable.Dispose();
+            _accessor.Dispose();
+            _file.Dispose();
+        }
+
+        public void Dispose()
+        {
+            Dispose(true);
+        }
+    }
+}
@@ -4,13 +4,107 @@ namespace Artemis.Plugins.Wrappers.Logitech.Services
 {
     internal struct WrapperPacket
     {
+        public const int HEADER_SIZE = 20;
+        public const int LEGACY_HEADER_SIZE = 8;
+        public const int MAX_VARINT_SIZE = 5;
+        private const int COMMAND_OFFSET = 4;
+        private const int SEQUENCE_OFFSET = 8;
+        private const int TIMESTAMP_OFFSET = 12;
+
         public LogitechCommand Command { get; init; }
+        public PacketFormat Format { get; init; }
+        public uint Sequence { get; init; }
+        public long Timestamp { get; init; }
         public Memory<byte> Packet { get; init; }
 
-        public WrapperPacket(LogitechCommand command, Memory<byte> packet)
+        public WrapperPacket(LogitechCommand command, PacketFormat format, uint sequence, long timestamp, Memory<byte> packet)
         {
             Command = command;
+            Format = format;
+            Sequence = sequence;
+            Timestamp = timestamp;
             Packet = packet;
         }
+
+        /// <summary>
+        /// Wraps a complete packet, header included. The payload is not copied.
+        /// </summary>
+        public static WrapperPacket FromBuffer(Memory<byte> buffer, PacketFormat format)
+        {
+            if (!TryReadHeader(buffer.Span, format, out LogitechCommand command, out uint sequence, out long timestamp, out int headerLength, out int packetLength) || packetLength != buffer.Length)
+                throw new FormatException($"Malformed {format} packet of {buffer.Length} bytes");
+
+            return new WrapperPacket(command, format, sequence, timestamp, buffer[headerLength..]);
+        }
+
+        /// <summary>
+        /// Total length of the packet at the start of span, header included.
+        /// 0 while span does not hold the whole length field yet, -1 when the length field is malformed.
+        /// </summary>
+        public static int GetPacketLength(ReadOnlySpan<byte> span, PacketFormat format)
+        {
+            if (format != PacketFormat.Compact)
+                return span.Length < sizeof(uint) ? 0 : (int)BitConverter.ToUInt32(span);
+
+            int length = 0;
+            for (int i = 0; i < span.Length; i++)
+            {
+                if (i == MAX_VARINT_SIZE)
+                    return -1;
+
+                length |= (span[i] & 0x7F) << (7 * i);
+                if ((span[i] & 0x80) == 0)
+                    return length + i + 1;
+            }
+            return 0;
+        }
+
+        /// <summary>
+        /// Parses the header at the start of span, which must hold at least the whole header.
+        /// </summary>
+        public static bool TryReadHeader(ReadOnlySpan<byte> span, PacketFormat format, out LogitechCommand command, out uint sequence, out long timestamp, out int headerLength, out int packetLength)
+        {
+            command = default;
+            sequence = 0;
+            timestamp = 0;
+            headerLength = 0;
+            packetLength = GetPacketLength(span, format);
+
+            switch (format)
+            {
+                case PacketFormat.Compact:
+                    if (packetLength <= 0)
+                        return false;
+                    //length, command, sequence
+                    headerLength = VarintSize(span) + 2;
+                    if (packetLength < headerLength || span.Length < headerLength)
+                        return false;
+                    command = (LogitechCommand)span[headerLength - 2];
+                    sequence = span[headerLength - 1];
+                    return true;
+                case PacketFormat.SequenceHeader:
+                    headerLength = HEADER_SIZE;
+                    if (packetLength < headerLength || span.Length < headerLength)
+                        return false;
+                    command = (LogitechCommand)BitConverter.ToUInt32(span[COMMAND_OFFSET..]);
+                    sequence = BitConverter.ToUInt32(span[SEQUENCE_OFFSET..]);
+                    timestamp = BitConverter.ToInt64(span[TIMESTAMP_OFFSET..]);
+                    return true;
+                default:
+                    headerLength = LEGACY_HEADER_SIZE;
+                    if (packetLength < headerLength || span.Length < headerLength)
+                        return false;
+                    command = (LogitechCommand)BitConverter.ToUInt32(span[COMMAND_OFFSET..]);
+                    return true;
+            }
+        }
+
+        private static int VarintSize(ReadOnlySpan<byte> span)
+        {
+            int size = 1;
+            while ((span[size - 1] & 0x80) != 0)
+                size++;
+            return size;
+        }
     }
 }
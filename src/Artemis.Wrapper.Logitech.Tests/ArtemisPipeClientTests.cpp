@@ -0,0 +1,391 @@
+#include "pch.h"
+#include "Test.h"
+#include "ArtemisPipeClient.h"
+#include "ClientStartup.h"
+#include "Constants.h"
+#include "EffectEngine.h"
+#include "FrameCoalescer.h"
+#include "LogiCommands.h"
+#include "PacketCodec.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	const char ProgramName[] = "Test.exe";
+	//[name][terminator][version][features] behind the 8 byte legacy header
+	const unsigned int InitPacketSize = 8 + sizeof(ProgramName) + 8;
+
+	//A loopback that keeps every write and can hold the sender thread in one, like a host that is slow to read.
+	//A held write waits for the gate however long it takes, it never times out into a stall.
+	class GatedTransport : public LoopbackTransport
+	{
+	private:
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _open = true;
+		bool _holding = false;
+	public:
+		std::vector<std::vector<unsigned char>> writes;
+
+		WriteStatus Write(const void* data, unsigned int length, unsigned int timeoutMs) override
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_holding = !_open;
+			_condition.notify_all();
+			_condition.wait(lock, [this] { return _open; });
+			_holding = false;
+
+			writes.emplace_back((const unsigned char*)data, (const unsigned char*)data + length);
+			return LoopbackTransport::Write(data, length, timeoutMs);
+		}
+
+		void Hold()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_open = false;
+		}
+
+		void Release()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_open = true;
+			_condition.notify_all();
+		}
+
+		//returns once the sender thread is stuck in a write
+		void WaitUntilHolding()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this] { return _holding; });
+		}
+	};
+
+	//A host that takes the connection and never answers Init, the slowest way a handshake can fail
+	class SilentTransport : public LoopbackTransport
+	{
+	public:
+		bool Read(void* buffer, unsigned int length, unsigned int timeoutMs) override
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+			return false;
+		}
+	};
+
+	class NullEffectSink : public EffectSink
+	{
+	public:
+		void SetLighting(EffectColor) override {}
+		void SetKey(LogiLed::KeyName, EffectColor) override {}
+		void Flush() override {}
+		bool GetKeyColor(LogiLed::KeyName, EffectColor&) override { return false; }
+		void RestoreLighting() override {}
+	};
+
+	void IgnoreTick()
+	{
+	}
+
+	//The client and everything ClientStartup starts, the way the dll holds them, with a silent host.
+	//The client is too large for the stack.
+	struct SilentStartup {
+		std::unique_ptr<ArtemisPipeClient> client{ new ArtemisPipeClient() };
+		NullEffectSink sink;
+		SteadyEffectClock clock;
+		EffectEngine effectEngine{ sink, clock };
+		std::unique_ptr<FrameCoalescer> frameCoalescer{ new FrameCoalescer(*client) };
+		ClientStartup startup{ *client, *frameCoalescer, effectEngine, nullptr, nullptr, IgnoreTick };
+
+		SilentStartup()
+		{
+			client->SetTransport(std::unique_ptr<Transport>(new SilentTransport()));
+		}
+
+		~SilentStartup()
+		{
+			effectEngine.Stop();
+			frameCoalescer->Stop();
+		}
+	};
+
+	//the resolver is a plain function like the dll's, so the client it connects is kept here
+	ArtemisPipeClient* resolvingClient = nullptr;
+	bool resolved = false;
+	std::mutex resolvedMutex;
+	std::condition_variable resolvedCondition;
+
+	void ResolveSilentClient()
+	{
+		resolvingClient->Connect();
+		std::lock_guard<std::mutex> lock(resolvedMutex);
+		resolved = true;
+		resolvedCondition.notify_all();
+	}
+
+	void WaitUntilResolved()
+	{
+		std::unique_lock<std::mutex> lock(resolvedMutex);
+		resolvedCondition.wait(lock, [] { return resolved; });
+	}
+
+	double ElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//The client is too large for the stack, and owns its transport once connected,
+	//so the loopback is kept as a plain pointer to read its counters.
+	struct LoopbackClient {
+		std::unique_ptr<ArtemisPipeClient> client{ new ArtemisPipeClient() };
+		LoopbackTransport* loopback;
+
+		//the loopback answers with the features Init offers, like a current host would
+		explicit LoopbackClient(unsigned int features, LoopbackTransport* transport = new LoopbackTransport()) : loopback(transport)
+		{
+			const unsigned int version = PROTOCOL_VERSION;
+			PacketSegment payload[3] = {
+				{ ProgramName, sizeof(ProgramName) },
+				{ &version, sizeof(version) },
+				{ &features, sizeof(features) },
+			};
+			client->SetInitPacket(payload, 3);
+			client->SetTransport(std::unique_ptr<Transport>(loopback));
+			client->Connect();
+		}
+
+		~LoopbackClient()
+		{
+			client->Disconnect();
+		}
+
+		//every call a different color, so none of them is suppressed as a repeat
+		void WriteLighting(unsigned int index)
+		{
+			SetLightingPacket::Payload payload;
+			PacketSegment segment = SetLightingPacket::Encode(payload, (unsigned char)index, (unsigned char)(index >> 8), 0);
+			client->Write(SetLightingPacket::command, &segment, 1);
+		}
+	};
+
+	//[u32 length][u32 command][u32 sequence][i64 timestamp] then the payload, false past the end
+	bool ReadStampedPacket(const std::vector<unsigned char>& buff, unsigned int& buffPtr, unsigned int& command, unsigned int& sequence, unsigned int& index)
+	{
+		unsigned int length;
+		if (buffPtr + PACKET_HEADER_SIZE > buff.size()) {
+			return false;
+		}
+		memcpy(&length, &buff[buffPtr], sizeof(length));
+		memcpy(&command, &buff[buffPtr + 4], sizeof(command));
+		memcpy(&sequence, &buff[buffPtr + 8], sizeof(sequence));
+		if (length < PACKET_HEADER_SIZE || buffPtr + length > buff.size()) {
+			return false;
+		}
+
+		//what WriteLighting put in the color
+		index = length >= PACKET_HEADER_SIZE + 2 ? buff[buffPtr + PACKET_HEADER_SIZE] | (buff[buffPtr + PACKET_HEADER_SIZE + 1] << 8) : 0;
+		buffPtr += length;
+		return true;
+	}
+}
+
+TEST(LoopbackCountsLegacyPackets)
+{
+	LoopbackClient loopback(0);
+	CHECK(loopback.client->IsConnected());
+	CHECK(!loopback.client->HasFeature(FEATURE_SEQUENCE_HEADER));
+
+	for (unsigned int i = 0; i < 100; i++) {
+		loopback.WriteLighting(i);
+	}
+	loopback.client->Disconnect();
+
+	//Init, then one write per packet with an 8 byte header and 3 bytes of color
+	CHECK(loopback.client->GetSentPackets() == 100);
+	CHECK(loopback.client->GetDroppedPackets() == 0);
+	CHECK(loopback.loopback->GetPackets() == 101);
+	CHECK(loopback.loopback->GetBytes() == InitPacketSize + 100 * (8 + SetLightingPacket::payloadSize));
+}
+
+TEST(LoopbackCountsStampedPackets)
+{
+	LoopbackClient loopback(FEATURE_SEQUENCE_HEADER);
+	CHECK(loopback.client->HasFeature(FEATURE_SEQUENCE_HEADER));
+	CHECK(!loopback.client->HasFeature(FEATURE_BATCHING));
+
+	for (unsigned int i = 0; i < 100; i++) {
+		loopback.WriteLighting(i);
+	}
+	loopback.client->Disconnect();
+
+	CHECK(loopback.client->GetSentPackets() == 100);
+	CHECK(loopback.loopback->GetPackets() == 101);
+	CHECK(loopback.loopback->GetBytes() == InitPacketSize + 100 * (PACKET_HEADER_SIZE + SetLightingPacket::payloadSize));
+}
+
+TEST(LoopbackNeverSeesSharedMemory)
+{
+	LoopbackClient loopback(FEATURE_SEQUENCE_HEADER | FEATURE_SHARED_MEMORY);
+	CHECK(loopback.client->HasFeature(FEATURE_SEQUENCE_HEADER));
+	CHECK(!loopback.client->HasFeature(FEATURE_SHARED_MEMORY));
+
+	loopback.WriteLighting(1);
+	loopback.client->Disconnect();
+
+	//no AttachSharedMemory went out, the packet took the transport
+	CHECK(loopback.loopback->GetPackets() == 2);
+	CHECK(loopback.client->GetSentPackets() == 1);
+}
+
+TEST(QueueDropsWhatDoesntFitAndKeepsTheRestInOrder)
+{
+	GatedTransport* transport = new GatedTransport();
+	LoopbackClient loopback(FEATURE_SEQUENCE_HEADER, transport);
+
+	//the first packet holds the sender thread, everything after it has to wait in the queue
+	transport->Hold();
+	loopback.WriteLighting(0);
+	transport->WaitUntilHolding();
+
+	//the held packet keeps its slot until the write is over
+	for (unsigned int i = 1; i < PACKET_QUEUE_CAPACITY + 10; i++) {
+		loopback.WriteLighting(i);
+	}
+	CHECK(loopback.client->GetQueueDepth() == PACKET_QUEUE_CAPACITY);
+	CHECK(loopback.client->GetMaxQueueDepth() == PACKET_QUEUE_CAPACITY);
+	CHECK(loopback.client->GetDroppedPackets() == 10);
+
+	transport->Release();
+	loopback.client->Disconnect();
+
+	//Init and the full queue, dropped packets used up the numbers after it
+	CHECK(loopback.client->GetSentPackets() == PACKET_QUEUE_CAPACITY);
+	CHECK(transport->writes.size() == PACKET_QUEUE_CAPACITY + 1);
+	for (unsigned int i = 1; i < transport->writes.size(); i++) {
+		unsigned int buffPtr = 0;
+		unsigned int command = 0, sequence = 0, index = 0;
+		CHECK(ReadStampedPacket(transport->writes[i], buffPtr, command, sequence, index));
+		CHECK(command == LogiCommands::SetLighting && sequence == i - 1 && index == i - 1);
+	}
+}
+
+TEST(DisconnectSendsEverythingQueued)
+{
+	GatedTransport* transport = new GatedTransport();
+	LoopbackClient loopback(FEATURE_SEQUENCE_HEADER, transport);
+
+	transport->Hold();
+	loopback.WriteLighting(0);
+	transport->WaitUntilHolding();
+	for (unsigned int i = 1; i < 50; i++) {
+		loopback.WriteLighting(i);
+	}
+	CHECK(loopback.client->GetQueueDepth() == 50);
+
+	//the host takes the held write only now, Disconnect still has to wait for the other 49
+	transport->Release();
+	loopback.client->Disconnect();
+
+	CHECK(loopback.client->GetQueueDepth() == 0);
+	CHECK(loopback.client->GetSentPackets() == 50);
+	CHECK(loopback.client->GetDroppedPackets() == 0);
+	CHECK(loopback.loopback->GetPackets() == 51);
+}
+
+TEST(PacketsQueuedDuringAWriteGoOutAsOneBatch)
+{
+	GatedTransport* transport = new GatedTransport();
+	LoopbackClient loopback(FEATURE_SEQUENCE_HEADER | FEATURE_BATCHING, transport);
+
+	transport->Hold();
+	loopback.WriteLighting(0);
+	transport->WaitUntilHolding();
+	for (unsigned int i = 1; i <= 10; i++) {
+		loopback.WriteLighting(i);
+	}
+
+	transport->Release();
+	loopback.client->Disconnect();
+
+	CHECK(loopback.client->GetSentPackets() == 11);
+	CHECK(transport->writes.size() == 3);
+	if (transport->writes.size() != 3) {
+		return;
+	}
+
+	//the envelope has no number of its own, its packets keep theirs and their order
+	const std::vector<unsigned char>& batch = transport->writes[2];
+	unsigned int buffPtr = 0;
+	unsigned int command = 0, sequence = 0, index = 0;
+	CHECK(ReadStampedPacket(batch, buffPtr, command, sequence, index));
+	CHECK(command == LogiCommands::Batch && buffPtr == batch.size());
+
+	buffPtr = PACKET_HEADER_SIZE;
+	unsigned int packetCount = 0;
+	while (ReadStampedPacket(batch, buffPtr, command, sequence, index)) {
+		packetCount++;
+		CHECK(command == LogiCommands::SetLighting && sequence == packetCount && index == packetCount);
+	}
+	CHECK(packetCount == 10 && buffPtr == batch.size());
+}
+
+//The whole client on a game thread, with every feature a current host offers and nothing behind the transport.
+//Batching folds whatever queued up during a write into one, so writes per packet shows how much it saved.
+BENCHMARK(ClientOverLoopback)
+{
+	const unsigned int packetCount = 200000;
+	LoopbackClient loopback(FEATURE_SEQUENCE_HEADER | FEATURE_BATCHING | FEATURE_DELTA_FRAMES | FEATURE_COMPACT_HEADER | FEATURE_LED_INDEX | FEATURE_SNAPSHOT);
+
+	const double ns = MeasureNs(packetCount, [&](unsigned int i) {
+		loopback.WriteLighting(i);
+	});
+	loopback.client->Disconnect();
+
+	const unsigned long long sent = loopback.client->GetSentPackets();
+	const unsigned long long writes = loopback.loopback->GetPackets() - 1;
+	CHECK(sent + loopback.client->GetDroppedPackets() == packetCount);
+
+	const std::string extra =
+		std::to_string(sent) + " sent in " + std::to_string(writes) + " writes, " +
+		std::to_string(loopback.loopback->GetBytes()) + " bytes, max queue depth " + std::to_string(loopback.client->GetMaxQueueDepth());
+	ReportBenchmark("client over loopback, ns/packet", ns, extra.c_str());
+}
+
+//How long LogiLedInitWithName keeps the game when the host takes the pipe but never answers, timed on the
+//ClientStartup the dll calls. Before, Init connected right after Prepare on the game's thread and waited out
+//the handshake, then went on to the registry and LoadLibrary for the original dll, which only the real dll can measure.
+BENCHMARK(InitWithAnUnreachableHost)
+{
+	const unsigned int iterations = 3;
+
+	double connectMs = 0;
+	for (unsigned int i = 0; i < iterations; i++) {
+		SilentStartup startup;
+		const auto start = std::chrono::steady_clock::now();
+		startup.startup.Prepare(ProgramName, ProgramName);
+		startup.client->Connect();
+		connectMs += ElapsedMs(start);
+		CHECK(!startup.client->IsConnected());
+	}
+
+	double initMs = 0;
+	for (unsigned int i = 0; i < iterations; i++) {
+		SilentStartup startup;
+		resolvingClient = startup.client.get();
+		resolved = false;
+
+		const auto start = std::chrono::steady_clock::now();
+		startup.startup.Start(ProgramName, ProgramName, ResolveSilentClient);
+		initMs += ElapsedMs(start);
+
+		//the resolver still waits out the handshake, only the game no longer does
+		WaitUntilResolved();
+		CHECK(!startup.client->IsConnected());
+	}
+
+	const std::string extra = "Init returned after " + std::to_string(initMs / iterations) + " ms, "
+		"connecting on the game's thread took " + std::to_string(connectMs / iterations) + " ms";
+	ReportBenchmark("init with an unreachable host, ns/init", initMs / iterations * 1000000, extra.c_str());
+}
\ No newline at end of file
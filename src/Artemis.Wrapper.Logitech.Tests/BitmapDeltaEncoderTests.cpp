@@ -0,0 +1,200 @@
+#include "pch.h"
+#include "Test.h"
+#include "BitmapDeltaEncoder.h"
+#include "Constants.h"
+#include "LogiCommands.h"
+#include <string>
+
+namespace {
+	//The host's side: a keyframe replaces the bitmap, a delta patches the pixels set in its mask.
+	void ApplyPacket(unsigned char bitmap[], unsigned int command, const PacketSegment& payload)
+	{
+		const unsigned char* data = (const unsigned char*)payload.data;
+		if (command == LogiCommands::SetLightingFromBitmap) {
+			memcpy(bitmap, data, LOGI_LED_BITMAP_SIZE);
+			return;
+		}
+
+		unsigned int buffPtr = BITMAP_DELTA_MASK_SIZE;
+		for (unsigned int key = 0; key < LOGI_LED_BITMAP_KEYS; key++) {
+			if ((data[key / 8] & (1 << (key % 8))) != 0) {
+				memcpy(&bitmap[key * LOGI_LED_BITMAP_BYTES_PER_KEY], &data[buffPtr], LOGI_LED_BITMAP_BYTES_PER_KEY);
+				buffPtr += LOGI_LED_BITMAP_BYTES_PER_KEY;
+			}
+		}
+	}
+
+	void SetPixel(unsigned char bitmap[], unsigned int key, unsigned char blue, unsigned char green, unsigned char red)
+	{
+		unsigned char* pixel = &bitmap[key * LOGI_LED_BITMAP_BYTES_PER_KEY];
+		pixel[0] = blue;
+		pixel[1] = green;
+		pixel[2] = red;
+		pixel[3] = 0xFF;
+	}
+
+	//frame is the frame number, the traces are what games send most
+	typedef void (*TraceFunction)(unsigned char bitmap[], unsigned int frame);
+
+	//a static layout where an ammo counter or health bar changes a few keys per frame
+	void CounterTrace(unsigned char bitmap[], unsigned int frame)
+	{
+		for (unsigned int i = 0; i < 3; i++) {
+			SetPixel(bitmap, 1 + i, 0, (unsigned char)(frame * 7 + i), 0xFF);
+		}
+	}
+
+	//one key lights up per keystroke and fades out over the next frames
+	void TypingTrace(unsigned char bitmap[], unsigned int frame)
+	{
+		const unsigned int key = (frame / 8 * 37) % LOGI_LED_BITMAP_KEYS;
+		SetPixel(bitmap, key, 0, 0, (unsigned char)(0xFF - frame % 8 * 32));
+	}
+
+	//a color wave moving one column per frame, every key changes
+	void WaveTrace(unsigned char bitmap[], unsigned int frame)
+	{
+		for (unsigned int key = 0; key < LOGI_LED_BITMAP_KEYS; key++) {
+			const unsigned int phase = (key % LOGI_LED_BITMAP_WIDTH + frame) * 12;
+			SetPixel(bitmap, key, (unsigned char)phase, (unsigned char)(phase + 85), (unsigned char)(phase + 170));
+		}
+	}
+
+	//the game draws the same bitmap every frame
+	void StaticTrace(unsigned char bitmap[], unsigned int frame)
+	{
+		SetPixel(bitmap, 0, 0x20, 0x40, 0x60);
+	}
+}
+
+TEST(DeltasRebuildEveryBitmap)
+{
+	BitmapDeltaEncoder encoder;
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned char host[LOGI_LED_BITMAP_SIZE] = {};
+	const TraceFunction traces[] = { CounterTrace, TypingTrace, WaveTrace };
+
+	for (unsigned int frame = 0; frame < 300; frame++) {
+		traces[frame / 100](bitmap, frame);
+
+		unsigned int command;
+		PacketSegment payload;
+		if (encoder.Encode(bitmap, true, false, command, payload)) {
+			ApplyPacket(host, command, payload);
+		}
+		CHECK(memcmp(bitmap, host, LOGI_LED_BITMAP_SIZE) == 0);
+	}
+}
+
+TEST(UnchangedBitmapSendsNothing)
+{
+	BitmapDeltaEncoder encoder;
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned int command;
+	PacketSegment payload;
+
+	CHECK(encoder.Encode(bitmap, true, false, command, payload));
+	CHECK(command == LogiCommands::SetLightingFromBitmap);
+	CHECK(!encoder.Encode(bitmap, true, false, command, payload));
+
+	SetPixel(bitmap, 5, 1, 2, 3);
+	CHECK(encoder.Encode(bitmap, true, false, command, payload));
+	CHECK(command == LogiCommands::SetLightingFromBitmapDelta);
+	CHECK(payload.length == BITMAP_DELTA_MASK_SIZE + LOGI_LED_BITMAP_BYTES_PER_KEY);
+}
+
+TEST(KeyframesComeBackOnTheirOwn)
+{
+	BitmapDeltaEncoder encoder;
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned int command;
+	PacketSegment payload;
+	unsigned int keyframes = 0;
+
+	//a keyframe is followed by BITMAP_KEYFRAME_INTERVAL deltas
+	for (unsigned int frame = 0; frame <= (BITMAP_KEYFRAME_INTERVAL + 1) * 2; frame++) {
+		CounterTrace(bitmap, frame);
+		CHECK(encoder.Encode(bitmap, true, false, command, payload));
+		if (command == LogiCommands::SetLightingFromBitmap) {
+			keyframes++;
+		}
+	}
+	CHECK(keyframes == 3);
+
+	CounterTrace(bitmap, 0);
+	CHECK(encoder.Encode(bitmap, true, true, command, payload));
+	CHECK(command == LogiCommands::SetLightingFromBitmap);
+}
+
+TEST(ExcludedKeysNeverReachTheHost)
+{
+	BitmapDeltaEncoder encoder;
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned char host[LOGI_LED_BITMAP_SIZE] = {};
+	CHECK(encoder.Exclude(2));
+	CHECK(!encoder.Exclude(2));
+
+	for (unsigned int frame = 0; frame <= BITMAP_KEYFRAME_INTERVAL + 1; frame++) {
+		CounterTrace(bitmap, frame);
+
+		unsigned int command;
+		PacketSegment payload;
+		CHECK(encoder.Encode(bitmap, true, false, command, payload));
+		CHECK(command == LogiCommands::SetLightingFromBitmapDelta);
+		ApplyPacket(host, command, payload);
+	}
+
+	const unsigned int excluded = 2 * LOGI_LED_BITMAP_BYTES_PER_KEY;
+	const unsigned int included = 1 * LOGI_LED_BITMAP_BYTES_PER_KEY;
+	CHECK(host[excluded + 3] == 0);
+	CHECK(memcmp(&host[included], &bitmap[included], LOGI_LED_BITMAP_BYTES_PER_KEY) == 0);
+}
+
+//Bytes on the wire and encode time per SetLightingFromBitmap call, the full path being the 504 byte
+//bitmap copied into a queue slot. Both count the 8 byte legacy header.
+BENCHMARK(DeltaVersusFullBitmaps)
+{
+	const unsigned int frameCount = 100000;
+	const unsigned int headerSize = sizeof(unsigned int) * 2;
+	const struct {
+		const char* name;
+		TraceFunction trace;
+	} traces[] = {
+		{ "counter", CounterTrace },
+		{ "typing", TypingTrace },
+		{ "wave", WaveTrace },
+		{ "static", StaticTrace },
+	};
+
+	for (const auto& trace : traces) {
+		//the traces are drawn up front so only the encoder is timed
+		static unsigned char frames[256][LOGI_LED_BITMAP_SIZE];
+		unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+		for (unsigned int frame = 0; frame < 256; frame++) {
+			trace.trace(bitmap, frame);
+			memcpy(frames[frame], bitmap, LOGI_LED_BITMAP_SIZE);
+		}
+
+		BitmapDeltaEncoder encoder;
+		unsigned long long deltaBytes = 0;
+		const double deltaNs = MeasureNs(frameCount, [&](unsigned int frame) {
+			unsigned int command;
+			PacketSegment payload;
+			if (encoder.Encode(frames[frame % 256], true, false, command, payload)) {
+				deltaBytes += headerSize + payload.length;
+				KeepResult(payload.data);
+			}
+		});
+
+		unsigned char slot[LOGI_LED_BITMAP_SIZE];
+		const double fullNs = MeasureNs(frameCount, [&](unsigned int frame) {
+			memcpy(slot, frames[frame % 256], LOGI_LED_BITMAP_SIZE);
+			KeepResult(slot);
+		});
+
+		const std::string deltaName = std::string(trace.name) + " delta, ns/frame";
+		const std::string fullName = std::string(trace.name) + " full, ns/frame";
+		ReportBenchmark(deltaName.c_str(), deltaNs, (std::to_string(deltaBytes / frameCount) + " bytes/frame").c_str());
+		ReportBenchmark(fullName.c_str(), fullNs, (std::to_string(headerSize + LOGI_LED_BITMAP_SIZE) + " bytes/frame").c_str());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "Test.h"
+#include "BitmapKernel.h"
+#include "PacketCodec.h"
+#include <string>
+
+namespace {
+	//xorshift, so every run compares the same bitmaps
+	unsigned int NextRandom(unsigned int& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	//changes a random number of pixels, sometimes only one byte of them
+	void Mutate(unsigned char bitmap[], unsigned int& state)
+	{
+		const unsigned int changes = NextRandom(state) % 16;
+		for (unsigned int i = 0; i < changes; i++) {
+			const unsigned int key = NextRandom(state) % LOGI_LED_BITMAP_KEYS;
+			const unsigned int channel = NextRandom(state) % LOGI_LED_BITMAP_BYTES_PER_KEY;
+			bitmap[key * LOGI_LED_BITMAP_BYTES_PER_KEY + channel] ^= (unsigned char)(1 << (NextRandom(state) % 8));
+		}
+	}
+
+	//what dllmain did before the kernel, truncating a double
+	unsigned char PercentToByteDouble(int percentage)
+	{
+		return (unsigned char)((double)percentage / 100.0 * 255.0);
+	}
+}
+
+TEST(VectorDiffMatchesScalar)
+{
+	unsigned char previous[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned char excluded[BITMAP_DELTA_MASK_SIZE] = {};
+	unsigned int state = 0x2545F491;
+
+	for (unsigned int frame = 0; frame < 2000; frame++) {
+		memcpy(previous, bitmap, LOGI_LED_BITMAP_SIZE);
+		Mutate(bitmap, state);
+		//the last pixels are in the scalar tail of both vector paths
+		if (frame % 10 == 0) {
+			bitmap[LOGI_LED_BITMAP_SIZE - 1]++;
+		}
+		if (frame % 100 == 0) {
+			excluded[NextRandom(state) % BITMAP_DELTA_MASK_SIZE] ^= (unsigned char)(1 << (NextRandom(state) % 8));
+		}
+
+		unsigned char vectorMask[BITMAP_DELTA_MASK_SIZE];
+		unsigned char scalarMask[BITMAP_DELTA_MASK_SIZE];
+		const unsigned int vectorCount = DiffBitmap(bitmap, previous, excluded, vectorMask);
+		const unsigned int scalarCount = DiffBitmapScalar(bitmap, previous, excluded, scalarMask);
+		CHECK(vectorCount == scalarCount);
+		CHECK(memcmp(vectorMask, scalarMask, BITMAP_DELTA_MASK_SIZE) == 0);
+	}
+}
+
+TEST(DiffCountsOnlyKeysThatAreNotExcluded)
+{
+	unsigned char previous[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	unsigned char excluded[BITMAP_DELTA_MASK_SIZE] = {};
+	unsigned char mask[BITMAP_DELTA_MASK_SIZE];
+
+	bitmap[0 * LOGI_LED_BITMAP_BYTES_PER_KEY] = 1;
+	bitmap[9 * LOGI_LED_BITMAP_BYTES_PER_KEY + 3] = 1;
+	bitmap[(LOGI_LED_BITMAP_KEYS - 1) * LOGI_LED_BITMAP_BYTES_PER_KEY + 2] = 1;
+	excluded[9 / 8] = 1 << (9 % 8);
+
+	CHECK(DiffBitmap(bitmap, previous, excluded, mask) == 2);
+	CHECK(mask[0] == 0x01);
+	CHECK(mask[1] == 0x00);
+	CHECK(mask[(LOGI_LED_BITMAP_KEYS - 1) / 8] == 1 << ((LOGI_LED_BITMAP_KEYS - 1) % 8));
+}
+
+TEST(PercentagesRoundToTheNearestByte)
+{
+	CHECK(PercentToByte(-5) == 0);
+	CHECK(PercentToByte(0) == 0);
+	CHECK(PercentToByte(1) == 3);
+	CHECK(PercentToByte(50) == 128);
+	CHECK(PercentToByte(99) == 252);
+	CHECK(PercentToByte(100) == 255);
+	CHECK(PercentToByte(150) == 255);
+
+	//the original dll gets back what the game set
+	for (int percentage = 0; percentage <= 100; percentage++) {
+		CHECK(ByteToPercent(PercentToByte(percentage)) == percentage);
+	}
+}
+
+//One diff per SetLightingFromBitmap call, on the path DiffBitmap picked for this CPU and on the scalar one.
+BENCHMARK(VectorVersusScalarDiff)
+{
+	const unsigned int iterations = 1000000;
+	static unsigned char frames[64][LOGI_LED_BITMAP_SIZE];
+	unsigned char excluded[BITMAP_DELTA_MASK_SIZE] = {};
+	unsigned char mask[BITMAP_DELTA_MASK_SIZE];
+	unsigned int state = 0x2545F491;
+	for (unsigned int frame = 1; frame < 64; frame++) {
+		memcpy(frames[frame], frames[frame - 1], LOGI_LED_BITMAP_SIZE);
+		Mutate(frames[frame], state);
+	}
+
+	unsigned long long changed = 0;
+	const double vectorNs = MeasureNs(iterations, [&](unsigned int i) {
+		changed += DiffBitmap(frames[(i + 1) % 64], frames[i % 64], excluded, mask);
+		KeepResult(mask);
+	});
+	const double scalarNs = MeasureNs(iterations, [&](unsigned int i) {
+		changed += DiffBitmapScalar(frames[(i + 1) % 64], frames[i % 64], excluded, mask);
+		KeepResult(mask);
+	});
+	KeepResult(&changed);
+	ReportBenchmark("selected diff, ns/bitmap", vectorNs, nullptr);
+	ReportBenchmark("scalar diff, ns/bitmap", scalarNs, nullptr);
+
+	//three channels per call, like every color the game passes in
+	unsigned char colors[3];
+	const double integerNs = MeasureNs(iterations, [&](unsigned int i) {
+		colors[0] = PercentToByte(i % 101);
+		colors[1] = PercentToByte((i + 33) % 101);
+		colors[2] = PercentToByte((i + 66) % 101);
+		KeepResult(colors);
+	});
+	const double doubleNs = MeasureNs(iterations, [&](unsigned int i) {
+		colors[0] = PercentToByteDouble(i % 101);
+		colors[1] = PercentToByteDouble((i + 33) % 101);
+		colors[2] = PercentToByteDouble((i + 66) % 101);
+		KeepResult(colors);
+	});
+	ReportBenchmark("integer percent, ns/color", integerNs, nullptr);
+	ReportBenchmark("double percent, ns/color", doubleNs, nullptr);
+}
\ No newline at end of file
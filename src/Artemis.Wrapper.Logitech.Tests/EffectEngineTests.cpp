@@ -0,0 +1,199 @@
+#include "pch.h"
+#include "Test.h"
+#include "EffectEngine.h"
+
+namespace {
+	struct KeyWrite {
+		LogiLed::KeyName keyName;
+		EffectColor color;
+	};
+
+	class RecordingSink : public EffectSink
+	{
+	public:
+		std::vector<EffectColor> lighting;
+		std::vector<KeyWrite> keys;
+		unsigned int flushes = 0;
+		unsigned int restores = 0;
+		bool hasKeyColor = false;
+		EffectColor keyColor = {};
+
+		void SetLighting(EffectColor color) override
+		{
+			lighting.push_back(color);
+		}
+
+		void SetKey(LogiLed::KeyName keyName, EffectColor color) override
+		{
+			keys.push_back({ keyName, color });
+		}
+
+		void Flush() override
+		{
+			flushes++;
+		}
+
+		bool GetKeyColor(LogiLed::KeyName, EffectColor& color) override
+		{
+			color = keyColor;
+			return hasKeyColor;
+		}
+
+		void RestoreLighting() override
+		{
+			restores++;
+		}
+	};
+
+	const EffectColor Red = { 255, 0, 0 };
+	const EffectColor Green = { 0, 255, 0 };
+	const EffectColor Blue = { 0, 0, 255 };
+	const EffectColor Gray = { 10, 20, 30 };
+}
+
+static bool SameColor(EffectColor a, EffectColor b)
+{
+	return a.red == b.red && a.green == b.green && a.blue == b.blue;
+}
+
+TEST(FlashLightingFollowsTheClock)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	engine.SetBaseLighting(Gray);
+	//on for 100ms, off for 100ms, for a second
+	engine.FlashLighting(Red, 1000, 100);
+
+	engine.Tick();
+	CHECK(sink.lighting.size() == 1 && SameColor(sink.lighting.back(), Red));
+
+	//colors that didn't change aren't sent again
+	clock.Advance(50);
+	engine.Tick();
+	CHECK(sink.lighting.size() == 1);
+
+	clock.Advance(100);
+	engine.Tick();
+	CHECK(sink.lighting.size() == 2 && SameColor(sink.lighting.back(), Gray));
+
+	clock.Advance(100);
+	engine.Tick();
+	CHECK(sink.lighting.size() == 3 && SameColor(sink.lighting.back(), Red));
+	CHECK(sink.restores == 0);
+}
+
+TEST(FinishedLightingEffectRestoresTheState)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	engine.FlashLighting(Red, 300, 100);
+	engine.Tick();
+	const size_t sent = sink.lighting.size();
+
+	clock.Advance(300);
+	engine.Tick();
+
+	//the sink puts the game's state back, no single color is sent over it
+	CHECK(sink.restores == 1);
+	CHECK(sink.lighting.size() == sent);
+
+	clock.Advance(100);
+	engine.Tick();
+	CHECK(sink.restores == 1);
+}
+
+TEST(StopEffectsEndsOnTheNextTick)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	engine.PulseLighting(Blue, LOGI_LED_DURATION_INFINITE, 200);
+	engine.Tick();
+	CHECK(sink.restores == 0);
+
+	engine.StopEffects();
+	engine.Tick();
+	CHECK(sink.restores == 1);
+}
+
+TEST(KeyFlashReturnsToTheKeysOwnColor)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	engine.SetBaseLighting(Gray);
+	sink.hasKeyColor = true;
+	sink.keyColor = Green;
+	engine.FlashKey(LogiLed::ESC, Blue, 400, 100);
+
+	engine.Tick();
+	CHECK(sink.keys.size() == 1 && SameColor(sink.keys.back().color, Blue));
+
+	clock.Advance(100);
+	engine.Tick();
+	CHECK(sink.keys.size() == 2 && SameColor(sink.keys.back().color, Green));
+
+	clock.Advance(300);
+	engine.Tick();
+	CHECK(sink.keys.back().keyName == LogiLed::ESC && SameColor(sink.keys.back().color, Green));
+	CHECK(sink.restores == 0);
+}
+
+TEST(KeyWithoutColorReturnsToTheBackground)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	engine.SetBaseLighting(Gray);
+	engine.FlashKey(LogiLed::ESC, Blue, 200, 100);
+
+	engine.Tick();
+	clock.Advance(200);
+	engine.Tick();
+	CHECK(!sink.keys.empty() && SameColor(sink.keys.back().color, Gray));
+}
+
+TEST(ZeroLengthKeyPulseEnds)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	sink.hasKeyColor = true;
+	sink.keyColor = Green;
+	engine.PulseKey(LogiLed::ESC, Red, Blue, 0, false);
+	engine.Tick();
+
+	clock.Advance(1);
+	engine.Tick();
+	CHECK(!sink.keys.empty() && SameColor(sink.keys.back().color, Green));
+	//the key's slot is free again, nothing is left for the tick thread to draw
+	CHECK(!engine.SetBaseKey(LogiLed::ESC, Gray));
+}
+
+TEST(KeyColorSetDuringEffectIsWhatItEndsOn)
+{
+	RecordingSink sink;
+	VirtualEffectClock clock;
+	EffectEngine engine(sink, clock);
+
+	sink.hasKeyColor = true;
+	sink.keyColor = Green;
+	engine.PulseKey(LogiLed::ESC, Red, Blue, 100, true);
+	engine.Tick();
+
+	//the game recolors the key underneath the effect
+	CHECK(engine.SetBaseKey(LogiLed::ESC, Gray));
+
+	engine.StopEffectsOnKey(LogiLed::ESC);
+	engine.Tick();
+	CHECK(!sink.keys.empty() && SameColor(sink.keys.back().color, Gray));
+	CHECK(!engine.SetBaseKey(LogiLed::ESC, Gray));
+}
\ No newline at end of file
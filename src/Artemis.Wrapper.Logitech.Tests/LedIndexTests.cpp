@@ -0,0 +1,546 @@
+#include "pch.h"
+#include "Test.h"
+#include "LedIndex.h"
+#include "LogiCommands.h"
+#include <string.h>
+
+namespace {
+	struct HostMapping {
+		int code;
+		//the RGB.NET LedId the host sets for the code
+		const char* ledId;
+	};
+
+	//Copied from the host's LedMapping.cs, the wrapper's dense indices have to land on the same LEDs.
+	//LedMapping.DenseLedIds, a LED's dense index is its position here
+	const char* const DenseLedIds[] = {
+		"Keyboard_Escape",
+		"Keyboard_F1",
+		"Keyboard_F2",
+		"Keyboard_F3",
+		"Keyboard_F4",
+		"Keyboard_F5",
+		"Keyboard_F6",
+		"Keyboard_F7",
+		"Keyboard_F8",
+		"Keyboard_F9",
+		"Keyboard_F10",
+		"Keyboard_F11",
+		"Keyboard_GraveAccentAndTilde",
+		"Keyboard_1",
+		"Keyboard_2",
+		"Keyboard_3",
+		"Keyboard_4",
+		"Keyboard_5",
+		"Keyboard_6",
+		"Keyboard_7",
+		"Keyboard_8",
+		"Keyboard_9",
+		"Keyboard_0",
+		"Keyboard_MinusAndUnderscore",
+		"Keyboard_Tab",
+		"Keyboard_Q",
+		"Keyboard_W",
+		"Keyboard_E",
+		"Keyboard_R",
+		"Keyboard_T",
+		"Keyboard_Y",
+		"Keyboard_U",
+		"Keyboard_I",
+		"Keyboard_O",
+		"Keyboard_P",
+		"Keyboard_BracketLeft",
+		"Keyboard_CapsLock",
+		"Keyboard_A",
+		"Keyboard_S",
+		"Keyboard_D",
+		"Keyboard_F",
+		"Keyboard_G",
+		"Keyboard_H",
+		"Keyboard_J",
+		"Keyboard_K",
+		"Keyboard_L",
+		"Keyboard_SemicolonAndColon",
+		"Keyboard_ApostropheAndDoubleQuote",
+		"Keyboard_LeftShift",
+		"Keyboard_Z",
+		"Keyboard_X",
+		"Keyboard_C",
+		"Keyboard_V",
+		"Keyboard_B",
+		"Keyboard_N",
+		"Keyboard_M",
+		"Keyboard_CommaAndLessThan",
+		"Keyboard_PeriodAndBiggerThan",
+		"Keyboard_SlashAndQuestionMark",
+		"Keyboard_LeftCtrl",
+		"Keyboard_LeftGui",
+		"Keyboard_LeftAlt",
+		"Keyboard_Space",
+		"Keyboard_RightAlt",
+		"Keyboard_RightGui",
+		"Keyboard_Application",
+		"Keyboard_F12",
+		"Keyboard_PrintScreen",
+		"Keyboard_ScrollLock",
+		"Keyboard_PauseBreak",
+		"Keyboard_Insert",
+		"Keyboard_Home",
+		"Keyboard_PageUp",
+		"Keyboard_BracketRight",
+		"Keyboard_NonUsBackslash",
+		"Keyboard_Enter",
+		"Keyboard_EqualsAndPlus",
+		"Keyboard_Backspace",
+		"Keyboard_Delete",
+		"Keyboard_End",
+		"Keyboard_PageDown",
+		"Keyboard_RightShift",
+		"Keyboard_RightCtrl",
+		"Keyboard_ArrowUp",
+		"Keyboard_ArrowLeft",
+		"Keyboard_ArrowDown",
+		"Keyboard_ArrowRight",
+		"Keyboard_NumLock",
+		"Keyboard_NumSlash",
+		"Keyboard_NumAsterisk",
+		"Keyboard_NumMinus",
+		"Keyboard_NumPlus",
+		"Keyboard_NumEnter",
+		"Keyboard_Num7",
+		"Keyboard_Num8",
+		"Keyboard_Num9",
+		"Keyboard_Num4",
+		"Keyboard_Num5",
+		"Keyboard_Num6",
+		"Keyboard_Num1",
+		"Keyboard_Num2",
+		"Keyboard_Num3",
+		"Keyboard_Num0",
+		"Keyboard_NumPeriodAndDelete",
+		"Keyboard_Programmable1",
+		"Keyboard_Programmable2",
+		"Keyboard_Programmable3",
+		"Keyboard_Programmable4",
+		"Keyboard_Programmable5",
+		"Keyboard_Programmable6",
+		"Keyboard_Programmable7",
+		"Keyboard_Programmable8",
+		"Keyboard_Programmable9",
+		"Logo",
+		"Keyboard_Custom1",
+		"Keyboard_Backslash",
+	};
+
+	//LedMapping.LogitechLedIds
+	const HostMapping HostKeyNames[] = {
+		{ 0x01, "Keyboard_Escape" }, //ESC
+		{ 0x3B, "Keyboard_F1" }, //F1
+		{ 0x3C, "Keyboard_F2" }, //F2
+		{ 0x3D, "Keyboard_F3" }, //F3
+		{ 0x3E, "Keyboard_F4" }, //F4
+		{ 0x3F, "Keyboard_F5" }, //F5
+		{ 0x40, "Keyboard_F6" }, //F6
+		{ 0x41, "Keyboard_F7" }, //F7
+		{ 0x42, "Keyboard_F8" }, //F8
+		{ 0x43, "Keyboard_F9" }, //F9
+		{ 0x44, "Keyboard_F10" }, //F10
+		{ 0x57, "Keyboard_F11" }, //F11
+		{ 0x29, "Keyboard_GraveAccentAndTilde" }, //TILDE
+		{ 0x02, "Keyboard_1" }, //ONE
+		{ 0x03, "Keyboard_2" }, //TWO
+		{ 0x04, "Keyboard_3" }, //THREE
+		{ 0x05, "Keyboard_4" }, //FOUR
+		{ 0x06, "Keyboard_5" }, //FIVE
+		{ 0x07, "Keyboard_6" }, //SIX
+		{ 0x08, "Keyboard_7" }, //SEVEN
+		{ 0x09, "Keyboard_8" }, //EIGHT
+		{ 0x0A, "Keyboard_9" }, //NINE
+		{ 0x0B, "Keyboard_0" }, //ZERO
+		{ 0x0C, "Keyboard_MinusAndUnderscore" }, //MINUS
+		{ 0x0F, "Keyboard_Tab" }, //TAB
+		{ 0x10, "Keyboard_Q" }, //Q
+		{ 0x11, "Keyboard_W" }, //W
+		{ 0x12, "Keyboard_E" }, //E
+		{ 0x13, "Keyboard_R" }, //R
+		{ 0x14, "Keyboard_T" }, //T
+		{ 0x15, "Keyboard_Y" }, //Y
+		{ 0x16, "Keyboard_U" }, //U
+		{ 0x17, "Keyboard_I" }, //I
+		{ 0x18, "Keyboard_O" }, //O
+		{ 0x19, "Keyboard_P" }, //P
+		{ 0x1A, "Keyboard_BracketLeft" }, //OPEN_BRACKET
+		{ 0x3A, "Keyboard_CapsLock" }, //CAPS_LOCK
+		{ 0x1E, "Keyboard_A" }, //A
+		{ 0x1F, "Keyboard_S" }, //S
+		{ 0x20, "Keyboard_D" }, //D
+		{ 0x21, "Keyboard_F" }, //F
+		{ 0x22, "Keyboard_G" }, //G
+		{ 0x23, "Keyboard_H" }, //H
+		{ 0x24, "Keyboard_J" }, //J
+		{ 0x25, "Keyboard_K" }, //K
+		{ 0x26, "Keyboard_L" }, //L
+		{ 0x27, "Keyboard_SemicolonAndColon" }, //SEMICOLON
+		{ 0x28, "Keyboard_ApostropheAndDoubleQuote" }, //APOSTROPHE
+		{ 0x2A, "Keyboard_LeftShift" }, //LEFT_SHIFT
+		{ 0x2C, "Keyboard_Z" }, //Z
+		{ 0x2D, "Keyboard_X" }, //X
+		{ 0x2E, "Keyboard_C" }, //C
+		{ 0x2F, "Keyboard_V" }, //V
+		{ 0x30, "Keyboard_B" }, //B
+		{ 0x31, "Keyboard_N" }, //N
+		{ 0x32, "Keyboard_M" }, //M
+		{ 0x33, "Keyboard_CommaAndLessThan" }, //COMMA
+		{ 0x34, "Keyboard_PeriodAndBiggerThan" }, //PERIOD
+		{ 0x35, "Keyboard_SlashAndQuestionMark" }, //FORWARD_SLASH
+		{ 0x1D, "Keyboard_LeftCtrl" }, //LEFT_CONTROL
+		{ 0x15B, "Keyboard_LeftGui" }, //LEFT_WINDOWS
+		{ 0x38, "Keyboard_LeftAlt" }, //LEFT_ALT
+		{ 0x39, "Keyboard_Space" }, //SPACE
+		{ 0x138, "Keyboard_RightAlt" }, //RIGHT_ALT
+		{ 0x15C, "Keyboard_RightGui" }, //RIGHT_WINDOWS
+		{ 0x15D, "Keyboard_Application" }, //APPLICATION_SELECT
+		{ 0x58, "Keyboard_F12" }, //F12
+		{ 0x137, "Keyboard_PrintScreen" }, //PRINT_SCREEN
+		{ 0x46, "Keyboard_ScrollLock" }, //SCROLL_LOCK
+		{ 0x145, "Keyboard_PauseBreak" }, //PAUSE_BREAK
+		{ 0x152, "Keyboard_Insert" }, //INSERT
+		{ 0x147, "Keyboard_Home" }, //HOME
+		{ 0x149, "Keyboard_PageUp" }, //PAGE_UP
+		{ 0x1B, "Keyboard_BracketRight" }, //CLOSE_BRACKET
+		{ 0x2B, "Keyboard_NonUsBackslash" }, //BACKSLASH
+		{ 0x1C, "Keyboard_Enter" }, //ENTER
+		{ 0x0D, "Keyboard_EqualsAndPlus" }, //EQUALS
+		{ 0x0E, "Keyboard_Backspace" }, //BACKSPACE
+		{ 0x153, "Keyboard_Delete" }, //KEYBOARD_DELETE
+		{ 0x14F, "Keyboard_End" }, //END
+		{ 0x151, "Keyboard_PageDown" }, //PAGE_DOWN
+		{ 0x36, "Keyboard_RightShift" }, //RIGHT_SHIFT
+		{ 0x11D, "Keyboard_RightCtrl" }, //RIGHT_CONTROL
+		{ 0x148, "Keyboard_ArrowUp" }, //ARROW_UP
+		{ 0x14B, "Keyboard_ArrowLeft" }, //ARROW_LEFT
+		{ 0x150, "Keyboard_ArrowDown" }, //ARROW_DOWN
+		{ 0x14D, "Keyboard_ArrowRight" }, //ARROW_RIGHT
+		{ 0x45, "Keyboard_NumLock" }, //NUM_LOCK
+		{ 0x135, "Keyboard_NumSlash" }, //NUM_SLASH
+		{ 0x37, "Keyboard_NumAsterisk" }, //NUM_ASTERISK
+		{ 0x4A, "Keyboard_NumMinus" }, //NUM_MINUS
+		{ 0x4E, "Keyboard_NumPlus" }, //NUM_PLUS
+		{ 0x11C, "Keyboard_NumEnter" }, //NUM_ENTER
+		{ 0x47, "Keyboard_Num7" }, //NUM_SEVEN
+		{ 0x48, "Keyboard_Num8" }, //NUM_EIGHT
+		{ 0x49, "Keyboard_Num9" }, //NUM_NINE
+		{ 0x4B, "Keyboard_Num4" }, //NUM_FOUR
+		{ 0x4C, "Keyboard_Num5" }, //NUM_FIVE
+		{ 0x4D, "Keyboard_Num6" }, //NUM_SIX
+		{ 0x4F, "Keyboard_Num1" }, //NUM_ONE
+		{ 0x50, "Keyboard_Num2" }, //NUM_TWO
+		{ 0x51, "Keyboard_Num3" }, //NUM_THREE
+		{ 0x52, "Keyboard_Num0" }, //NUM_ZERO
+		{ 0x53, "Keyboard_NumPeriodAndDelete" }, //NUM_PERIOD
+		{ 0xFFF1, "Keyboard_Programmable1" }, //G_1
+		{ 0xFFF2, "Keyboard_Programmable2" }, //G_2
+		{ 0xFFF3, "Keyboard_Programmable3" }, //G_3
+		{ 0xFFF4, "Keyboard_Programmable4" }, //G_4
+		{ 0xFFF5, "Keyboard_Programmable5" }, //G_5
+		{ 0xFFF6, "Keyboard_Programmable6" }, //G_6
+		{ 0xFFF7, "Keyboard_Programmable7" }, //G_7
+		{ 0xFFF8, "Keyboard_Programmable8" }, //G_8
+		{ 0xFFF9, "Keyboard_Programmable9" }, //G_9
+		{ 0xFFFF1, "Logo" }, //G_LOGO
+		{ 0xFFFF2, "Keyboard_Custom1" }, //G_BADGE
+	};
+
+	//LedMapping.DirectInputScanCodes
+	const HostMapping HostScanCodes[] = {
+		{ 0x01, "Keyboard_Escape" }, //DIK_ESCAPE
+		{ 0x02, "Keyboard_1" }, //DIK_1
+		{ 0x03, "Keyboard_2" }, //DIK_2
+		{ 0x04, "Keyboard_3" }, //DIK_3
+		{ 0x05, "Keyboard_4" }, //DIK_4
+		{ 0x06, "Keyboard_5" }, //DIK_5
+		{ 0x07, "Keyboard_6" }, //DIK_6
+		{ 0x08, "Keyboard_7" }, //DIK_7
+		{ 0x09, "Keyboard_8" }, //DIK_8
+		{ 0x0A, "Keyboard_9" }, //DIK_9
+		{ 0x0B, "Keyboard_0" }, //DIK_0
+		{ 0x0C, "Keyboard_MinusAndUnderscore" }, //DIK_MINUS
+		{ 0x0D, "Keyboard_EqualsAndPlus" }, //DIK_EQUALS
+		{ 0x0E, "Keyboard_Backspace" }, //DIK_BACK
+		{ 0x0F, "Keyboard_Tab" }, //DIK_TAB
+		{ 0x10, "Keyboard_Q" }, //DIK_Q
+		{ 0x11, "Keyboard_W" }, //DIK_W
+		{ 0x12, "Keyboard_E" }, //DIK_E
+		{ 0x13, "Keyboard_R" }, //DIK_R
+		{ 0x14, "Keyboard_T" }, //DIK_T
+		{ 0x15, "Keyboard_Y" }, //DIK_Y
+		{ 0x16, "Keyboard_U" }, //DIK_U
+		{ 0x17, "Keyboard_I" }, //DIK_I
+		{ 0x18, "Keyboard_O" }, //DIK_O
+		{ 0x19, "Keyboard_P" }, //DIK_P
+		{ 0x1A, "Keyboard_BracketLeft" }, //DIK_LBRACKET
+		{ 0x1B, "Keyboard_BracketRight" }, //DIK_RBRACKET
+		{ 0x1C, "Keyboard_Enter" }, //DIK_RETURN
+		{ 0x1D, "Keyboard_LeftCtrl" }, //DIK_LContol
+		{ 0x1E, "Keyboard_A" }, //DIK_A
+		{ 0x1F, "Keyboard_S" }, //DIK_S
+		{ 0x20, "Keyboard_D" }, //DIK_D
+		{ 0x21, "Keyboard_F" }, //DIK_F
+		{ 0x22, "Keyboard_G" }, //DIK_G
+		{ 0x23, "Keyboard_H" }, //DIK_H
+		{ 0x24, "Keyboard_J" }, //DIK_J
+		{ 0x25, "Keyboard_K" }, //DIK_K
+		{ 0x26, "Keyboard_L" }, //DIK_L
+		{ 0x27, "Keyboard_SemicolonAndColon" }, //DIK_SEMICOLON
+		{ 0x28, "Keyboard_ApostropheAndDoubleQuote" }, //DIK_APOSTROPHE
+		{ 0x29, "Keyboard_GraveAccentAndTilde" }, //DIK_GRAVE
+		{ 0x2A, "Keyboard_LeftShift" }, //DIK_LSHIFT
+		{ 0x2B, "Keyboard_Backslash" }, //DIK_BACKSLASH
+		{ 0x2C, "Keyboard_Z" }, //DIK_Z
+		{ 0x2D, "Keyboard_X" }, //DIK_X
+		{ 0x2E, "Keyboard_C" }, //DIK_C
+		{ 0x2F, "Keyboard_V" }, //DIK_V
+		{ 0x30, "Keyboard_B" }, //DIK_B
+		{ 0x31, "Keyboard_N" }, //DIK_N
+		{ 0x32, "Keyboard_M" }, //DIK_M
+		{ 0x33, "Keyboard_CommaAndLessThan" }, //DIK_COMMA
+		{ 0x34, "Keyboard_PeriodAndBiggerThan" }, //DIK_PERIOD
+		{ 0x35, "Keyboard_SlashAndQuestionMark" }, //DIK_SLASH
+		{ 0x36, "Keyboard_RightShift" }, //DIK_RSHIFT
+		{ 0x37, "Keyboard_NumAsterisk" }, //DIK_MULTIPLY
+		{ 0x38, "Keyboard_LeftAlt" }, //DIK_LMENU
+		{ 0x39, "Keyboard_Space" }, //DIK_SPACE
+		{ 0x3A, "Keyboard_CapsLock" }, //DIK_CAPITAL
+		{ 0x3B, "Keyboard_F1" }, //DIK_F1
+		{ 0x3C, "Keyboard_F2" }, //DIK_F2
+		{ 0x3D, "Keyboard_F3" }, //DIK_F3
+		{ 0x3E, "Keyboard_F4" }, //DIK_F4
+		{ 0x3F, "Keyboard_F5" }, //DIK_F5
+		{ 0x40, "Keyboard_F6" }, //DIK_F6
+		{ 0x41, "Keyboard_F7" }, //DIK_F7
+		{ 0x42, "Keyboard_F8" }, //DIK_F8
+		{ 0x43, "Keyboard_F9" }, //DIK_F9
+		{ 0x44, "Keyboard_F10" }, //DIK_F10
+		{ 0x45, "Keyboard_NumLock" }, //DIK_NUMLOCK
+		{ 0x46, "Keyboard_ScrollLock" }, //DIK_SCROLL
+		{ 0x47, "Keyboard_Num7" }, //DIK_NUMPAD7
+		{ 0x48, "Keyboard_Num8" }, //DIK_NUMPAD8
+		{ 0x49, "Keyboard_Num9" }, //DIK_NUMPAD9
+		{ 0x4A, "Keyboard_NumMinus" }, //DIK_SUBTRACT
+		{ 0x4B, "Keyboard_Num4" }, //DIK_NUMPAD4
+		{ 0x4C, "Keyboard_Num5" }, //DIK_NUMPAD5
+		{ 0x4D, "Keyboard_Num6" }, //DIK_NUMPAD6
+		{ 0x4E, "Keyboard_NumPlus" }, //DIK_ADD
+		{ 0x4F, "Keyboard_Num1" }, //DIK_NUMPAD1
+		{ 0x50, "Keyboard_Num2" }, //DIK_NUMPAD2
+		{ 0x51, "Keyboard_Num3" }, //DIK_NUMPAD3
+		{ 0x52, "Keyboard_Num0" }, //DIK_NUMPAD0
+		{ 0x53, "Keyboard_NumPeriodAndDelete" }, //DIK_DECIMAL
+		{ 0x57, "Keyboard_F11" }, //DIK_F11
+		{ 0x58, "Keyboard_F12" }, //DIK_F12
+		{ 0x9C, "Keyboard_NumEnter" }, //DIK_NUMPADENTER
+		{ 0x9D, "Keyboard_RightCtrl" }, //DIK_RCONTROL
+		{ 0xB5, "Keyboard_NumSlash" }, //DIK_DIVIDE
+		{ 0xB8, "Keyboard_RightAlt" }, //DIK_RMENU
+		{ 0xC5, "Keyboard_PauseBreak" }, //DIK_PAUSE
+		{ 0xC7, "Keyboard_Home" }, //DIK_HOME
+		{ 0xC8, "Keyboard_ArrowUp" }, //DIK_UP
+		{ 0xC9, "Keyboard_PageUp" }, //DIK_PRIOR
+		{ 0xCB, "Keyboard_ArrowLeft" }, //DIK_LEFT
+		{ 0xCD, "Keyboard_ArrowRight" }, //DIK_RIGHT
+		{ 0xCF, "Keyboard_End" }, //DIK_END
+		{ 0xD0, "Keyboard_ArrowDown" }, //DIK_DOWN
+		{ 0xD1, "Keyboard_PageDown" }, //DIK_NEXT
+		{ 0xD2, "Keyboard_Insert" }, //DIK_INSERT
+		{ 0xD3, "Keyboard_Delete" }, //DIK_DELETE
+		{ 0xDB, "Keyboard_LeftGui" }, //DIK_LWIN
+		{ 0xDC, "Keyboard_RightGui" }, //DIK_RWIN
+		{ 0xDD, "Keyboard_Application" }, //DIK_APPS
+	};
+
+	//LedMapping.HidCodes
+	const HostMapping HostHidCodes[] = {
+		{ 0x29, "Keyboard_Escape" }, //KEY_ESC
+		{ 0x3A, "Keyboard_F1" }, //KEY_F1
+		{ 0x3B, "Keyboard_F2" }, //KEY_F2
+		{ 0x3C, "Keyboard_F3" }, //KEY_F3
+		{ 0x3D, "Keyboard_F4" }, //KEY_F4
+		{ 0x3E, "Keyboard_F5" }, //KEY_F5
+		{ 0x3F, "Keyboard_F6" }, //KEY_F6
+		{ 0x40, "Keyboard_F7" }, //KEY_F7
+		{ 0x41, "Keyboard_F8" }, //KEY_F8
+		{ 0x43, "Keyboard_F10" }, //KEY_F10
+		{ 0x44, "Keyboard_F11" }, //KEY_F11
+		{ 0x45, "Keyboard_F12" }, //KEY_F12
+		{ 0x46, "Keyboard_PrintScreen" }, //KEY_SYSRQ
+		{ 0x47, "Keyboard_ScrollLock" }, //KEY_SCROLLLOCK
+		{ 0x48, "Keyboard_PauseBreak" }, //KEY_PAUSE
+		{ 0x35, "Keyboard_GraveAccentAndTilde" }, //KEY_GRAVE
+		{ 0x1E, "Keyboard_1" }, //KEY_1
+		{ 0x1F, "Keyboard_2" }, //KEY_2
+		{ 0x20, "Keyboard_3" }, //KEY_3
+		{ 0x21, "Keyboard_4" }, //KEY_4
+		{ 0x22, "Keyboard_5" }, //KEY_5
+		{ 0x23, "Keyboard_6" }, //KEY_6
+		{ 0x24, "Keyboard_7" }, //KEY_7
+		{ 0x25, "Keyboard_8" }, //KEY_8
+		{ 0x26, "Keyboard_9" }, //KEY_9
+		{ 0x27, "Keyboard_0" }, //KEY_0
+		{ 0x2D, "Keyboard_MinusAndUnderscore" }, //KEY_MINUS
+		{ 0x2E, "Keyboard_EqualsAndPlus" }, //KEY_EQUAL
+		{ 0x2A, "Keyboard_Backspace" }, //KEY_BACKSPACE
+		{ 0x49, "Keyboard_Insert" }, //KEY_INSERT
+		{ 0x4A, "Keyboard_Home" }, //KEY_HOME
+		{ 0x4B, "Keyboard_PageUp" }, //KEY_PAGEUP
+		{ 0x53, "Keyboard_NumLock" }, //KEY_NUMLOCK
+		{ 0x54, "Keyboard_NumSlash" }, //KEY_KPSLASH
+		{ 0x55, "Keyboard_NumAsterisk" }, //KEY_KPASTERISK
+		{ 0x56, "Keyboard_NumMinus" }, //KEY_KPMINUS
+		{ 0x2B, "Keyboard_Tab" }, //KEY_TAB
+		{ 0x14, "Keyboard_Q" }, //KEY_Q
+		{ 0x1A, "Keyboard_W" }, //KEY_W
+		{ 0x08, "Keyboard_E" }, //KEY_E
+		{ 0x15, "Keyboard_R" }, //KEY_R
+		{ 0x17, "Keyboard_T" }, //KEY_T
+		{ 0x1C, "Keyboard_Y" }, //KEY_Y
+		{ 0x18, "Keyboard_U" }, //KEY_U
+		{ 0x0C, "Keyboard_I" }, //KEY_I
+		{ 0x12, "Keyboard_O" }, //KEY_O
+		{ 0x13, "Keyboard_P" }, //KEY_P
+		{ 0x2F, "Keyboard_BracketLeft" }, //KEY_LEFTBRACE
+		{ 0x30, "Keyboard_BracketRight" }, //KEY_RIGHTBRACE
+		{ 0x31, "Keyboard_NonUsBackslash" }, //KEY_BACKSLASH
+		{ 0x4C, "Keyboard_Delete" }, //KEY_DELETE
+		{ 0x4D, "Keyboard_End" }, //KEY_END
+		{ 0x4E, "Keyboard_PageDown" }, //KEY_PAGEDOWN
+		{ 0x5F, "Keyboard_Num7" }, //KEY_KP7
+		{ 0x60, "Keyboard_Num8" }, //KEY_KP8
+		{ 0x61, "Keyboard_Num9" }, //KEY_KP9
+		{ 0x57, "Keyboard_NumPlus" }, //KEY_KPPLUS
+		{ 0x39, "Keyboard_CapsLock" }, //KEY_CAPSLOCK
+		{ 0x04, "Keyboard_A" }, //KEY_A
+		{ 0x16, "Keyboard_S" }, //KEY_S
+		{ 0x07, "Keyboard_D" }, //KEY_D
+		{ 0x09, "Keyboard_F" }, //KEY_F
+		{ 0x0A, "Keyboard_G" }, //KEY_G
+		{ 0x0B, "Keyboard_H" }, //KEY_H
+		{ 0x0D, "Keyboard_J" }, //KEY_J
+		{ 0x0E, "Keyboard_K" }, //KEY_K
+		{ 0x0F, "Keyboard_L" }, //KEY_L
+		{ 0x33, "Keyboard_SemicolonAndColon" }, //KEY_SEMICOLON
+		{ 0x34, "Keyboard_ApostropheAndDoubleQuote" }, //KEY_APOSTROPHE
+		{ 0x28, "Keyboard_Enter" }, //KEY_ENTER
+		{ 0x5C, "Keyboard_Num4" }, //KEY_KP4
+		{ 0x5D, "Keyboard_Num5" }, //KEY_KP5
+		{ 0x5E, "Keyboard_Num6" }, //KEY_KP6
+		{ 0xE1, "Keyboard_LeftShift" }, //KEY_LEFTSHIFT
+		{ 0x1D, "Keyboard_Z" }, //KEY_Z
+		{ 0x1B, "Keyboard_X" }, //KEY_X
+		{ 0x06, "Keyboard_C" }, //KEY_C
+		{ 0x19, "Keyboard_V" }, //KEY_V
+		{ 0x05, "Keyboard_B" }, //KEY_B
+		{ 0x11, "Keyboard_N" }, //KEY_N
+		{ 0x10, "Keyboard_M" }, //KEY_M
+		{ 0x36, "Keyboard_CommaAndLessThan" }, //KEY_COMMA
+		{ 0x37, "Keyboard_PeriodAndBiggerThan" }, //KEY_DOT
+		{ 0x38, "Keyboard_SlashAndQuestionMark" }, //KEY_SLASH
+		{ 0xE5, "Keyboard_RightShift" }, //KEY_RIGHTSHIFT
+		{ 0x52, "Keyboard_ArrowUp" }, //KEY_UP
+		{ 0x59, "Keyboard_Num1" }, //KEY_KP1
+		{ 0x5A, "Keyboard_Num2" }, //KEY_KP2
+		{ 0x5B, "Keyboard_Num3" }, //KEY_KP3
+		{ 0x58, "Keyboard_NumEnter" }, //KEY_KPENTER
+		{ 0xE0, "Keyboard_LeftCtrl" }, //KEY_LEFTCTRL
+		{ 0xE3, "Keyboard_LeftGui" }, //KEY_LEFTMETA
+		{ 0xE2, "Keyboard_LeftAlt" }, //KEY_LEFTALT
+		{ 0x2C, "Keyboard_Space" }, //KEY_SPACE
+		{ 0xE6, "Keyboard_RightAlt" }, //KEY_RIGHTALT
+		{ 0xE7, "Keyboard_RightGui" }, //KEY_RIGHTMETA
+		{ 0xE4, "Keyboard_RightCtrl" }, //KEY_RIGHTCTRL
+		{ 0x50, "Keyboard_ArrowLeft" }, //KEY_LEFT
+		{ 0x51, "Keyboard_ArrowDown" }, //KEY_DOWN
+		{ 0x4F, "Keyboard_ArrowRight" }, //KEY_RIGHT
+		{ 0x63, "Keyboard_Num0" }, //KEY_KPDOT
+		{ 0x62, "Keyboard_NumPeriodAndDelete" }, //KEY_KP0
+	};
+
+	const unsigned int DenseLedCount = sizeof(DenseLedIds) / sizeof(DenseLedIds[0]);
+
+	unsigned char FindDenseLed(const char* ledId)
+	{
+		for (unsigned int i = 0; i < DenseLedCount; i++) {
+			if (strcmp(DenseLedIds[i], ledId) == 0) {
+				return (unsigned char)i;
+			}
+		}
+		return NO_LED;
+	}
+
+	bool IsHostCode(const HostMapping mappings[], unsigned int count, int code)
+	{
+		for (unsigned int i = 0; i < count; i++) {
+			if (mappings[i].code == code) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//every code the host maps lands on the host's LED, everything else on NO_LED
+	template <unsigned int Count>
+	void CheckCommand(unsigned int command, const HostMapping(&mappings)[Count])
+	{
+		bool used[LED_COUNT] = {};
+		for (unsigned int i = 0; i < Count; i++) {
+			const unsigned char expected = FindDenseLed(mappings[i].ledId);
+			const unsigned char led = GetLedIndex(command, mappings[i].code);
+			CHECK(expected != NO_LED);
+			CHECK(led == expected);
+			if (led >= LED_COUNT) {
+				CHECK(led < LED_COUNT);
+				continue;
+			}
+
+			//the host tables give every code a LED of its own
+			CHECK(!used[led]);
+			used[led] = true;
+		}
+
+		for (int code = 0; code < 0x200; code++) {
+			if (!IsHostCode(mappings, Count, code)) {
+				CHECK(GetLedIndex(command, code) == NO_LED);
+			}
+		}
+	}
+}
+
+TEST(DenseIndexMatchesTheHost)
+{
+	CHECK(DenseLedCount == LED_COUNT);
+}
+
+TEST(KeyNamesHitTheHostsLeds)
+{
+	CheckCommand(LogiCommands::SetLightingForKeyWithKeyName, HostKeyNames);
+}
+
+TEST(ScanCodesHitTheHostsLeds)
+{
+	CheckCommand(LogiCommands::SetLightingForKeyWithScanCode, HostScanCodes);
+}
+
+TEST(HidCodesHitTheHostsLeds)
+{
+	CheckCommand(LogiCommands::SetLightingForKeyWithHidCode, HostHidCodes);
+
+	//the host has no HID code for F9
+	CHECK(GetLedIndex(LogiCommands::SetLightingForKeyWithHidCode, 0x42) == NO_LED);
+}
+
+TEST(QuartzCodesNeverMap)
+{
+	for (int code = 0; code < 0x200; code++) {
+		CHECK(GetLedIndex(LogiCommands::SetLightingForKeyWithQuartzCode, code) == NO_LED);
+	}
+	CHECK(GetLedIndex(LogiCommands::SetLighting, 0x01) == NO_LED);
+}
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "pch.h"
+#include "Test.h"
+#include "LightingState.h"
+#include "LogiCommands.h"
+#include "BitmapKeyMap.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+	//replay functions are plain pointers, so the last snapshot replayed is kept here
+	LightingState::Snapshot replayed;
+	unsigned int replayCount = 0;
+
+	void RecordReplay(const LightingState::Snapshot& snapshot)
+	{
+		replayed = snapshot;
+		replayCount++;
+	}
+
+	bool SameColor(EffectColor a, EffectColor b)
+	{
+		return a.red == b.red && a.green == b.green && a.blue == b.blue;
+	}
+
+	//SendSnapshot's segments joined into the one packet the host reads
+	std::vector<unsigned char> snapshotPacket;
+
+	void RecordSnapshot(const PacketSegment segments[], unsigned int segmentCount)
+	{
+		snapshotPacket.clear();
+		for (unsigned int i = 0; i < segmentCount; i++) {
+			const unsigned char* data = (const unsigned char*)segments[i].data;
+			snapshotPacket.insert(snapshotPacket.end(), data, data + segments[i].length);
+		}
+	}
+
+	//the layout LogitechWrapperListenerService.SetLightingSnapshot parses, written out here
+	//instead of taken from LightingState so a change on one side shows up
+	const unsigned int HostMaskSize = (LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT + 7) / 8;
+	const unsigned int HostHeaderSize = 8 + HostMaskSize;
+	const unsigned int HostKeyRecordSize = 8;
+	const unsigned char HostHasBackground = 0x01;
+	const unsigned char HostHasBitmap = 0x02;
+
+	struct HostKey {
+		int keyCode;
+		unsigned char command;
+		EffectColor color;
+	};
+
+	struct HostSnapshot {
+		bool valid = false;
+		int targetDevice = 0;
+		unsigned char flags = 0;
+		EffectColor background = {};
+		unsigned char mask[HostMaskSize] = {};
+		const unsigned char* bitmap = nullptr;
+		std::vector<HostKey> keys;
+	};
+
+	//not valid unless the packet is exactly as long as its flags and key count say
+	HostSnapshot DecodeSnapshot()
+	{
+		HostSnapshot snapshot;
+		const unsigned char* packet = snapshotPacket.data();
+		size_t length = snapshotPacket.size();
+		if (length < HostHeaderSize) {
+			return snapshot;
+		}
+
+		memcpy(&snapshot.targetDevice, &packet[0], sizeof(int));
+		snapshot.flags = packet[4];
+		snapshot.background = { packet[5], packet[6], packet[7] };
+		memcpy(snapshot.mask, &packet[8], HostMaskSize);
+
+		size_t offset = HostHeaderSize;
+		if (snapshot.flags & HostHasBitmap) {
+			if (length - offset < LOGI_LED_BITMAP_SIZE) {
+				return snapshot;
+			}
+			snapshot.bitmap = &packet[offset];
+			offset += LOGI_LED_BITMAP_SIZE;
+		}
+
+		unsigned int keyCount = 0;
+		if (length - offset < sizeof(keyCount)) {
+			return snapshot;
+		}
+		memcpy(&keyCount, &packet[offset], sizeof(keyCount));
+		offset += sizeof(keyCount);
+		if (length - offset != (size_t)keyCount * HostKeyRecordSize) {
+			return snapshot;
+		}
+
+		for (unsigned int i = 0; i < keyCount; i++, offset += HostKeyRecordSize) {
+			HostKey key;
+			memcpy(&key.keyCode, &packet[offset], sizeof(int));
+			key.command = packet[offset + 4];
+			key.color = { packet[offset + 5], packet[offset + 6], packet[offset + 7] };
+			snapshot.keys.push_back(key);
+		}
+
+		snapshot.valid = true;
+		return snapshot;
+	}
+
+	bool IsMasked(const HostSnapshot& snapshot, LogiLed::KeyName keyName)
+	{
+		const int bitmapKey = GetBitmapKey(keyName);
+		return (snapshot.mask[bitmapKey / 8] & (1 << (bitmapKey % 8))) != 0;
+	}
+
+	//the state holds every saved snapshot, too large for the stack
+	std::unique_ptr<LightingState> CreateState()
+	{
+		replayed = LightingState::Snapshot();
+		replayCount = 0;
+		snapshotPacket.clear();
+		return std::unique_ptr<LightingState>(new LightingState());
+	}
+}
+
+TEST(ZonesAreReplayedWithTheRestOfTheState)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetLighting({ 1, 2, 3 });
+	state->SetZone(LogiLed::Mouse, 0, { 10, 20, 30 });
+	state->SetZone(LogiLed::Headset, 1, { 40, 50, 60 });
+	state->SetZone(LogiLed::Mouse, 0, { 70, 80, 90 });
+
+	state->Replay(RecordReplay);
+
+	//a zone set again keeps its place and takes the new color
+	CHECK(replayCount == 1);
+	CHECK(replayed.hasBackground && SameColor(replayed.background, { 1, 2, 3 }));
+	CHECK(replayed.zoneCount == 2);
+	CHECK(replayed.zones[0].deviceType == LogiLed::Mouse && replayed.zones[0].zone == 0);
+	CHECK(SameColor(replayed.zones[0].color, { 70, 80, 90 }));
+	CHECK(replayed.zones[1].deviceType == LogiLed::Headset && replayed.zones[1].zone == 1);
+	CHECK(SameColor(replayed.zones[1].color, { 40, 50, 60 }));
+}
+
+TEST(RestoreBringsBackTheSavedZones)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetZone(LogiLed::Keyboard, 2, { 1, 1, 1 });
+	state->Save();
+	state->SetZone(LogiLed::Keyboard, 2, { 2, 2, 2 });
+	state->SetZone(LogiLed::Speaker, 0, { 3, 3, 3 });
+
+	CHECK(state->Restore(RecordReplay));
+	CHECK(replayed.zoneCount == 1);
+	CHECK(replayed.zones[0].deviceType == LogiLed::Keyboard && SameColor(replayed.zones[0].color, { 1, 1, 1 }));
+}
+
+TEST(ZonesPastTheLimitAreNotKept)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	for (int i = 0; i < MAX_ZONE_OVERRIDES + 4; i++) {
+		state->SetZone(LogiLed::Mousemat, i, { (unsigned char)i, 0, 0 });
+	}
+	//zones already kept still change
+	state->SetZone(LogiLed::Mousemat, 0, { 0xFF, 0, 0 });
+
+	state->Replay(RecordReplay);
+	CHECK(replayed.zoneCount == MAX_ZONE_OVERRIDES);
+	CHECK(replayed.zones[MAX_ZONE_OVERRIDES - 1].zone == MAX_ZONE_OVERRIDES - 1);
+	CHECK(replayed.zones[0].color.red == 0xFF);
+
+	state->Clear();
+	state->Replay(RecordReplay);
+	CHECK(replayed.zoneCount == 0);
+}
+
+TEST(RestoreGoesBackThroughTheSavesInOrder)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	CHECK(!state->Restore(RecordReplay));
+	CHECK(replayCount == 0);
+
+	state->SetLighting({ 1, 0, 0 });
+	state->Save();
+	state->SetLighting({ 2, 0, 0 });
+	state->Save();
+	state->SetLighting({ 3, 0, 0 });
+
+	CHECK(state->Restore(RecordReplay));
+	CHECK(replayed.background.red == 2);
+	CHECK(state->Restore(RecordReplay));
+	CHECK(replayed.background.red == 1);
+	CHECK(!state->Restore(RecordReplay));
+	CHECK(replayCount == 2);
+
+	//the restored state is the current one again
+	state->Replay(RecordReplay);
+	CHECK(replayed.background.red == 1);
+}
+
+TEST(SavesPastTheStackDepthDropTheOldest)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	for (unsigned int i = 1; i <= LIGHTING_STATE_STACK_DEPTH + 2; i++) {
+		state->SetLighting({ (unsigned char)i, 0, 0 });
+		state->Save();
+	}
+
+	for (unsigned int i = LIGHTING_STATE_STACK_DEPTH + 2; i > 2; i--) {
+		CHECK(state->Restore(RecordReplay));
+		CHECK(replayed.background.red == i);
+	}
+	CHECK(!state->Restore(RecordReplay));
+}
+
+TEST(KeysPastTheLimitAreNotKept)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+	for (int i = 0; i < MAX_KEY_OVERRIDES + 10; i++) {
+		state->SetKey(LogiCommands::SetLightingForKeyWithHidCode, i, { 1, 1, 1 });
+	}
+	//keys already kept still change
+	state->SetKey(LogiCommands::SetLightingForKeyWithHidCode, 0, { 2, 2, 2 });
+
+	state->Replay(RecordReplay);
+	CHECK(replayed.keyCount == MAX_KEY_OVERRIDES);
+	CHECK(replayed.keys[0].keyCode == 0 && replayed.keys[0].color.red == 2);
+	CHECK(replayed.keys[MAX_KEY_OVERRIDES - 1].keyCode == MAX_KEY_OVERRIDES - 1);
+}
+
+TEST(SavedKeysPastTheLimitAreNotKept)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetLighting({ 5, 5, 5 });
+	state->SetTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+
+	//saved keys are numbered from 1, 0 is NO_KEY
+	for (int i = 1; i <= MAX_SAVED_KEYS + 1; i++) {
+		state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, i, { (unsigned char)i, 0, 0 });
+		state->SaveKey((LogiLed::KeyName)i);
+	}
+	//saving a key again takes its current color without using up a place
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, 1, { 0xFF, 0, 0 });
+	state->SaveKey((LogiLed::KeyName)1);
+
+	EffectColor color = {};
+	CHECK(state->RestoreKey((LogiLed::KeyName)1, color));
+	CHECK(color.red == 0xFF);
+	CHECK(state->RestoreKey((LogiLed::KeyName)MAX_SAVED_KEYS, color));
+	CHECK(color.red == MAX_SAVED_KEYS);
+	CHECK(!state->RestoreKey((LogiLed::KeyName)(MAX_SAVED_KEYS + 1), color));
+}
+
+TEST(SnapshotIsLaidOutTheWayTheHostReadsIt)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetLighting({ 10, 20, 30 });
+	state->SetTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+	state->SetKey(LogiCommands::SetLightingForKeyWithHidCode, 0x29, { 1, 2, 3 });
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::G_1, { 4, 5, 6 });
+	const LogiLed::KeyName excluded[] = { LogiLed::F1 };
+	state->ExcludeKeys(excluded, 1);
+
+	CHECK(state->SendSnapshot(RecordSnapshot));
+	HostSnapshot snapshot = DecodeSnapshot();
+	CHECK(snapshot.valid);
+	CHECK(snapshot.targetDevice == LOGI_DEVICETYPE_PERKEY_RGB);
+	CHECK(snapshot.flags == HostHasBackground);
+	CHECK(SameColor(snapshot.background, { 10, 20, 30 }));
+	CHECK(IsMasked(snapshot, LogiLed::F1));
+	CHECK(!IsMasked(snapshot, LogiLed::ESC));
+	CHECK(snapshot.bitmap == nullptr);
+
+	CHECK(snapshot.keys.size() == 2);
+	CHECK(snapshot.keys[0].keyCode == 0x29 && snapshot.keys[0].command == LogiCommands::SetLightingForKeyWithHidCode);
+	CHECK(SameColor(snapshot.keys[0].color, { 1, 2, 3 }));
+	CHECK(snapshot.keys[1].keyCode == LogiLed::G_1 && snapshot.keys[1].command == LogiCommands::SetLightingForKeyWithKeyName);
+	CHECK(SameColor(snapshot.keys[1].color, { 4, 5, 6 }));
+}
+
+TEST(SnapshotCarriesTheBitmapAheadOfTheKeys)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE];
+	for (unsigned int i = 0; i < LOGI_LED_BITMAP_SIZE; i++) {
+		bitmap[i] = (unsigned char)i;
+	}
+	state->SetBitmap(bitmap);
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::ESC, { 7, 8, 9 });
+
+	CHECK(state->SendSnapshot(RecordSnapshot));
+	HostSnapshot snapshot = DecodeSnapshot();
+	CHECK(snapshot.valid);
+	CHECK(snapshot.flags == HostHasBitmap);
+	CHECK(snapshot.bitmap != nullptr && memcmp(snapshot.bitmap, bitmap, LOGI_LED_BITMAP_SIZE) == 0);
+	CHECK(snapshot.keys.size() == 1);
+	CHECK(snapshot.keys[0].keyCode == LogiLed::ESC && SameColor(snapshot.keys[0].color, { 7, 8, 9 }));
+}
+
+TEST(BitmapDrawsOverKeysThatAreNotExcluded)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+	const LogiLed::KeyName excluded[] = { LogiLed::F1, LogiLed::F2 };
+	state->ExcludeKeys(excluded, 2);
+
+	//key names and scan codes are bitmap positions, the rest can't be drawn over
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::ESC, { 1, 0, 0 });
+	state->SetKey(LogiCommands::SetLightingForKeyWithScanCode, LogiLed::ONE, { 2, 0, 0 });
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::F1, { 3, 0, 0 });
+	state->SetKey(LogiCommands::SetLightingForKeyWithScanCode, LogiLed::F2, { 4, 0, 0 });
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::G_1, { 5, 0, 0 });
+	state->SetKey(LogiCommands::SetLightingForKeyWithHidCode, LogiLed::ESC, { 6, 0, 0 });
+
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	state->SetBitmap(bitmap);
+
+	state->Replay(RecordReplay);
+	CHECK(replayed.hasBitmap);
+	CHECK(replayed.keyCount == 4);
+
+	//what is left is the excluded keys and the ones without a bitmap position, by their colors
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < replayed.keyCount; i++) {
+		kept |= 1u << replayed.keys[i].color.red;
+	}
+	CHECK(kept == ((1u << 3) | (1u << 4) | (1u << 5) | (1u << 6)));
+
+	//a key the bitmap drew over shows its pixel
+	EffectColor color = { 0xFF, 0xFF, 0xFF };
+	CHECK(state->GetKeyColor(LogiLed::ESC, color));
+	CHECK(SameColor(color, { 0, 0, 0 }));
+	CHECK(state->GetKeyColor(LogiLed::F1, color));
+	CHECK(color.red == 3);
+}
+
+TEST(RestoreSnapshotDropsKeysSetAfterTheSave)
+{
+	std::unique_ptr<LightingState> state = CreateState();
+	state->SetLighting({ 0, 0, 9 });
+	state->SetTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::F1, { 0, 9, 0 });
+	state->Save();
+
+	state->SetKey(LogiCommands::SetLightingForKeyWithKeyName, LogiLed::ESC, { 9, 0, 0 });
+	unsigned char bitmap[LOGI_LED_BITMAP_SIZE] = {};
+	state->SetBitmap(bitmap);
+	state->SetTargetDevice(LOGI_DEVICETYPE_ALL);
+	state->SetLighting({ 9, 9, 9 });
+
+	//the host replaces its keys and background with the snapshot, so it only has what was saved
+	CHECK(state->Restore(RecordReplay));
+	CHECK(state->SendSnapshot(RecordSnapshot));
+	HostSnapshot snapshot = DecodeSnapshot();
+	CHECK(snapshot.valid);
+	CHECK(snapshot.targetDevice == LOGI_DEVICETYPE_PERKEY_RGB);
+	CHECK(snapshot.flags == HostHasBackground);
+	CHECK(SameColor(snapshot.background, { 0, 0, 9 }));
+	CHECK(snapshot.keys.size() == 1);
+	CHECK(snapshot.keys[0].keyCode == LogiLed::F1 && SameColor(snapshot.keys[0].color, { 0, 9, 0 }));
+}
\ No newline at end of file
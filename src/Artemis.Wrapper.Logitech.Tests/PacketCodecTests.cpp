@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "Test.h"
+#include "PacketCodec.h"
+#include "Constants.h"
+#include <string>
+
+namespace {
+	//The host's decoders, WrapperPacket.GetPacketLength and SetLightingForKeysCompact.
+	//Returns the bytes read, 0 when the varint is malformed.
+	unsigned int DecodeVarint(const unsigned char buff[], unsigned int length, unsigned int& value)
+	{
+		value = 0;
+		for (unsigned int i = 0; i < length && i < 5; i++) {
+			value |= (unsigned int)(buff[i] & 0x7F) << (7 * i);
+			if ((buff[i] & 0x80) == 0) {
+				return i + 1;
+			}
+		}
+		return 0;
+	}
+
+	unsigned int DecodeCompactKeys(const unsigned char buff[], unsigned int length, KeyRecord keys[])
+	{
+		unsigned int keyCount = 0;
+		unsigned int buffPtr = 0;
+		while (buffPtr + 2 <= length) {
+			const unsigned char command = buff[buffPtr];
+			const unsigned char count = buff[buffPtr + 1];
+			buffPtr += 2;
+			for (unsigned int i = 0; i < count && buffPtr + COMPACT_KEY_RECORD_SIZE <= length; i++) {
+				KeyRecord& key = keys[keyCount++];
+				unsigned short keyCode;
+				memcpy(&keyCode, &buff[buffPtr], sizeof(keyCode));
+				key.keyCode = keyCode;
+				key.command = command;
+				key.red = buff[buffPtr + 2];
+				key.green = buff[buffPtr + 3];
+				key.blue = buff[buffPtr + 4];
+				buffPtr += COMPACT_KEY_RECORD_SIZE;
+			}
+		}
+		return keyCount;
+	}
+
+	//a frame of a per-key game, mostly one command with a few keys set by scan code in between
+	void BuildFrame(KeyRecord keys[], unsigned int keyCount, unsigned int frame)
+	{
+		for (unsigned int i = 0; i < keyCount; i++) {
+			keys[i].keyCode = (int)(i % 16 == 15 ? LogiLed::ESC : 0x10 + i);
+			keys[i].command = i % 16 == 15 ? LogiCommands::SetLightingForKeyWithScanCode : LogiCommands::SetLightingForKeyWithKeyName;
+			keys[i].red = (unsigned char)(frame + i);
+			keys[i].green = (unsigned char)(frame * 3);
+			keys[i].blue = 0x80;
+		}
+	}
+
+	bool SameKeys(const KeyRecord a[], const KeyRecord b[], unsigned int keyCount)
+	{
+		for (unsigned int i = 0; i < keyCount; i++) {
+			if (a[i].keyCode != b[i].keyCode || a[i].command != b[i].command || a[i].red != b[i].red || a[i].green != b[i].green || a[i].blue != b[i].blue) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST(VarintsRoundTrip)
+{
+	const unsigned int values[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, 0xFFFFFFFF };
+	const unsigned int sizes[] = { 1, 1, 1, 2, 2, 3, 3, 4, 5 };
+
+	for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		unsigned char buff[5];
+		unsigned int decoded;
+		CHECK(EncodeVarint(values[i], buff) == sizes[i]);
+		CHECK(DecodeVarint(buff, sizes[i], decoded) == sizes[i] && decoded == values[i]);
+	}
+}
+
+TEST(CompactHeaderCoversTheRestOfThePacket)
+{
+	unsigned char header[PACKET_HEADER_SIZE];
+	const unsigned int headerLength = EncodeCompactHeader(LogiCommands::SetLighting, 3, 0x1234, header);
+	CHECK(headerLength == 3);
+
+	unsigned int length = 0;
+	CHECK(DecodeVarint(header, headerLength, length) == 1);
+	CHECK(length == 2 + 3);
+	CHECK(header[1] == LogiCommands::SetLighting);
+	CHECK(header[2] == 0x34);
+
+	//a full frame takes a two byte length
+	CHECK(EncodeCompactHeader(LogiCommands::SetLightingForKeysCompact, 1000, 0, header) == 4);
+}
+
+TEST(CompactKeysRoundTrip)
+{
+	KeyRecord keys[MAX_COALESCED_KEYS];
+	KeyRecord decoded[MAX_COALESCED_KEYS];
+	unsigned char buff[COMPACT_KEYS_MAX_SIZE(MAX_COALESCED_KEYS)];
+	BuildFrame(keys, MAX_COALESCED_KEYS, 7);
+
+	unsigned int length = 0;
+	CHECK(EncodeCompactKeys(keys, MAX_COALESCED_KEYS, buff, length));
+	CHECK(DecodeCompactKeys(buff, length, decoded) == MAX_COALESCED_KEYS);
+	CHECK(SameKeys(keys, decoded, MAX_COALESCED_KEYS));
+}
+
+TEST(CompactRunsSplitAtTheirCount)
+{
+	KeyRecord keys[300];
+	KeyRecord decoded[300];
+	unsigned char buff[COMPACT_KEYS_MAX_SIZE(300)];
+	for (unsigned int i = 0; i < 300; i++) {
+		keys[i] = { (int)i, (unsigned char)LogiCommands::SetLightingForKeyWithHidCode, 1, 2, 3 };
+	}
+
+	unsigned int length = 0;
+	CHECK(EncodeCompactKeys(keys, 300, buff, length));
+	//two runs, the count is a single byte
+	CHECK(length == 2 * 2 + 300 * COMPACT_KEY_RECORD_SIZE);
+	CHECK(buff[1] == 0xFF);
+	CHECK(DecodeCompactKeys(buff, length, decoded) == 300);
+	CHECK(SameKeys(keys, decoded, 300));
+}
+
+TEST(WideKeyNamesAreNotCompacted)
+{
+	KeyRecord keys[2] = {
+		{ LogiLed::ESC, (unsigned char)LogiCommands::SetLightingForKeyWithKeyName, 1, 2, 3 },
+		{ LogiLed::G_LOGO, (unsigned char)LogiCommands::SetLightingForKeyWithKeyName, 1, 2, 3 },
+	};
+	unsigned char buff[COMPACT_KEYS_MAX_SIZE(2)];
+	unsigned int length = 0;
+	CHECK(!EncodeCompactKeys(keys, 2, buff, length));
+}
+
+//Bytes per packet in the stamped, legacy and compact formats, plus the time to frame and parse each
+//compact packet on either side. A frame is what the coalescer sends for a per-key heavy game.
+BENCHMARK(CompactVersusFullWireFormat)
+{
+	const unsigned int iterations = 200000;
+	const unsigned int frameKeys[] = { 1, 16, 104 };
+
+	for (unsigned int keyCount : frameKeys) {
+		KeyRecord keys[MAX_COALESCED_KEYS];
+		KeyRecord decoded[MAX_COALESCED_KEYS];
+		unsigned char header[PACKET_HEADER_SIZE];
+		unsigned char body[COMPACT_KEYS_MAX_SIZE(MAX_COALESCED_KEYS)];
+		BuildFrame(keys, keyCount, 1);
+
+		unsigned int bodyLength = 0;
+		const double encodeNs = MeasureNs(iterations, [&](unsigned int i) {
+			keys[0].red = (unsigned char)i;
+			EncodeCompactKeys(keys, keyCount, body, bodyLength);
+			EncodeCompactHeader(LogiCommands::SetLightingForKeysCompact, bodyLength, i, header);
+			KeepResult(header);
+			KeepResult(body);
+		});
+
+		const unsigned int compactSize = EncodeCompactHeader(LogiCommands::SetLightingForKeysCompact, bodyLength, 0, header) + bodyLength;
+		const double decodeNs = MeasureNs(iterations, [&](unsigned int) {
+			//the length covers the command and sequence bytes too
+			unsigned int length;
+			DecodeVarint(header, sizeof(header), length);
+			CHECK(DecodeCompactKeys(body, length - 2, decoded) == keyCount);
+			KeepResult(decoded);
+		});
+
+		//SetLightingForKeys is [u32 count] plus the 8 byte records
+		const unsigned int fullBody = sizeof(unsigned int) + keyCount * sizeof(KeyRecord);
+		const std::string sizes =
+			std::to_string(PACKET_HEADER_SIZE + fullBody) + " stamped, " +
+			std::to_string(sizeof(unsigned int) * 2 + fullBody) + " legacy, " +
+			std::to_string(compactSize) + " compact bytes";
+		ReportBenchmark(("encode " + std::to_string(keyCount) + " keys, ns/frame").c_str(), encodeNs, sizes.c_str());
+		ReportBenchmark(("decode " + std::to_string(keyCount) + " keys, ns/frame").c_str(), decodeNs, nullptr);
+	}
+
+	//one unbatched SetLightingForKeyWithKeyName, [keyName][r g b]
+	unsigned char header[PACKET_HEADER_SIZE];
+	const unsigned int keyBody = SetLightingForKeyWithKeyNamePacket::payloadSize;
+	const unsigned int compactSize = EncodeCompactHeader(LogiCommands::SetLightingForKeyWithKeyName, keyBody, 0, header) + keyBody;
+	const std::string sizes =
+		std::to_string(PACKET_HEADER_SIZE + keyBody) + " stamped, " +
+		std::to_string(sizeof(unsigned int) * 2 + keyBody) + " legacy, " +
+		std::to_string(compactSize) + " compact bytes";
+	const double headerNs = MeasureNs(iterations, [&](unsigned int i) {
+		EncodeCompactHeader(LogiCommands::SetLightingForKeyWithKeyName, keyBody, i, header);
+		KeepResult(header);
+	});
+	ReportBenchmark("single key header, ns/packet", headerNs, sizes.c_str());
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "Test.h"
+#include "RateGovernor.h"
+#include "Constants.h"
+
+namespace {
+	bool IsBudget(RateBudget budget, unsigned int packetsPerSecond, unsigned int bytesPerSecond)
+	{
+		return budget.packetsPerSecond == packetsPerSecond && budget.bytesPerSecond == bytesPerSecond;
+	}
+
+	bool IsDefaultBudget(RateBudget budget)
+	{
+		return IsBudget(budget, DEFAULT_RATE_BUDGET_PACKETS, DEFAULT_RATE_BUDGET_BYTES);
+	}
+}
+
+TEST(PacketBudgetRunsOutAndRefills)
+{
+	VirtualEffectClock clock;
+	RateGovernor governor(clock);
+	governor.SetBudget({ 10, 0 });
+
+	//a program starts with a full second of budget
+	for (unsigned int i = 0; i < 10; i++) {
+		CHECK(governor.TryConsume(100));
+	}
+	CHECK(!governor.TryConsume(100));
+
+	//10 packets a second is one every 100 ms
+	clock.Advance(99);
+	CHECK(!governor.TryConsume(100));
+	clock.Advance(1);
+	CHECK(governor.TryConsume(100));
+	CHECK(!governor.TryConsume(100));
+
+	//the bucket holds one second at most, however long the program was quiet
+	clock.Advance(10000);
+	for (unsigned int i = 0; i < 10; i++) {
+		CHECK(governor.TryConsume(100));
+	}
+	CHECK(!governor.TryConsume(100));
+}
+
+TEST(ByteBudgetRunsOutAndRefills)
+{
+	VirtualEffectClock clock;
+	RateGovernor governor(clock);
+	governor.SetBudget({ 0, 1000 });
+
+	CHECK(governor.TryConsume(600));
+	//a refused packet takes nothing
+	CHECK(!governor.TryConsume(600));
+	CHECK(governor.TryConsume(400));
+	CHECK(!governor.TryConsume(1));
+
+	clock.Advance(500);
+	CHECK(governor.TryConsume(500));
+	CHECK(!governor.TryConsume(1));
+}
+
+TEST(ThrottledProgramResumesOnceTheReserveIsBack)
+{
+	VirtualEffectClock clock;
+	RateGovernor governor(clock);
+	governor.SetBudget({ 100, 0 });
+
+	//packets that have to go out anyway empty the bucket and stop there
+	for (unsigned int i = 0; i < 150; i++) {
+		governor.Consume(100);
+	}
+	CHECK(!governor.TryConsume(100));
+	CHECK(!governor.HasReserve(RATE_GOVERNOR_RESUME_MS));
+
+	clock.Advance(RATE_GOVERNOR_RESUME_MS - 1);
+	CHECK(!governor.HasReserve(RATE_GOVERNOR_RESUME_MS));
+	clock.Advance(1);
+	CHECK(governor.HasReserve(RATE_GOVERNOR_RESUME_MS));
+	CHECK(governor.TryConsume(100));
+}
+
+TEST(ZeroBudgetIsUnlimited)
+{
+	VirtualEffectClock clock;
+	RateGovernor governor(clock);
+	governor.SetBudget(RateGovernor::ParseBudget("0:0", "Game.exe"));
+	CHECK(IsBudget(governor.GetBudget(), 0, 0));
+
+	for (unsigned int i = 0; i < 100000; i++) {
+		CHECK(governor.TryConsume(PACKET_QUEUE_SLOT_SIZE));
+	}
+	CHECK(governor.HasReserve(RATE_GOVERNOR_RESUME_MS));
+}
+
+TEST(ProgramEntryOverridesTheDefault)
+{
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("", "Game.exe")));
+	CHECK(IsBudget(RateGovernor::ParseBudget("100:2000", "Game.exe"), 100, 2000));
+
+	//either order, program names ignore case
+	CHECK(IsBudget(RateGovernor::ParseBudget("100:2000;Game.exe=5:60", "game.EXE"), 5, 60));
+	CHECK(IsBudget(RateGovernor::ParseBudget("Game.exe=5:60;100:2000", "Game.exe"), 5, 60));
+	CHECK(IsBudget(RateGovernor::ParseBudget("100:2000;Game.exe=5:60", "Other.exe"), 100, 2000));
+	CHECK(IsBudget(RateGovernor::ParseBudget("Game.exe=5:60", "Other.exe"), DEFAULT_RATE_BUDGET_PACKETS, DEFAULT_RATE_BUDGET_BYTES));
+	CHECK(IsBudget(RateGovernor::ParseBudget("Game.exe=0:0;100:2000;", "Game.exe"), 0, 0));
+}
+
+TEST(MalformedBudgetsAreRejected)
+{
+	//none of these may come out as 0, which would be unlimited
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("abc:def", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("100", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("100:", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget(":100", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("10x:100", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("-1:100", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("1:2:3", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("99999999999:100", "Game.exe")));
+	CHECK(IsDefaultBudget(RateGovernor::ParseBudget("=5:60", "Game.exe")));
+
+	//a bad entry is skipped, the good ones around it still count
+	CHECK(IsBudget(RateGovernor::ParseBudget("Game.exe=abc:def;100:2000", "Game.exe"), 100, 2000));
+	CHECK(IsBudget(RateGovernor::ParseBudget("100:2000;oops;Game.exe=5:60", "Game.exe"), 5, 60));
+}
\ No newline at end of file
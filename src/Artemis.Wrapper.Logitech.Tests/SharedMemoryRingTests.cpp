@@ -0,0 +1,349 @@
+#include "pch.h"
+#include "Test.h"
+#include "SharedMemoryRing.h"
+#include "Constants.h"
+#include "LogiCommands.h"
+#include "Platform.h"
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#include "Utils.h"
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	//The host's side of the ring, so the tests can drain what the wrapper wrote.
+	class RingReader
+	{
+	private:
+#ifdef _WIN32
+		HANDLE _mapping = NULL;
+		HANDLE _event = NULL;
+#else
+		size_t _size = 0;
+		int _event = -1;
+#endif
+		SharedMemoryRingHeader* _header = NULL;
+		unsigned char* _data = NULL;
+
+		void CopyOut(unsigned int index, unsigned char* buffer, unsigned int length)
+		{
+			for (unsigned int i = 0; i < length; i++) {
+				buffer[i] = _data[(index + i) & (_header->capacity - 1)];
+			}
+		}
+	public:
+#ifdef _WIN32
+		explicit RingReader(SharedMemoryRing& ring)
+		{
+			std::wstring wideName = utf8_decode(ring.GetName());
+			_mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, wideName.c_str());
+			_event = OpenEventW(SYNCHRONIZE, FALSE, (wideName + utf8_decode(SHARED_MEMORY_EVENT_SUFFIX)).c_str());
+			if (_mapping != NULL) {
+				_header = (SharedMemoryRingHeader*)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+				_data = (unsigned char*)_header + sizeof(SharedMemoryRingHeader);
+			}
+		}
+
+		~RingReader()
+		{
+			if (_header != NULL) {
+				UnmapViewOfFile(_header);
+			}
+			if (_event != NULL) {
+				CloseHandle(_event);
+			}
+			if (_mapping != NULL) {
+				CloseHandle(_mapping);
+			}
+		}
+
+		bool Wait(unsigned int timeoutMs)
+		{
+			return WaitForSingleObject(_event, timeoutMs) == WAIT_OBJECT_0;
+		}
+#else
+		//the mapping is opened by name, the eventfd is duplicated the way a host would be handed it
+		explicit RingReader(SharedMemoryRing& ring)
+		{
+			int descriptor = shm_open(ring.GetName().c_str(), O_RDWR | O_CLOEXEC, 0);
+			struct stat status;
+			if (descriptor >= 0 && fstat(descriptor, &status) == 0) {
+				void* view = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+				if (view != MAP_FAILED) {
+					_size = (size_t)status.st_size;
+					_header = (SharedMemoryRingHeader*)view;
+					_data = (unsigned char*)view + sizeof(SharedMemoryRingHeader);
+				}
+			}
+			if (descriptor >= 0) {
+				close(descriptor);
+			}
+			_event = dup(ring.GetEventDescriptor());
+		}
+
+		~RingReader()
+		{
+			if (_header != NULL) {
+				munmap(_header, _size);
+			}
+			if (_event >= 0) {
+				close(_event);
+			}
+		}
+
+		//reading the eventfd resets it, like waking on an auto reset event
+		bool Wait(unsigned int timeoutMs)
+		{
+			pollfd event = { _event, POLLIN, 0 };
+			uint64_t count;
+			return poll(&event, 1, (int)timeoutMs) == 1 && read(_event, &count, sizeof(count)) == sizeof(count);
+		}
+#endif
+
+		bool IsOpen()
+		{
+#ifdef _WIN32
+			return _header != NULL && _event != NULL;
+#else
+			return _header != NULL && _event >= 0;
+#endif
+		}
+
+		//packets start with their length like on the pipe, false when the ring is empty
+		bool Read(unsigned char buffer[], unsigned int& length)
+		{
+			const unsigned int read = _header->readIndex.load(std::memory_order_relaxed);
+			const unsigned int write = _header->writeIndex.load(std::memory_order_acquire);
+			if (read == write) {
+				return false;
+			}
+
+			CopyOut(read, (unsigned char*)&length, sizeof(length));
+			CopyOut(read, buffer, length);
+			_header->readIndex.store(read + length, std::memory_order_release);
+			return true;
+		}
+	};
+
+	//[u32 length][u32 command][keyName][r g b], what an unbatched per-key call costs on either transport
+	const unsigned int KeyPacketSize = 15;
+
+	void BuildKeyPacket(unsigned char packet[], unsigned int index)
+	{
+		const unsigned int command = LogiCommands::SetLightingForKeyWithKeyName;
+		memcpy(&packet[0], &KeyPacketSize, sizeof(KeyPacketSize));
+		memcpy(&packet[4], &command, sizeof(command));
+		memcpy(&packet[8], &index, sizeof(index));
+		packet[12] = (unsigned char)index;
+		packet[13] = (unsigned char)(index >> 8);
+		packet[14] = (unsigned char)(index >> 16);
+	}
+
+	std::string UniqueRingName(const char* purpose)
+	{
+		return std::string(SHARED_MEMORY_NAME_PREFIX) + purpose + "." + std::to_string(GetProcessIdentifier());
+	}
+}
+
+TEST(RingKeepsPacketsInOrderAcrossTheWrap)
+{
+	SharedMemoryRing ring;
+	CHECK(ring.Create(UniqueRingName("Test"), 64));
+	RingReader reader(ring);
+	CHECK(reader.IsOpen());
+	if (!reader.IsOpen()) {
+		return;
+	}
+
+	//15 byte packets don't divide 64, so they land on every offset of the wrap
+	for (unsigned int i = 0; i < 40; i++) {
+		unsigned char packet[KeyPacketSize];
+		BuildKeyPacket(packet, i);
+		PacketSegment segments[2] = {
+			{ packet, 8 },
+			{ packet + 8, KeyPacketSize - 8 },
+		};
+		CHECK(ring.Write(segments, 2));
+
+		unsigned char received[KeyPacketSize];
+		unsigned int length = 0;
+		CHECK(reader.Read(received, length));
+		CHECK(length == KeyPacketSize && memcmp(packet, received, KeyPacketSize) == 0);
+	}
+}
+
+TEST(RingRefusesPacketsThatDontFit)
+{
+	SharedMemoryRing ring;
+	CHECK(ring.Create(UniqueRingName("Full"), 64));
+
+	unsigned char packet[KeyPacketSize];
+	BuildKeyPacket(packet, 0);
+	PacketSegment segment = { packet, KeyPacketSize };
+	for (unsigned int i = 0; i < 4; i++) {
+		CHECK(ring.Write(&segment, 1));
+	}
+	CHECK(!ring.Write(&segment, 1));
+}
+
+TEST(RingOnlySignalsAnEmptyRing)
+{
+	SharedMemoryRing ring;
+	CHECK(ring.Create(UniqueRingName("Signal"), 256));
+	RingReader reader(ring);
+	if (!reader.IsOpen()) {
+		CHECK(reader.IsOpen());
+		return;
+	}
+
+	unsigned char packet[KeyPacketSize];
+	BuildKeyPacket(packet, 0);
+	PacketSegment segment = { packet, KeyPacketSize };
+	CHECK(ring.Write(&segment, 1));
+	CHECK(ring.Write(&segment, 1));
+	CHECK(reader.Wait(0));
+	//the second packet went to a ring the host hadn't drained, it needs no wake up
+	CHECK(!reader.Wait(0));
+}
+
+TEST(RingIsStalledOnlyWhileTheHostLeavesPacketsUnread)
+{
+	SharedMemoryRing ring;
+	CHECK(ring.Create(UniqueRingName("Stall"), 256));
+	RingReader reader(ring);
+	if (!reader.IsOpen()) {
+		CHECK(reader.IsOpen());
+		return;
+	}
+
+	unsigned char packet[KeyPacketSize];
+	unsigned char received[KeyPacketSize];
+	unsigned int length = 0;
+	BuildKeyPacket(packet, 0);
+	PacketSegment segment = { packet, KeyPacketSize };
+
+	//an idle host is fine however long it has been
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	CHECK(!ring.IsStalled(50));
+
+	CHECK(ring.Write(&segment, 1));
+	CHECK(ring.Write(&segment, 1));
+	CHECK(!ring.IsStalled(50));
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	CHECK(ring.IsStalled(50));
+
+	//any progress counts, the host may just be slow
+	CHECK(reader.Read(received, length));
+	CHECK(!ring.IsStalled(50));
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	CHECK(ring.IsStalled(50));
+
+	CHECK(reader.Read(received, length));
+	CHECK(!ring.IsStalled(0));
+}
+
+//Single game thread writing unbatched per-key packets as fast as it can, the other thread plays the host.
+//The ring is measured against the transport the client uses without it, one write per packet: a byte mode
+//pipe on Windows and a unix socket elsewhere.
+BENCHMARK(RingVersusPipeThroughput)
+{
+	const unsigned int packetCount = 200000;
+	unsigned char packet[KeyPacketSize];
+	BuildKeyPacket(packet, 1);
+
+	SharedMemoryRing ring;
+	if (!ring.Create(UniqueRingName("Bench"), SHARED_MEMORY_RING_CAPACITY)) {
+		CHECK(false);
+		return;
+	}
+
+	unsigned int wakeups = 0;
+	std::thread host([&] {
+		RingReader reader(ring);
+		unsigned char buffer[KeyPacketSize];
+		unsigned int length;
+		unsigned int received = 0;
+		while (received < packetCount) {
+			if (reader.Read(buffer, length)) {
+				received++;
+			}
+			else if (reader.Wait(1)) {
+				wakeups++;
+			}
+		}
+	});
+
+	PacketSegment segment = { packet, KeyPacketSize };
+	const double ringNs = MeasureNs(packetCount, [&](unsigned int) {
+		while (!ring.Write(&segment, 1)) {
+			std::this_thread::yield();
+		}
+	});
+	host.join();
+	ReportBenchmark("shared memory ring, ns/packet", ringNs, (std::to_string(wakeups) + " host wakeups").c_str());
+
+#ifdef _WIN32
+	const std::wstring pipeName = L"\\\\.\\pipe\\Artemis\\Logitech.Bench." + std::to_wstring(GetProcessIdentifier());
+	//no buffers, like the host's pipe, so the writer waits on the reader the way a game does
+	HANDLE server = CreateNamedPipeW(pipeName.c_str(), PIPE_ACCESS_INBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1, 0, 0, 0, NULL);
+	HANDLE client = CreateFileW(pipeName.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (server == INVALID_HANDLE_VALUE || client == INVALID_HANDLE_VALUE) {
+		CHECK(false);
+		return;
+	}
+	//the client is already there, this only makes sure of it
+	ConnectNamedPipe(server, NULL);
+
+	std::thread pipeHost([&] {
+		unsigned char buffer[65536];
+		unsigned long long remaining = (unsigned long long)packetCount * KeyPacketSize;
+		DWORD readLength = 0;
+		while (remaining > 0 && ReadFile(server, buffer, sizeof(buffer), &readLength, NULL)) {
+			remaining -= readLength;
+		}
+	});
+
+	const double pipeNs = MeasureNs(packetCount, [&](unsigned int) {
+		DWORD writtenLength = 0;
+		WriteFile(client, packet, KeyPacketSize, &writtenLength, NULL);
+	});
+	pipeHost.join();
+	ReportBenchmark("named pipe, ns/packet", pipeNs, nullptr);
+
+	CloseHandle(client);
+	CloseHandle(server);
+#else
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) {
+		CHECK(false);
+		return;
+	}
+
+	std::thread socketHost([&] {
+		unsigned char buffer[65536];
+		unsigned long long remaining = (unsigned long long)packetCount * KeyPacketSize;
+		ssize_t readLength = 0;
+		while (remaining > 0 && (readLength = read(sockets[1], buffer, sizeof(buffer))) > 0) {
+			remaining -= (unsigned long long)readLength;
+		}
+	});
+
+	const double socketNs = MeasureNs(packetCount, [&](unsigned int) {
+		const ssize_t writtenLength = write(sockets[0], packet, KeyPacketSize);
+		(void)writtenLength;
+	});
+	socketHost.join();
+	ReportBenchmark("unix socket, ns/packet", socketNs, nullptr);
+
+	close(sockets[0]);
+	close(sockets[1]);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+//A small self registering runner, the wrapper has nothing to pull a test framework from.
+//Tests run by default, benchmarks only with --bench since their numbers only mean something in Release.
+typedef void (*TestFunction)();
+
+struct TestCase {
+	const char* name;
+	TestFunction run;
+};
+
+std::vector<TestCase>& GetTests();
+std::vector<TestCase>& GetBenchmarks();
+void ReportFailure(const char* file, int line, const char* condition);
+//prints one benchmark result line
+void ReportBenchmark(const char* name, double nsPerIteration, const char* extra);
+//benchmarks hand what they computed to this, so the compiler can't drop the work
+void KeepResult(const void* result);
+
+struct TestRegistration {
+	TestRegistration(std::vector<TestCase>& cases, const char* name, TestFunction run)
+	{
+		cases.push_back({ name, run });
+	}
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(GetTests(), #name, name); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistration name##Registration(GetBenchmarks(), #name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			ReportFailure(__FILE__, __LINE__, #condition); \
+		} \
+	} while (0)
+
+//runs body iterations times and returns the average in nanoseconds
+template <typename Body>
+double MeasureNs(unsigned int iterations, Body body)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		body(i);
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+
+static int failures = 0;
+
+std::vector<TestCase>& GetTests()
+{
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+std::vector<TestCase>& GetBenchmarks()
+{
+	static std::vector<TestCase> benchmarks;
+	return benchmarks;
+}
+
+void ReportFailure(const char* file, int line, const char* condition)
+{
+	printf("  %s(%d): CHECK(%s) failed\n", file, line, condition);
+	failures++;
+}
+
+static void IgnoreResult(const void*)
+{
+}
+
+//called through a volatile pointer, not even whole program optimization can tell it does nothing
+static void (*volatile keepResult)(const void*) = IgnoreResult;
+
+void KeepResult(const void* result)
+{
+	keepResult(result);
+}
+
+void ReportBenchmark(const char* name, double nsPerIteration, const char* extra)
+{
+	printf("  %-40s %10.1f ns %s\n", name, nsPerIteration, extra ? extra : "");
+}
+
+int main(int argc, char* argv[])
+{
+	const bool bench = argc > 1 && strcmp(argv[1], "--bench") == 0;
+	std::vector<TestCase>& cases = bench ? GetBenchmarks() : GetTests();
+
+	for (const TestCase& testCase : cases) {
+		const int failuresBefore = failures;
+		printf("%s\n", testCase.name);
+		testCase.run();
+		if (failures != failuresBefore) {
+			printf("  FAILED\n");
+		}
+	}
+
+	printf("%u %s, %d failed checks\n", (unsigned int)cases.size(), bench ? "benchmarks" : "tests", failures);
+	return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -2,58 +2,874 @@
 #include "ArtemisPipeClient.h"
 #include "Logger.h"
 #include "Constants.h"
+#include "LogiCommands.h"
+#include "Platform.h"
+#include "PacketCodec.h"
+#include "BitmapKeyMap.h"
+
+ArtemisPipeClient::~ArtemisPipeClient()
+{
+	//we can't join from DllMain, the process is going away anyway.
+	if (_senderThread.joinable()) {
+		_senderThread.detach();
+	}
+}
 
 bool ArtemisPipeClient::IsConnected()
 {
 	return isConnected;
 }
 
+bool ArtemisPipeClient::IsStarted()
+{
+	return _started;
+}
+
+bool ArtemisPipeClient::HasFeature(unsigned int feature)
+{
+	return (_features & feature) == feature;
+}
+
+unsigned int ArtemisPipeClient::GetAdvertisedFeatures()
+{
+	unsigned int features = FEATURE_SEQUENCE_HEADER | FEATURE_BATCHING | FEATURE_DELTA_FRAMES | FEATURE_COMPACT_HEADER | FEATURE_LED_INDEX | FEATURE_SNAPSHOT;
+
+	//opt-in, the sender cannot tell the host is gone while packets bypass the pipe
+	if (GetEnvironmentInt(SHARED_MEMORY_ENV, 0)) {
+		features |= FEATURE_SHARED_MEMORY;
+	}
+	return features;
+}
+
+void ArtemisPipeClient::SetInitPacket(const PacketSegment segments[], unsigned int segmentCount)
+{
+	const unsigned int command = LogiCommands::Init;
+	unsigned int arraySize =
+		sizeof(arraySize) +
+		sizeof(command);
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		arraySize += segments[i].length;
+	}
+
+	if (arraySize > INIT_PACKET_MAX_SIZE) {
+		LOG(fmt::format("Init packet of {} bytes is too large", arraySize));
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	unsigned int buffPtr = 0;
+
+	memcpy(&_initPacket[buffPtr], &arraySize, sizeof(arraySize));
+	buffPtr += sizeof(arraySize);
+
+	memcpy(&_initPacket[buffPtr], &command, sizeof(command));
+	buffPtr += sizeof(command);
+
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		memcpy(&_initPacket[buffPtr], segments[i].data, segments[i].length);
+		buffPtr += segments[i].length;
+	}
+
+	_initPacketLength = arraySize;
+}
+
+void ArtemisPipeClient::SetRateBudget(RateBudget budget)
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	_governor.SetBudget(budget);
+	_throttled = false;
+	LOG(fmt::format("Rate budget is {} packets and {} bytes per second", budget.packetsPerSecond, budget.bytesPerSecond));
+}
+
+void ArtemisPipeClient::SetTransport(std::unique_ptr<Transport> transport)
+{
+	_transport = std::move(transport);
+}
+
+void ArtemisPipeClient::SetConnectionCallback(ConnectionFunction onConnectionChanged)
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	_onConnectionChanged = onConnectionChanged;
+}
+
+void ArtemisPipeClient::SetResyncCallback(ResyncFunction onReconnected)
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	_onReconnected = onReconnected;
+}
+
 void ArtemisPipeClient::Connect()
 {
-	LOG("Connecting to pipe...");
+	if (!_transport) {
+		_transport = Transport::Create(GetEnvironmentString(TRANSPORT_ENV));
+	}
+
+	const int keepaliveMs = GetEnvironmentInt(KEEPALIVE_INTERVAL_ENV, DEFAULT_KEEPALIVE_INTERVAL_MS);
+	_keepaliveMs = keepaliveMs < 0 ? 0 : (unsigned int)keepaliveMs;
+	LOG(fmt::format("Connecting to host over {}...", _transport->GetName()));
 
-	_pipe = CreateFile(
-		PIPE_NAME,
-		GENERIC_WRITE,
-		0,
-		NULL,
-		OPEN_EXISTING,
-		0,
-		NULL);
-	isConnected = _pipe != NULL && _pipe != INVALID_HANDLE_VALUE;
+	if (OpenPipe()) {
+		StartSender();
+		_queueCondition.notify_one();
+	}
 
 	LOG(isConnected ? "Connected to pipe successfully" : "Could not connect to pipe");
 }
 
+bool ArtemisPipeClient::OpenPipe()
+{
+	if (!_transport->Open()) {
+		return false;
+	}
+
+	unsigned int features = 0;
+	if (!Handshake(features)) {
+		_transport->Close();
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	isConnected = true;
+	_connectionCount++;
+	_sequence = 0;
+	_features = features;
+
+	if (HasFeature(FEATURE_SHARED_MEMORY) && _transport->CanAttachSharedMemory()) {
+		AttachSharedMemory();
+	}
+
+	if (_onConnectionChanged) {
+		_onConnectionChanged(true);
+	}
+	return true;
+}
+
+bool ArtemisPipeClient::Handshake(unsigned int& features)
+{
+	unsigned char initPacket[INIT_PACKET_MAX_SIZE];
+	unsigned int initPacketLength;
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		initPacketLength = _initPacketLength;
+		memcpy(initPacket, _initPacket, initPacketLength);
+	}
+
+	//every connection starts with Init, so a restarted host knows who we are.
+	//it always goes out in the legacy format, the host can't know which one we speak yet.
+	if (initPacketLength != 0 && !_transport->WriteWithin(initPacket, initPacketLength, HANDSHAKE_TIMEOUT_MS)) {
+		return false;
+	}
+
+	features = 0;
+	if (initPacketLength == 0 || !_transport->IsDuplex()) {
+		LOG("Host does not support the handshake, using the legacy protocol");
+		return true;
+	}
+
+	unsigned char reply[INIT_ACK_SIZE];
+	if (!_transport->Read(reply, INIT_ACK_SIZE, HANDSHAKE_TIMEOUT_MS)) {
+		LOG("Host did not answer the handshake");
+		return false;
+	}
+
+	unsigned int arraySize;
+	unsigned int command;
+	unsigned int version;
+	unsigned int hostFeatures;
+	unsigned int buffPtr = 0;
+
+	memcpy(&arraySize, &reply[buffPtr], sizeof(arraySize));
+	buffPtr += sizeof(arraySize);
+
+	memcpy(&command, &reply[buffPtr], sizeof(command));
+	buffPtr += sizeof(command);
+
+	memcpy(&version, &reply[buffPtr], sizeof(version));
+	buffPtr += sizeof(version);
+
+	memcpy(&hostFeatures, &reply[buffPtr], sizeof(hostFeatures));
+	buffPtr += sizeof(hostFeatures);
+
+	if (arraySize != INIT_ACK_SIZE || command != LogiCommands::InitAck) {
+		LOG(fmt::format("Unexpected handshake reply, command {} of {} bytes", command, arraySize));
+		return false;
+	}
+
+	//everything else builds on the sequence header
+	features = hostFeatures & GetAdvertisedFeatures();
+	if ((features & FEATURE_SEQUENCE_HEADER) == 0) {
+		features = 0;
+	}
+	LOG(fmt::format("Host speaks protocol version {}, using features {:#x}", version, features));
+	return true;
+}
+
+unsigned int ArtemisPipeClient::NextReconnectDelay(unsigned int& backoffMs)
+{
+	//+-25% jitter so several games don't hammer a restarting host in lockstep
+	unsigned int jitter = backoffMs / 2;
+	unsigned int delay = backoffMs - backoffMs / 4 + (jitter == 0 ? 0 : _random() % jitter);
+
+	backoffMs = backoffMs * 2 > RECONNECT_MAX_BACKOFF_MS ? RECONNECT_MAX_BACKOFF_MS : backoffMs * 2;
+	return delay;
+}
+
 void ArtemisPipeClient::Disconnect()
 {
-	LOG("Closing pipe...");
-	CloseHandle(_pipe);
-	isConnected = false;
-	LOG("Closed pipe");
+	LOG(fmt::format("Closing pipe, sending the {} packets still queued...", GetQueueDepth()));
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		if (_ring.IsOpen() && !_ringStalled && !_ring.WaitUntilEmpty(SHARED_MEMORY_DRAIN_TIMEOUT_MS)) {
+			LOG("Host did not drain the shared memory ring before disconnecting");
+		}
+	}
+	StopSender();
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		ClosePipe();
+		_bitmapEncoder.ClearExclusions();
+	}
+	LOG(fmt::format("Closed pipe. Sent {} packets, dropped {}, suppressed {}, max queue depth {}", GetSentPackets(), GetDroppedPackets(), GetSuppressedPackets(), GetMaxQueueDepth()));
+	LOG(fmt::format("Throttled {} times, {} packets held back", GetThrottleCount(), GetThrottledPackets()));
+	LOG(fmt::format("Writes stalled {} times, {} of them long enough to reconnect", GetWriteStalls(), GetStallDisconnects()));
+}
+
+void ArtemisPipeClient::Write(unsigned int command, const PacketSegment segments[], unsigned int segmentCount)
+{
+	//the sender thread is reconnecting, the host gets a fresh state once it is back
+	if (!isConnected) {
+		_droppedPackets++;
+		return;
+	}
+
+	unsigned int length = PACKET_HEADER_SIZE;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		length += segments[i].length;
+	}
+
+	if (segmentCount > MAX_PACKET_SEGMENTS || length > PACKET_QUEUE_SLOT_SIZE) {
+		LOG(fmt::format("Packet of {} bytes in {} segments does not fit in a queue slot, dropping it", length, segmentCount));
+		_droppedPackets++;
+		return;
+	}
+
+	bool queued;
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		queued = WriteLocked(command, segments, segmentCount);
+	}
+
+	if (queued) {
+		_queueCondition.notify_one();
+	}
 }
 
-void ArtemisPipeClient::Write(LPCVOID data, DWORD length)
+void ArtemisPipeClient::WriteBitmap(const unsigned char bitmap[])
 {
 	if (!isConnected) {
-		LOG("Pipe disconnected when writing, trying to reconnect...");
-		Connect();
+		_droppedPackets++;
+		return;
+	}
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+
+		const bool deltas = HasFeature(FEATURE_DELTA_FRAMES);
+		if (!deltas) {
+			queued = SyncExclusionsLocked();
+		}
+
+		//anything written or lost since our previous bitmap, or a new connection, means the host no longer shows it.
+		//an unchanged bitmap is sent again in full once the keepalive is due.
+		bool forceKeyframe =
+			_writeCount != _bitmapWriteCount ||
+			_droppedPackets != _bitmapDroppedPackets ||
+			_connectionCount != _bitmapConnectionCount ||
+			IsKeepaliveDueLocked();
+
+		//keyframes point straight at the caller's bitmap
+		unsigned int command;
+		PacketSegment payload;
+		if (_bitmapEncoder.Encode(bitmap, deltas, forceKeyframe, command, payload)) {
+			queued = WriteLocked(command, &payload, 1) || queued;
+		}
+		else {
+			_suppressedPackets++;
+		}
+
+		_bitmapWriteCount = _writeCount;
+		_bitmapDroppedPackets = _droppedPackets;
+		_bitmapConnectionCount = _connectionCount;
+	}
+
+	if (queued) {
+		_queueCondition.notify_one();
+	}
+}
+
+void ArtemisPipeClient::ExcludeKeysFromBitmap(const LogiLed::KeyName keys[], int keyCount)
+{
+	//kept while reconnecting too, they are synced once the host is back
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+
+		LogiLed::KeyName added[LOGI_LED_BITMAP_KEYS];
+		int addedCount = 0;
+		for (int i = 0; i < keyCount; i++) {
+			//keys outside the bitmap are never drawn from it, nothing to exclude
+			const int bitmapKey = GetBitmapKey(keys[i]);
+			if (bitmapKey >= 0 && _bitmapEncoder.Exclude(bitmapKey)) {
+				added[addedCount++] = keys[i];
+			}
+		}
+
+		//hosts with delta frames never see excluded pixels, the others filter them on their side
+		if (addedCount > 0 && isConnected && !HasFeature(FEATURE_DELTA_FRAMES)) {
+			queued = _exclusionConnectionCount == _connectionCount
+				? WriteExclusionsLocked(added, addedCount)
+				: SyncExclusionsLocked();
+		}
+	}
+
+	if (queued) {
+		_queueCondition.notify_one();
+	}
+}
+
+bool ArtemisPipeClient::SyncExclusionsLocked()
+{
+	if (_exclusionConnectionCount == _connectionCount) {
+		return false;
+	}
+	_exclusionConnectionCount = _connectionCount;
+
+	LogiLed::KeyName keys[LOGI_LED_BITMAP_KEYS];
+	int keyCount = 0;
+	for (unsigned int i = 0; i < LOGI_LED_BITMAP_KEYS; i++) {
+		if (_bitmapEncoder.IsExcluded(i)) {
+			keys[keyCount++] = GetBitmapKeyName(i);
+		}
+	}
+
+	return keyCount > 0 && WriteExclusionsLocked(keys, keyCount);
+}
+
+bool ArtemisPipeClient::WriteExclusionsLocked(const LogiLed::KeyName keys[], int keyCount)
+{
+	PacketSegment payload[2] = {
+		{ &keyCount, sizeof(keyCount) },
+		{ keys, (unsigned int)(sizeof(LogiLed::KeyName) * keyCount) },
+	};
+
+	return WriteLocked(LogiCommands::ExcludeKeysFromBitmap, payload, 2);
+}
+
+bool ArtemisPipeClient::IsThrottled()
+{
+	return _throttled;
+}
+
+bool ArtemisPipeClient::TryEndThrottle()
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	if (!_throttled || _stalled || !_governor.HasReserve(RATE_GOVERNOR_RESUME_MS)) {
+		return false;
+	}
+
+	_throttled = false;
+	return true;
+}
+
+bool ArtemisPipeClient::TryTakeKeepalive()
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	const unsigned long long tick = GetTickMs();
+	if (_keepaliveMs == 0 || !isConnected || _throttled || tick - _keepaliveTick < _keepaliveMs) {
+		return false;
+	}
+
+	//not again before the next interval, even when nothing gets through
+	_keepaliveTick = tick;
+	return true;
+}
+
+unsigned int ArtemisPipeClient::GetQueueDepth()
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	return _queueCount;
+}
+
+unsigned int ArtemisPipeClient::GetMaxQueueDepth()
+{
+	return _maxQueueDepth;
+}
+
+unsigned long long ArtemisPipeClient::GetSentPackets()
+{
+	return _sentPackets;
+}
+
+unsigned long long ArtemisPipeClient::GetDroppedPackets()
+{
+	return _droppedPackets;
+}
+
+unsigned long long ArtemisPipeClient::GetSuppressedPackets()
+{
+	return _suppressedPackets;
+}
+
+unsigned long long ArtemisPipeClient::GetThrottledPackets()
+{
+	return _throttledPackets;
+}
+
+unsigned int ArtemisPipeClient::GetThrottleCount()
+{
+	return _throttleCount;
+}
+
+unsigned int ArtemisPipeClient::GetWriteStalls()
+{
+	return _writeStalls;
+}
+
+unsigned int ArtemisPipeClient::GetStallDisconnects()
+{
+	return _stallDisconnects;
+}
+
+static bool IsLightingCommand(unsigned int command)
+{
+	switch (command) {
+	case LogiCommands::SetLighting:
+	case LogiCommands::SetLightingFromBitmap:
+	case LogiCommands::SetLightingFromBitmapDelta:
+	case LogiCommands::SetLightingForKeyWithScanCode:
+	case LogiCommands::SetLightingForKeyWithHidCode:
+	case LogiCommands::SetLightingForKeyWithQuartzCode:
+	case LogiCommands::SetLightingForKeyWithKeyName:
+	case LogiCommands::SetLightingForKeys:
+	case LogiCommands::SetLightingForKeysCompact:
+	case LogiCommands::SetLightingForLeds:
+	case LogiCommands::SetLightingForTargetZone:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool ArtemisPipeClient::IsSamePacket(const SentPacket& sent, unsigned int command, const PacketSegment segments[], unsigned int segmentCount)
+{
+	if (sent.command != command) {
+		return false;
+	}
+
+	unsigned int buffPtr = 0;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		if (buffPtr + segments[i].length > sent.length || memcmp(&sent.data[buffPtr], segments[i].data, segments[i].length) != 0) {
+			return false;
+		}
+		buffPtr += segments[i].length;
+	}
+	return buffPtr == sent.length;
+}
+
+void ArtemisPipeClient::RememberPacket(SentPacket& sent, unsigned int command, const PacketSegment segments[], unsigned int segmentCount, unsigned long long tick)
+{
+	unsigned int length = 0;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		length += segments[i].length;
+	}
+
+	//too large to compare, it is always sent
+	if (length > sizeof(sent.data)) {
+		sent.command = 0;
+		return;
+	}
+
+	sent.command = command;
+	sent.length = 0;
+	sent.tick = tick;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		memcpy(&sent.data[sent.length], segments[i].data, segments[i].length);
+		sent.length += segments[i].length;
+	}
+}
+
+bool ArtemisPipeClient::IsRedundantLocked(unsigned int command, const PacketSegment segments[], unsigned int segmentCount)
+{
+	if (_keepaliveMs == 0) {
+		return false;
+	}
+
+	//after a loss or a reconnect the host may not show what we sent last
+	if (_droppedPackets != _sentDroppedPackets || _connectionCount != _sentConnectionCount) {
+		_sentTarget.command = 0;
+		_sentLighting.command = 0;
+		_sentDroppedPackets = _droppedPackets;
+		_sentConnectionCount = _connectionCount;
+	}
+
+	const unsigned long long tick = GetTickMs();
+	if (command == LogiCommands::SetTargetDevice) {
+		if (IsSamePacket(_sentTarget, command, segments, segmentCount)) {
+			if (tick - _sentTarget.tick < _keepaliveMs) {
+				return true;
+			}
+			_sentTarget.tick = tick;
+			return false;
+		}
+
+		//the same lighting means something else on another target
+		RememberPacket(_sentTarget, command, segments, segmentCount, tick);
+		_sentLighting.command = 0;
+		return false;
+	}
+
+	if (IsLightingCommand(command)) {
+		if (IsSamePacket(_sentLighting, command, segments, segmentCount) && tick - _sentLighting.tick < _keepaliveMs) {
+			return true;
+		}
+		RememberPacket(_sentLighting, command, segments, segmentCount, tick);
+		return false;
+	}
+
+	//anything else may change how the host applies lighting
+	_sentTarget.command = 0;
+	_sentLighting.command = 0;
+	return false;
+}
+
+bool ArtemisPipeClient::AdmitLocked(unsigned int command, const PacketSegment segments[], unsigned int segmentCount)
+{
+	unsigned int length = 0;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		length += segments[i].length;
+	}
+
+	//the host has to see everything that isn't lighting, it still counts against the budget
+	if (!IsLightingCommand(command) && command != LogiCommands::SetTargetDevice) {
+		_governor.Consume(length);
+		return true;
+	}
+
+	//nothing gets through until the state was sent again, so the host never sees half of it
+	if (!_throttled && _governor.TryConsume(length)) {
+		return true;
+	}
+
+	if (!_throttled) {
+		_throttled = true;
+		if (_throttleCount++ == 0) {
+			LOG("Program went over its rate budget, lighting is sent as coalesced frames while it stays over");
+		}
+	}
+
+	//lost to the host like any dropped packet, so deltas and suppression start over
+	_throttledPackets++;
+	_droppedPackets++;
+	return false;
+}
+
+bool ArtemisPipeClient::IsKeepaliveDueLocked()
+{
+	return _keepaliveMs != 0 && GetTickMs() - _sentLighting.tick >= _keepaliveMs;
+}
+
+unsigned int ArtemisPipeClient::BuildHeader(unsigned int command, unsigned int bodyLength, unsigned int sequence, unsigned char header[])
+{
+	unsigned int buffPtr = 0;
+
+	if (HasFeature(FEATURE_COMPACT_HEADER)) {
+		return EncodeCompactHeader(command, bodyLength, sequence, header);
+	}
+
+	const unsigned int headerLength = HasFeature(FEATURE_SEQUENCE_HEADER) ? PACKET_HEADER_SIZE : sizeof(unsigned int) * 2;
+	const unsigned int arraySize = headerLength + bodyLength;
+
+	memcpy(&header[buffPtr], &arraySize, sizeof(arraySize));
+	buffPtr += sizeof(arraySize);
+
+	memcpy(&header[buffPtr], &command, sizeof(command));
+	buffPtr += sizeof(command);
+
+	//legacy hosts get nothing else
+	if (headerLength == buffPtr) {
+		return headerLength;
+	}
+
+	const long long timestamp = GetTimestamp();
+
+	memcpy(&header[buffPtr], &sequence, sizeof(sequence));
+	buffPtr += sizeof(sequence);
+
+	memcpy(&header[buffPtr], &timestamp, sizeof(timestamp));
+	buffPtr += sizeof(timestamp);
+
+	return headerLength;
+}
+
+bool ArtemisPipeClient::WriteLocked(unsigned int command, const PacketSegment segments[], unsigned int segmentCount)
+{
+	if (IsRedundantLocked(command, segments, segmentCount)) {
+		_suppressedPackets++;
+		return false;
+	}
+
+	if (!AdmitLocked(command, segments, segmentCount)) {
+		return false;
+	}
+
+	_writeCount++;
+	_keepaliveTick = GetTickMs();
+
+	//the header goes in front of the payload segments, nothing is staged
+	unsigned char header[PACKET_HEADER_SIZE];
+	PacketSegment packet[MAX_PACKET_SEGMENTS + 1];
+	unsigned int bodyLength = 0;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		packet[i + 1] = segments[i];
+		bodyLength += segments[i].length;
+	}
+	packet[0].data = header;
+	packet[0].length = BuildHeader(command, bodyLength, _sequence++, header);
+
+	if (_ring.IsOpen()) {
+		//the host only reads the ring, a dead one is noticed here and the sender thread reconnects
+		if (isConnected && !_ringStalled && _ring.IsStalled(WRITE_DISCONNECT_TIMEOUT_MS)) {
+			LOG(fmt::format("Host has not read the shared memory ring in {} ms, reconnecting", WRITE_DISCONNECT_TIMEOUT_MS));
+			_ringStalled = true;
+			_stallDisconnects++;
+			//wakes the sender thread like a queued packet
+			return true;
+		}
+
+		if (isConnected && !_ringStalled && _ring.Write(packet, segmentCount + 1)) {
+			_sentPackets++;
+		}
+		else {
+			_droppedPackets++;
+		}
+		return false;
+	}
+
+	return Enqueue(packet, segmentCount + 1);
+}
+
+bool ArtemisPipeClient::Enqueue(const PacketSegment segments[], unsigned int segmentCount)
+{
+	if (!isConnected || _queueCount == PACKET_QUEUE_CAPACITY) {
+		_droppedPackets++;
+		return false;
+	}
+
+	QueuedPacket& packet = _queue[(_queueHead + _queueCount) % PACKET_QUEUE_CAPACITY];
+	unsigned int length = 0;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		memcpy(&packet.data[length], segments[i].data, segments[i].length);
+		length += segments[i].length;
+	}
+	packet.length = length;
+
+	_queueCount++;
+	if (_queueCount > _maxQueueDepth) {
+		_maxQueueDepth = _queueCount;
+	}
+	return true;
+}
+
+void ArtemisPipeClient::AttachSharedMemory()
+{
+	std::string name = SHARED_MEMORY_NAME_PREFIX + std::to_string(GetProcessIdentifier()) + "." + std::to_string(_ringGeneration++);
+
+	if (!_ring.Create(name, SHARED_MEMORY_RING_CAPACITY)) {
+		return;
+	}
+
+	//the attach packet itself goes over the pipe, everything after it through the ring
+	unsigned int nameLength = (unsigned int)name.length() + 1;
+	unsigned char header[PACKET_HEADER_SIZE];
+	PacketSegment packet[2] = {
+		{ header, BuildHeader(LogiCommands::AttachSharedMemory, nameLength, _sequence++, header) },
+		{ name.c_str(), nameLength },
+	};
+
+	if (!Enqueue(packet, 2)) {
+		_ring.Close();
+	}
+}
+
+void ArtemisPipeClient::StartSender()
+{
+	if (_senderThread.joinable()) {
+		return;
+	}
+
+	_stopRequested = false;
+	_random.seed((unsigned int)GetTickMs() ^ GetProcessIdentifier());
+	_senderThread = std::thread(&ArtemisPipeClient::SenderLoop, this);
+	_started = true;
+}
+
+void ArtemisPipeClient::StopSender()
+{
+	if (!_senderThread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		_stopRequested = true;
+	}
+	_queueCondition.notify_one();
+	_senderThread.join();
+	_started = false;
+}
+
+void ArtemisPipeClient::SenderLoop()
+{
+	unsigned int backoffMs = RECONNECT_MIN_BACKOFF_MS;
+	std::unique_lock<std::mutex> lock(_queueMutex);
+	while (true) {
 		if (!isConnected) {
-			return;
+			if (_stopRequested) {
+				break;
+			}
+
+			lock.unlock();
+			bool reconnected = OpenPipe();
+			//nothing is queued yet, so the state goes out right behind Init
+			if (reconnected && _onReconnected) {
+				_onReconnected();
+			}
+			lock.lock();
+
+			if (reconnected) {
+				LOG("Pipe connection reestablished");
+				backoffMs = RECONNECT_MIN_BACKOFF_MS;
+			}
+			else {
+				_queueCondition.wait_for(lock, std::chrono::milliseconds(NextReconnectDelay(backoffMs)), [this] { return _stopRequested; });
+			}
+			continue;
+		}
+
+		_queueCondition.wait(lock, [this] { return _queueCount > 0 || _stopRequested || _ringStalled; });
+
+		if (_ringStalled) {
+			_ringStalled = false;
+			_droppedPackets += _queueCount;
+			_queueCount = 0;
+			ClosePipe();
+			continue;
 		}
-		LOG("Pipe connection reestablished");
+
+		//on stop we still drain what is queued, so the shutdown packet makes it through
+		if (_queueCount == 0) {
+			break;
+		}
+
+		//producers never touch counted slots, so they can be read unlocked
+		unsigned int available = _queueCount;
+		lock.unlock();
+
+		const unsigned char* data;
+		unsigned int length;
+		unsigned int packetCount = 1;
+		if (available > 1 && HasFeature(FEATURE_BATCHING)) {
+			packetCount = BuildBatch(available, data, length);
+		}
+		if (packetCount == 1) {
+			data = _queue[_queueHead].data;
+			length = _queue[_queueHead].length;
+		}
+
+		bool result = WriteToTransport(data, length, lock);
+
+		lock.lock();
+		_queueHead = (_queueHead + packetCount) % PACKET_QUEUE_CAPACITY;
+		_queueCount -= packetCount;
+
+		if (!result) {
+			_droppedPackets += _queueCount + packetCount;
+			_queueCount = 0;
+			ClosePipe();
+			continue;
+		}
+
+		_sentPackets += packetCount;
+	}
+}
+
+bool ArtemisPipeClient::WriteToTransport(const unsigned char* data, unsigned int length, std::unique_lock<std::mutex>& lock)
+{
+	Transport::WriteStatus status = _transport->Write(data, length, WRITE_STALL_TIMEOUT_MS);
+	if (status != Transport::WriteStatus::Pending) {
+		return status == Transport::WriteStatus::Written;
 	}
 
-	DWORD writtenLength;
-	BOOL result = WriteFile(
-		_pipe,
-		data,
-		length,
-		&writtenLength,
-		NULL);
+	//the host stopped reading. Lighting is only kept as the latest state until it catches up,
+	//the game never waits on it since producers don't need anything the write holds.
+	lock.lock();
+	_stalled = true;
+	_throttled = true;
+	_writeStalls++;
+	lock.unlock();
+	LOG(fmt::format("Host has not taken a write in {} ms, keeping only the latest lighting", WRITE_STALL_TIMEOUT_MS));
 
-	if ((!result) || (writtenLength < length)) {
-		LOG(fmt::format("Error writing to pipe: \'{error}\'. Wrote {bytes} bytes out of {total}", result, writtenLength, length));
-		Disconnect();
+	status = _transport->WaitForWrite(WRITE_DISCONNECT_TIMEOUT_MS - WRITE_STALL_TIMEOUT_MS);
+	if (status == Transport::WriteStatus::Pending) {
+		LOG(fmt::format("Host has not taken a write in {} ms, reconnecting", WRITE_DISCONNECT_TIMEOUT_MS));
+		_transport->CancelWrite();
+		_stallDisconnects++;
+		status = Transport::WriteStatus::Failed;
 	}
+
+	_stalled = false;
+	return status == Transport::WriteStatus::Written;
 }
+
+unsigned int ArtemisPipeClient::BuildBatch(unsigned int available, const unsigned char*& data, unsigned int& length)
+{
+	//compact headers depend on the length, so the envelope header goes in last, right in front of the contents
+	unsigned int buffPtr = PACKET_HEADER_SIZE;
+	unsigned int packetCount = 0;
+
+	while (packetCount < available) {
+		const QueuedPacket& packet = _queue[(_queueHead + packetCount) % PACKET_QUEUE_CAPACITY];
+		if (buffPtr + packet.length > BATCH_BUFFER_SIZE) {
+			break;
+		}
+
+		//sub-packets keep their own stamped header
+		memcpy(&_batchBuffer[buffPtr], packet.data, packet.length);
+		buffPtr += packet.length;
+		packetCount++;
+	}
+
+	//the envelope has no sequence number of its own, the host only counts what is inside it
+	const unsigned int bodyLength = buffPtr - PACKET_HEADER_SIZE;
+	unsigned char header[PACKET_HEADER_SIZE];
+	const unsigned int headerLength = BuildHeader(LogiCommands::Batch, bodyLength, 0, header);
+	memcpy(&_batchBuffer[PACKET_HEADER_SIZE - headerLength], header, headerLength);
+
+	data = &_batchBuffer[PACKET_HEADER_SIZE - headerLength];
+	length = headerLength + bodyLength;
+	return packetCount;
+}
+
+void ArtemisPipeClient::ClosePipe()
+{
+	if (_transport) {
+		_transport->Close();
+	}
+	_ring.Close();
+
+	if (isConnected && _onConnectionChanged) {
+		_onConnectionChanged(false);
+	}
+	isConnected = false;
+}
\ No newline at end of file
@@ -1,13 +1,167 @@
 #pragma once
+#include "Constants.h"
+#include "SharedMemoryRing.h"
+#include "BitmapDeltaEncoder.h"
+#include "Transport.h"
+#include "PacketSegment.h"
+#include "RateGovernor.h"
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
 class ArtemisPipeClient
 {
+public:
+	//called with the queue locked whenever the connection comes or goes, it must not write
+	typedef void (*ConnectionFunction)(bool connected);
+	//called on the sender thread after it reopened the pipe, with nothing locked. The host may have been
+	//restarted or cleared its state, the callback writes everything the game has set so far.
+	typedef void (*ResyncFunction)();
 private:
-	bool isConnected = false;
-	HANDLE _pipe = NULL;
+	struct QueuedPacket {
+		unsigned int length;
+		unsigned char data[PACKET_QUEUE_SLOT_SIZE];
+	};
+
+	std::atomic<bool> isConnected{ false };
+	ConnectionFunction _onConnectionChanged = nullptr;
+	ResyncFunction _onReconnected = nullptr;
+	//negotiated with the host on every connection, 0 for hosts from before the handshake
+	std::atomic<unsigned int> _features{ 0 };
+	//picked from the environment on the first Connect, only used by one thread at a time
+	std::unique_ptr<Transport> _transport;
+
+	//packets are copied into preallocated slots by the calling thread
+	//and written to the pipe by the sender thread, in order.
+	QueuedPacket _queue[PACKET_QUEUE_CAPACITY];
+	unsigned int _queueHead = 0;
+	unsigned int _queueCount = 0;
+	std::mutex _queueMutex;
+	std::condition_variable _queueCondition;
+	std::thread _senderThread;
+	std::atomic<bool> _started{ false };
+	bool _stopRequested = false;
+
+	//the sender thread reopens the pipe in the background, the game never waits on CreateFile
+	unsigned char _initPacket[INIT_PACKET_MAX_SIZE];
+	unsigned int _initPacketLength = 0;
+	std::minstd_rand _random;
+
+	//several queued packets are sent as one Batch envelope, only touched by the sender thread
+	unsigned char _batchBuffer[BATCH_BUFFER_SIZE];
+
+	//when attached, packets bypass the queue and go straight into shared memory
+	SharedMemoryRing _ring;
+	unsigned int _ringGeneration = 0;
+	//the host left packets in the ring unread for too long, the sender thread closes the connection
+	bool _ringStalled = false;
+
+	//bitmaps are delta encoded against the previous one while nothing else was written in between
+	BitmapDeltaEncoder _bitmapEncoder;
+	unsigned long long _writeCount = 0;
+	unsigned int _connectionCount = 0;
+	//restarts at 0 for every connection, dropped packets still use up their number so the host sees the gap
+	unsigned int _sequence = 0;
+	unsigned long long _bitmapWriteCount = 0;
+	unsigned long long _bitmapDroppedPackets = 0;
+	unsigned int _bitmapConnectionCount = 0;
+	//hosts without delta frames apply exclusions themselves and get the full set once per connection
+	unsigned int _exclusionConnectionCount = 0;
+
+	//the last target device and lighting packet that went out, a game repeating one changes nothing on the host.
+	//repeats are suppressed until the keepalive interval has passed since the packet was sent.
+	struct SentPacket {
+		unsigned int command = 0;
+		unsigned int length = 0;
+		unsigned long long tick = 0;
+		unsigned char data[PACKET_QUEUE_SLOT_SIZE];
+	};
+	SentPacket _sentTarget;
+	SentPacket _sentLighting;
+	unsigned long long _sentDroppedPackets = 0;
+	unsigned int _sentConnectionCount = 0;
+	//0 turns suppression and the keepalive off
+	unsigned int _keepaliveMs = 0;
+	//when the last packet went out, the keepalive is due once nothing was sent for the interval
+	unsigned long long _keepaliveTick = 0;
+
+	//lighting past the program's budget is dropped until the wrapper has sent its state again
+	RateGovernor _governor;
+	std::atomic<bool> _throttled{ false };
+	//a write is past WRITE_STALL_TIMEOUT_MS, throttling can't end before it went through
+	std::atomic<bool> _stalled{ false };
+
+	std::atomic<unsigned long long> _sentPackets{ 0 };
+	std::atomic<unsigned long long> _droppedPackets{ 0 };
+	std::atomic<unsigned int> _maxQueueDepth{ 0 };
+	std::atomic<unsigned long long> _suppressedPackets{ 0 };
+	std::atomic<unsigned long long> _throttledPackets{ 0 };
+	std::atomic<unsigned int> _throttleCount{ 0 };
+	std::atomic<unsigned int> _writeStalls{ 0 };
+	std::atomic<unsigned int> _stallDisconnects{ 0 };
+
+	bool OpenPipe();
+	bool Handshake(unsigned int& features);
+	unsigned int NextReconnectDelay(unsigned int& backoffMs);
+	unsigned int BuildHeader(unsigned int command, unsigned int bodyLength, unsigned int sequence, unsigned char header[]);
+	bool WriteLocked(unsigned int command, const PacketSegment segments[], unsigned int segmentCount);
+	static bool IsSamePacket(const SentPacket& sent, unsigned int command, const PacketSegment segments[], unsigned int segmentCount);
+	static void RememberPacket(SentPacket& sent, unsigned int command, const PacketSegment segments[], unsigned int segmentCount, unsigned long long tick);
+	bool IsRedundantLocked(unsigned int command, const PacketSegment segments[], unsigned int segmentCount);
+	bool IsKeepaliveDueLocked();
+	bool AdmitLocked(unsigned int command, const PacketSegment segments[], unsigned int segmentCount);
+	bool WriteExclusionsLocked(const LogiLed::KeyName keys[], int keyCount);
+	bool SyncExclusionsLocked();
+	bool Enqueue(const PacketSegment segments[], unsigned int segmentCount);
+	void AttachSharedMemory();
+	unsigned int BuildBatch(unsigned int available, const unsigned char*& data, unsigned int& length);
+	bool WriteToTransport(const unsigned char* data, unsigned int length, std::unique_lock<std::mutex>& lock);
+	void SenderLoop();
+	void StartSender();
+	void StopSender();
+	void ClosePipe();
 public:
+	~ArtemisPipeClient();
+
 	bool IsConnected();
+	//true from a successful Connect until Disconnect, while the pipe may come and go in between
+	bool IsStarted();
+	bool HasFeature(unsigned int feature);
+	unsigned int GetAdvertisedFeatures();
+	//the Init header is added here, segments hold its payload
+	void SetInitPacket(const PacketSegment segments[], unsigned int segmentCount);
+	void SetRateBudget(RateBudget budget);
+	//replaces the transport picked from the environment, only before the first Connect
+	void SetTransport(std::unique_ptr<Transport> transport);
+	void SetConnectionCallback(ConnectionFunction onConnectionChanged);
+	void SetResyncCallback(ResyncFunction onReconnected);
 	void Connect();
 	void Disconnect();
-	void Write(LPCVOID data, DWORD length);
-};
+	void Write(unsigned int command, const PacketSegment segments[], unsigned int segmentCount);
+	void WriteBitmap(const unsigned char bitmap[]);
+	//exclusions add up until Disconnect, keys that were already excluded are not sent again
+	void ExcludeKeysFromBitmap(const LogiLed::KeyName keys[], int keyCount);
+
+	//true from the first lighting packet over budget or the first stalled write until TryEndThrottle,
+	//lighting sent in between is dropped
+	bool IsThrottled();
+	//true once, when the budget has recovered and the caller should send its whole state
+	bool TryEndThrottle();
+	//true once per keepalive interval without packets, the caller should send its whole state
+	bool TryTakeKeepalive();
 
+	unsigned int GetQueueDepth();
+	unsigned int GetMaxQueueDepth();
+	unsigned long long GetSentPackets();
+	unsigned long long GetDroppedPackets();
+	unsigned long long GetSuppressedPackets();
+	//throttled packets count as dropped too
+	unsigned long long GetThrottledPackets();
+	unsigned int GetThrottleCount();
+	unsigned int GetWriteStalls();
+	//stalls that lasted past WRITE_DISCONNECT_TIMEOUT_MS
+	unsigned int GetStallDisconnects();
+};
\ No newline at end of file
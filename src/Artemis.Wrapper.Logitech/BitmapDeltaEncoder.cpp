@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "BitmapDeltaEncoder.h"
+#include "Constants.h"
+#include "LogiCommands.h"
+
+bool BitmapDeltaEncoder::Encode(const unsigned char bitmap[], bool deltas, bool forceKeyframe, unsigned int& command, PacketSegment& payload)
+{
+	const bool keyframe = forceKeyframe || !_hasPrevious || _framesSinceKeyframe >= BITMAP_KEYFRAME_INTERVAL;
+	if (!deltas || (keyframe && _excludedCount == 0)) {
+		EncodeKeyframe(bitmap, command, payload);
+		return true;
+	}
+
+	unsigned char* mask = &_delta[0];
+	unsigned int changedKeys;
+	if (keyframe) {
+		//every key that isn't excluded
+		for (unsigned int i = 0; i < BITMAP_DELTA_MASK_SIZE; i++) {
+			mask[i] = (unsigned char)~_excluded[i];
+		}
+		mask[BITMAP_DELTA_MASK_SIZE - 1] &= (unsigned char)(0xFF >> (BITMAP_DELTA_MASK_SIZE * 8 - LOGI_LED_BITMAP_KEYS));
+		changedKeys = LOGI_LED_BITMAP_KEYS - _excludedCount;
+	}
+	else {
+		changedKeys = DiffBitmap(bitmap, _previous, _excluded, mask);
+	}
+
+	if (changedKeys == 0 && !keyframe) {
+		return false;
+	}
+
+	//past this point the delta is no smaller than the full bitmap, which is only allowed to carry every key
+	if (_excludedCount == 0 && BITMAP_DELTA_MASK_SIZE + changedKeys * LOGI_LED_BITMAP_BYTES_PER_KEY >= LOGI_LED_BITMAP_SIZE) {
+		EncodeKeyframe(bitmap, command, payload);
+		return true;
+	}
+
+	unsigned int buffPtr = BITMAP_DELTA_MASK_SIZE;
+	for (unsigned int i = 0; i < BITMAP_DELTA_MASK_SIZE; i++) {
+		for (unsigned int bits = mask[i]; bits != 0; bits &= bits - 1) {
+			unsigned int bit = 0;
+			while ((bits & (1 << bit)) == 0) {
+				bit++;
+			}
+
+			memcpy(&_delta[buffPtr], &bitmap[(i * 8 + bit) * LOGI_LED_BITMAP_BYTES_PER_KEY], LOGI_LED_BITMAP_BYTES_PER_KEY);
+			buffPtr += LOGI_LED_BITMAP_BYTES_PER_KEY;
+		}
+	}
+
+	command = LogiCommands::SetLightingFromBitmapDelta;
+	payload.data = _delta;
+	payload.length = buffPtr;
+
+	memcpy(_previous, bitmap, LOGI_LED_BITMAP_SIZE);
+	_hasPrevious = true;
+	_framesSinceKeyframe = keyframe ? 0 : _framesSinceKeyframe + 1;
+	return true;
+}
+
+void BitmapDeltaEncoder::Reset()
+{
+	_hasPrevious = false;
+}
+
+bool BitmapDeltaEncoder::Exclude(unsigned int bitmapKey)
+{
+	if (bitmapKey >= LOGI_LED_BITMAP_KEYS || IsExcluded(bitmapKey)) {
+		return false;
+	}
+
+	_excluded[bitmapKey / 8] |= (unsigned char)(1 << (bitmapKey % 8));
+	_excludedCount++;
+	return true;
+}
+
+bool BitmapDeltaEncoder::IsExcluded(unsigned int bitmapKey)
+{
+	return (_excluded[bitmapKey / 8] & (1 << (bitmapKey % 8))) != 0;
+}
+
+unsigned int BitmapDeltaEncoder::GetExcludedCount()
+{
+	return _excludedCount;
+}
+
+void BitmapDeltaEncoder::ClearExclusions()
+{
+	memset(_excluded, 0, sizeof(_excluded));
+	_excludedCount = 0;
+}
+
+void BitmapDeltaEncoder::EncodeKeyframe(const unsigned char bitmap[], unsigned int& command, PacketSegment& payload)
+{
+	command = LogiCommands::SetLightingFromBitmap;
+	payload.data = bitmap;
+	payload.length = LOGI_LED_BITMAP_SIZE;
+
+	memcpy(_previous, bitmap, LOGI_LED_BITMAP_SIZE);
+	_hasPrevious = true;
+	_framesSinceKeyframe = 0;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "LogitechLEDLib.h"
+#include "PacketSegment.h"
+#include "BitmapKernel.h"
+
+//Turns bitmaps into SetLightingFromBitmap keyframes or SetLightingFromBitmapDelta packets
+//holding a change mask plus only the pixels that differ from the previous bitmap.
+//Keys excluded from the bitmap are left out of deltas, once any are excluded keyframes
+//are sent as a delta holding every other key so excluded pixels never reach the host.
+class BitmapDeltaEncoder
+{
+private:
+	unsigned char _previous[LOGI_LED_BITMAP_SIZE];
+	//mask plus changed pixels, a keyframe with few exclusions can be a little larger than a full bitmap
+	unsigned char _delta[BITMAP_DELTA_MASK_SIZE + LOGI_LED_BITMAP_SIZE];
+	unsigned char _excluded[BITMAP_DELTA_MASK_SIZE] = {};
+	unsigned int _excludedCount = 0;
+	bool _hasPrevious = false;
+	unsigned int _framesSinceKeyframe = 0;
+
+	void EncodeKeyframe(const unsigned char bitmap[], unsigned int& command, PacketSegment& payload);
+public:
+	//false when nothing changed since the previous bitmap. The payload points into bitmap
+	//or into this encoder and stays valid until the next call.
+	//Without deltas every bitmap is a full keyframe and the host applies exclusions itself.
+	bool Encode(const unsigned char bitmap[], bool deltas, bool forceKeyframe, unsigned int& command, PacketSegment& payload);
+	void Reset();
+
+	//false when the key was already excluded
+	bool Exclude(unsigned int bitmapKey);
+	bool IsExcluded(unsigned int bitmapKey);
+	unsigned int GetExcludedCount();
+	void ClearExclusions();
+};
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "BitmapKernel.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define BITMAP_KERNEL_X86
+#include <intrin.h>
+#define AVX2_FUNCTION
+#elif defined(__i386__) || defined(__x86_64__)
+#define BITMAP_KERNEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+//GCC and Clang only emit AVX2 in functions that ask for it, the CPU is checked before calling them
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+//the changed bits are gathered in two 64 bit words before the exclusions are applied
+static_assert(BITMAP_DELTA_MASK_SIZE <= 16, "The dirty mask must fit in 128 bits");
+static_assert(LOGI_LED_BITMAP_BYTES_PER_KEY == 4, "Pixels are compared as 32 bit words");
+
+typedef unsigned int (*DiffFunction)(const unsigned char[], const unsigned char[], const unsigned char[], unsigned char[]);
+
+static unsigned int CountBits(unsigned long long value)
+{
+	value = value - ((value >> 1) & 0x5555555555555555ULL);
+	value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+	value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned int)((value * 0x0101010101010101ULL) >> 56);
+}
+
+static void DiffTail(const unsigned char bitmap[], const unsigned char previous[], unsigned int key, unsigned long long changed[2])
+{
+	for (; key < LOGI_LED_BITMAP_KEYS; key++) {
+		const unsigned int offset = key * LOGI_LED_BITMAP_BYTES_PER_KEY;
+		if (memcmp(&bitmap[offset], &previous[offset], LOGI_LED_BITMAP_BYTES_PER_KEY) != 0) {
+			changed[key / 64] |= 1ULL << (key % 64);
+		}
+	}
+}
+
+static unsigned int ApplyExclusions(const unsigned long long changed[2], const unsigned char excluded[], unsigned char dirtyMask[])
+{
+	unsigned long long dirty[2] = { 0, 0 };
+	for (unsigned int i = 0; i < BITMAP_DELTA_MASK_SIZE; i++) {
+		dirtyMask[i] = (unsigned char)(changed[i / 8] >> ((i % 8) * 8)) & (unsigned char)~excluded[i];
+		dirty[i / 8] |= (unsigned long long)dirtyMask[i] << ((i % 8) * 8);
+	}
+	return CountBits(dirty[0]) + CountBits(dirty[1]);
+}
+
+static unsigned int DiffScalar(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[])
+{
+	unsigned long long changed[2] = { 0, 0 };
+	DiffTail(bitmap, previous, 0, changed);
+	return ApplyExclusions(changed, excluded, dirtyMask);
+}
+
+#ifdef BITMAP_KERNEL_X86
+//4 pixels per compare, groups never straddle a 64 bit word
+static unsigned int DiffSse2(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[])
+{
+	unsigned long long changed[2] = { 0, 0 };
+	unsigned int key = 0;
+	for (; key + 4 <= LOGI_LED_BITMAP_KEYS; key += 4) {
+		const __m128i current = _mm_loadu_si128((const __m128i*)&bitmap[key * LOGI_LED_BITMAP_BYTES_PER_KEY]);
+		const __m128i last = _mm_loadu_si128((const __m128i*)&previous[key * LOGI_LED_BITMAP_BYTES_PER_KEY]);
+		const unsigned int equal = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(current, last)));
+		changed[key / 64] |= (unsigned long long)(~equal & 0xF) << (key % 64);
+	}
+
+	DiffTail(bitmap, previous, key, changed);
+	return ApplyExclusions(changed, excluded, dirtyMask);
+}
+
+//8 pixels per compare
+AVX2_FUNCTION static unsigned int DiffAvx2(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[])
+{
+	unsigned long long changed[2] = { 0, 0 };
+	unsigned int key = 0;
+	for (; key + 8 <= LOGI_LED_BITMAP_KEYS; key += 8) {
+		const __m256i current = _mm256_loadu_si256((const __m256i*)&bitmap[key * LOGI_LED_BITMAP_BYTES_PER_KEY]);
+		const __m256i last = _mm256_loadu_si256((const __m256i*)&previous[key * LOGI_LED_BITMAP_BYTES_PER_KEY]);
+		const unsigned int equal = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(current, last)));
+		changed[key / 64] |= (unsigned long long)(~equal & 0xFF) << (key % 64);
+	}
+	//no AVX to SSE transition penalty for the scalar tail or whatever the game runs next
+	_mm256_zeroupper();
+
+	DiffTail(bitmap, previous, key, changed);
+	return ApplyExclusions(changed, excluded, dirtyMask);
+}
+
+#ifdef _MSC_VER
+static void CpuId(int info[4], int leaf, int subleaf)
+{
+	__cpuidex(info, leaf, subleaf);
+}
+
+static unsigned long long ReadXcr(unsigned int index)
+{
+	return _xgetbv(index);
+}
+#else
+static void CpuId(int info[4], int leaf, int subleaf)
+{
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+}
+
+//without -mxsave there is no intrinsic for it
+static unsigned long long ReadXcr(unsigned int index)
+{
+	unsigned int low, high;
+	__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(index));
+	return ((unsigned long long)high << 32) | low;
+}
+#endif
+
+static bool HasAvx2()
+{
+	int info[4];
+	CpuId(info, 0, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+
+	CpuId(info, 1, 0);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	//the OS has to save the ymm registers on context switches too
+	if (!osxsave || !avx || (ReadXcr(0) & 0x6) != 0x6) {
+		return false;
+	}
+
+	CpuId(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+static bool HasSse2()
+{
+	int info[4];
+	CpuId(info, 1, 0);
+	return (info[3] & (1 << 26)) != 0;
+}
+#endif
+
+static DiffFunction SelectDiff()
+{
+#ifdef BITMAP_KERNEL_X86
+	if (HasAvx2()) {
+		return DiffAvx2;
+	}
+	if (HasSse2()) {
+		return DiffSse2;
+	}
+#endif
+	return DiffScalar;
+}
+
+unsigned int DiffBitmap(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[])
+{
+	static const DiffFunction diff = SelectDiff();
+	return diff(bitmap, previous, excluded, dirtyMask);
+}
+
+unsigned int DiffBitmapScalar(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[])
+{
+	return DiffScalar(bitmap, previous, excluded, dirtyMask);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include "LogitechLEDLib.h"
+
+#define LOGI_LED_BITMAP_KEYS (LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT)
+//one bit per key, rounded up to whole bytes
+#define BITMAP_DELTA_MASK_SIZE ((LOGI_LED_BITMAP_KEYS + 7) / 8)
+
+//Sets a bit in dirtyMask for every pixel of bitmap that differs from previous and isn't set in
+//excluded, and returns how many bits it set. Picks AVX2 or SSE2 on the first call when the CPU
+//has them, every path gives the same result.
+unsigned int DiffBitmap(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[]);
+//The portable path, to check and time the vector paths against.
+unsigned int DiffBitmapScalar(const unsigned char bitmap[], const unsigned char previous[], const unsigned char excluded[], unsigned char dirtyMask[]);
\ No newline at end of file
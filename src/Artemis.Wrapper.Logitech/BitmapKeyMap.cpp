@@ -0,0 +1,37 @@
+#include "pch.h"
+#include "BitmapKeyMap.h"
+
+using namespace LogiLed;
+
+#define NO_KEY ((KeyName)0)
+
+static const KeyName BitmapKeyNames[LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT] = {
+	ESC, F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12, PRINT_SCREEN, SCROLL_LOCK, PAUSE_BREAK, NO_KEY, NO_KEY, NO_KEY, NO_KEY, NO_KEY,
+	TILDE, ONE, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT, NINE, ZERO, MINUS, EQUALS, BACKSPACE, INSERT, HOME, PAGE_UP, NUM_LOCK, NUM_SLASH, NUM_ASTERISK, NUM_MINUS,
+	TAB, Q, W, E, R, T, Y, U, I, O, P, OPEN_BRACKET, CLOSE_BRACKET, BACKSLASH, KEYBOARD_DELETE, END, PAGE_DOWN, NUM_SEVEN, NUM_EIGHT, NUM_NINE, NUM_PLUS,
+	CAPS_LOCK, A, S, D, F, G, H, J, K, L, SEMICOLON, APOSTROPHE, NO_KEY, ENTER, NO_KEY, NO_KEY, NO_KEY, NUM_FOUR, NUM_FIVE, NUM_SIX, NO_KEY,
+	LEFT_SHIFT, NO_KEY, Z, X, C, V, B, N, M, COMMA, PERIOD, FORWARD_SLASH, NO_KEY, RIGHT_SHIFT, NO_KEY, ARROW_UP, NO_KEY, NUM_ONE, NUM_TWO, NUM_THREE, NUM_ENTER,
+	LEFT_CONTROL, LEFT_WINDOWS, LEFT_ALT, NO_KEY, NO_KEY, SPACE, NO_KEY, NO_KEY, NO_KEY, NO_KEY, NO_KEY, RIGHT_ALT, RIGHT_WINDOWS, APPLICATION_SELECT, RIGHT_CONTROL, ARROW_LEFT, ARROW_DOWN, ARROW_RIGHT, NUM_ZERO, NUM_PERIOD, NO_KEY,
+};
+
+int GetBitmapKey(KeyName keyName)
+{
+	if (keyName == NO_KEY) {
+		return -1;
+	}
+
+	for (int i = 0; i < LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT; i++) {
+		if (BitmapKeyNames[i] == keyName) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+KeyName GetBitmapKeyName(unsigned int bitmapKey)
+{
+	if (bitmapKey >= LOGI_LED_BITMAP_WIDTH * LOGI_LED_BITMAP_HEIGHT) {
+		return NO_KEY;
+	}
+	return BitmapKeyNames[bitmapKey];
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+#include "LogitechLEDLib.h"
+
+//Position of each key in the 21x6 bitmap, matches BitmapMap on the host.
+//Returns -1 for keys that have no place in the bitmap, like the G keys.
+int GetBitmapKey(LogiLed::KeyName keyName);
+//(LogiLed::KeyName)0 for unused bitmap positions
+LogiLed::KeyName GetBitmapKeyName(unsigned int bitmapKey);
\ No newline at end of file
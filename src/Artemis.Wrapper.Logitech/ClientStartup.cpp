@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "ClientStartup.h"
+#include "Constants.h"
+#include "Platform.h"
+#include "RateGovernor.h"
+#include <cstring>
+#include <thread>
+
+ClientStartup::ClientStartup(ArtemisPipeClient& client, FrameCoalescer& frameCoalescer, EffectEngine& effectEngine,
+	ArtemisPipeClient::ConnectionFunction onConnectionChanged, ArtemisPipeClient::ResyncFunction onReconnected, FrameCoalescer::TickFunction onFlushTick)
+	: _client(client), _frameCoalescer(frameCoalescer), _effectEngine(effectEngine),
+	_onConnectionChanged(onConnectionChanged), _onReconnected(onReconnected), _onFlushTick(onFlushTick)
+{
+}
+
+void ClientStartup::Prepare(const char name[], const std::string& programName)
+{
+	const char terminator = '\0';
+	const unsigned int version = PROTOCOL_VERSION;
+	const unsigned int features = _client.GetAdvertisedFeatures();
+
+	//hosts from before the handshake only log the name and ignore what follows it
+	PacketSegment payload[4] = {
+		{ name, (unsigned int)strnlen(name, MAX_PROGRAM_NAME_LENGTH) },
+		{ &terminator, sizeof(terminator) },
+		{ &version, sizeof(version) },
+		{ &features, sizeof(features) },
+	};
+
+	//sent by the client on this and every later reconnect
+	_client.SetInitPacket(payload, 4);
+	_client.SetRateBudget(RateGovernor::ParseBudget(GetEnvironmentString(RATE_BUDGET_ENV), programName));
+	_client.SetConnectionCallback(_onConnectionChanged);
+	_client.SetResyncCallback(_onReconnected);
+
+	//running before the pipe is up, so calls made while connecting track the target and effects as usual
+	_frameCoalescer.Start(GetEnvironmentInt(FLUSH_RATE_ENV, DEFAULT_FLUSH_RATE), _onFlushTick);
+	_effectEngine.Start();
+}
+
+void ClientStartup::Start(const char name[], const std::string& programName, ResolveFunction resolve)
+{
+	Prepare(name, programName);
+	std::thread(resolve).detach();
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include "ArtemisPipeClient.h"
+#include "EffectEngine.h"
+#include "FrameCoalescer.h"
+#include <string>
+
+//What LogiLedInitWithName does on the game's thread, kept out of the dll so the tests time the same code.
+//Everything that can take long, the pipe and the original DLL, is left to a detached resolver thread.
+class ClientStartup
+{
+public:
+	//connects the client and picks where lighting goes, runs on the detached thread
+	typedef void (*ResolveFunction)();
+private:
+	ArtemisPipeClient& _client;
+	FrameCoalescer& _frameCoalescer;
+	EffectEngine& _effectEngine;
+	ArtemisPipeClient::ConnectionFunction _onConnectionChanged;
+	ArtemisPipeClient::ResyncFunction _onReconnected;
+	FrameCoalescer::TickFunction _onFlushTick;
+public:
+	ClientStartup(ArtemisPipeClient& client, FrameCoalescer& frameCoalescer, EffectEngine& effectEngine,
+		ArtemisPipeClient::ConnectionFunction onConnectionChanged, ArtemisPipeClient::ResyncFunction onReconnected, FrameCoalescer::TickFunction onFlushTick);
+
+	//the Init packet, the rate budget and the callbacks, then the flush and effect threads.
+	//name is what the game passed to Init, programName the executable the budget is looked up by
+	void Prepare(const char name[], const std::string& programName);
+	//Prepare, then resolve on a detached thread, a thread left joinable at exit would terminate the process
+	void Start(const char name[], const std::string& programName, ResolveFunction resolve);
+};
\ No newline at end of file
@@ -4,6 +4,121 @@
 #define ARTEMIS_REG_NAME L"Artemis"
 #define ARTEMIS_EXE_NAME "Artemis.UI.exe"
 
+//Number of packets the pipe client can hold while the sender thread is busy writing.
+#define PACKET_QUEUE_CAPACITY 256
+//Largest packet that fits in a queue slot. A full bitmap packet is 512 bytes.
+#define PACKET_QUEUE_SLOT_SIZE 2048
+//Upper bound for a Batch envelope built from packets that queued up while a write was in flight.
+#define BATCH_BUFFER_SIZE 16384
+//Payload pieces a single packet can be gathered from.
+#define MAX_PACKET_SEGMENTS 4
+//Program names longer than this are cut short in Init.
+#define MAX_PROGRAM_NAME_LENGTH 260
+#define INIT_PACKET_MAX_SIZE 512
+
+//Init carries the protocol version and the features we can use, the host answers with InitAck
+//holding the subset it supports. Every feature builds on the sequence header.
+#define PROTOCOL_VERSION 1
+#define FEATURE_SEQUENCE_HEADER 0x01
+//Batch envelopes and SetLightingForKeys
+#define FEATURE_BATCHING 0x02
+#define FEATURE_DELTA_FRAMES 0x04
+//1 byte opcodes, varint lengths and 5 byte key records
+#define FEATURE_COMPACT_HEADER 0x08
+#define FEATURE_SHARED_MEMORY 0x10
+//SetLightingForLeds, 4 byte key records addressed by the dense LED index
+#define FEATURE_LED_INDEX 0x20
+//SetLightingSnapshot, the whole lighting state in one packet after a reconnect
+#define FEATURE_SNAPSHOT 0x40
+#define INIT_ACK_SIZE 16
+#define HANDSHAKE_TIMEOUT_MS 1000
+
+//Packets are built as [length][command][payload], the client stamps a per-connection
+//sequence number and a QueryPerformanceCounter timestamp after the command when queueing them.
+#define PACKET_STAMP_SIZE 12
+#define PACKET_HEADER_SIZE 20
+
+//A write the host hasn't taken after this long is a stall, the game's lighting is kept as latest state
+//only until it goes through. Past the second bound the connection is dropped and reopened.
+#define WRITE_STALL_TIMEOUT_MS 100
+#define WRITE_DISCONNECT_TIMEOUT_MS 2000
+
+//Set to 0 to keep lighting waiting for the host instead of moving it to the original dll while it is gone.
+//Only a host that stays away this long is failed over from.
+#define FAILOVER_ENV "ARTEMIS_LOGITECH_FAILOVER"
+#define FAILOVER_DELAY_MS 1000
+
+//Set to 1 to forward lighting to the original dll as well as to the host, failover is off then.
+#define TEE_ENV "ARTEMIS_LOGITECH_TEE"
+//Calls waiting for the original dll. A full queue is dropped and the lighting state is queued instead.
+#define TEE_QUEUE_CAPACITY 512
+//Bitmaps that can wait in the tee queue at the same time.
+#define TEE_QUEUE_BITMAPS 4
+
+//Reconnect attempts back off exponentially between these bounds while the host is gone.
+#define RECONNECT_MIN_BACKOFF_MS 100
+#define RECONNECT_MAX_BACKOFF_MS 5000
+
+//Rate in Hz at which coalesced per-key updates are flushed. 0 sends every call as it comes.
+#define FLUSH_RATE_ENV "ARTEMIS_LOGITECH_FLUSH_RATE"
+#define DEFAULT_FLUSH_RATE 60
+//Distinct keys a single coalesced frame can hold before it is flushed early.
+#define MAX_COALESCED_KEYS 192
+//Zones per device type that SetLightingForTargetZone is coalesced for, higher zones are sent as they come.
+#define MAX_TARGET_ZONES 8
+
+//Packets that would not change what the host shows are suppressed, and only sent again once
+//this many milliseconds have passed since they last went out. When nothing went out for that long
+//the flush thread sends the whole lighting state as a keepalive. 0 sends everything and no keepalive.
+#define KEEPALIVE_INTERVAL_ENV "ARTEMIS_LOGITECH_KEEPALIVE_MS"
+#define DEFAULT_KEEPALIVE_INTERVAL_MS 1000
+
+//Lighting a program sends past its budget is held back, the wrapper sends its whole state as one frame
+//once this many milliseconds of budget have built up again. Budgets are [program=]packets:bytes per
+//second separated by ';', 0 is unlimited and malformed entries are ignored, e.g. "2000:1048576;Game.exe=200:65536".
+#define RATE_BUDGET_ENV "ARTEMIS_LOGITECH_RATE_BUDGET"
+#define DEFAULT_RATE_BUDGET_PACKETS 2000
+#define DEFAULT_RATE_BUDGET_BYTES 1048576
+#define RATE_GOVERNOR_RESUME_MS 33
+
+//Flash and Pulse effects are rendered in the wrapper at this interval.
+#define EFFECT_TICK_MS 16
+//Keys that can run an effect at the same time, must be a power of two.
+#define MAX_KEY_EFFECTS 64
+
+//SaveCurrentLighting snapshots the wrapper keeps, older ones are dropped.
+#define LIGHTING_STATE_STACK_DEPTH 4
+//Distinct per-key colors the lighting state remembers for RestoreLighting.
+#define MAX_KEY_OVERRIDES 256
+//Keys SaveLightingForKey can hold at once.
+#define MAX_SAVED_KEYS 64
+//Distinct zone colors the lighting state remembers, across every device type.
+#define MAX_ZONE_OVERRIDES 32
+
+//A full bitmap is sent at least this often so a host that missed a delta recovers.
+#define BITMAP_KEYFRAME_INTERVAL 60
+
+//Set to 1 to offer the host a shared memory ring to carry packets instead of the pipe.
+#define SHARED_MEMORY_ENV "ARTEMIS_LOGITECH_SHARED_MEMORY"
+//POSIX shared memory names are a single path component.
+#ifdef _WIN32
+#define SHARED_MEMORY_NAME_PREFIX "Local\\Artemis.Logitech."
+#else
+#define SHARED_MEMORY_NAME_PREFIX "/Artemis.Logitech."
+#endif
+#define SHARED_MEMORY_EVENT_SUFFIX ".Event"
+#define SHARED_MEMORY_RING_MAGIC 0x41524C47
+//Must be a power of two, indices wrap around it.
+#define SHARED_MEMORY_RING_CAPACITY 65536
+#define SHARED_MEMORY_DRAIN_TIMEOUT_MS 100
+
+//pipe (default on Windows), unix (default elsewhere) or loopback.
+#define TRANSPORT_ENV "ARTEMIS_LOGITECH_TRANSPORT"
+//Appended to %ProgramData% on Windows, must match the host.
+#define UNIX_SOCKET_RELATIVE_PATH "\\Artemis\\Logitech.sock"
+//Where the host's CommonApplicationData folder is everywhere else.
+#define UNIX_SOCKET_POSIX_PATH "/usr/share/Artemis/Logitech.sock"
+
 #ifdef _WIN64
 #define REGISTRY_PATH L"SOFTWARE\\Classes\\CLSID\\{a6519e67-7632-4375-afdf-caa889744403}\\ServerBinary" 
 #define _BITS "64"
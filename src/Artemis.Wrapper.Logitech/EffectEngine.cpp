@@ -0,0 +1,349 @@
+#include "pch.h"
+#include "EffectEngine.h"
+#include "Logger.h"
+#include <chrono>
+
+unsigned long long SteadyEffectClock::NowMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long long VirtualEffectClock::NowMs()
+{
+	return _nowMs;
+}
+
+void VirtualEffectClock::Advance(unsigned long long ms)
+{
+	_nowMs += ms;
+}
+
+EffectEngine::EffectEngine(EffectSink& sink, EffectClock& clock) : _sink(sink), _clock(clock)
+{
+}
+
+EffectEngine::~EffectEngine()
+{
+	//we can't join from DllMain, the process is going away anyway.
+	if (_tickThread.joinable()) {
+		_tickThread.detach();
+	}
+}
+
+void EffectEngine::Start()
+{
+	if (_tickThread.joinable()) {
+		return;
+	}
+
+	_stopRequested = false;
+	_tickThread = std::thread(&EffectEngine::TickLoop, this);
+}
+
+void EffectEngine::Stop()
+{
+	if (!_tickThread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_tickCondition.notify_one();
+	_tickThread.join();
+
+	//the host is told to shut down right after, there is nothing to restore
+	std::lock_guard<std::mutex> lock(_mutex);
+	_lighting = Effect();
+	for (unsigned int i = 0; i < MAX_KEY_EFFECTS; i++) {
+		_keys[i] = KeySlot();
+	}
+	_activeKeys = 0;
+}
+
+void EffectEngine::FlashLighting(EffectColor color, unsigned int durationMs, unsigned int intervalMs)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_lighting = NewEffect(EffectType::Flash, _base, color, intervalMs * 2, durationMs);
+		_lighting.fromBase = true;
+	}
+	_tickCondition.notify_one();
+}
+
+void EffectEngine::PulseLighting(EffectColor color, unsigned int durationMs, unsigned int intervalMs)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_lighting = NewEffect(EffectType::Pulse, _base, color, intervalMs, durationMs);
+		_lighting.fromBase = true;
+	}
+	_tickCondition.notify_one();
+}
+
+void EffectEngine::FlashKey(LogiLed::KeyName keyName, EffectColor color, unsigned int durationMs, unsigned int intervalMs)
+{
+	EffectColor keyColor;
+	const bool hasKeyColor = _sink.GetKeyColor(keyName, keyColor);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Effect effect = NewEffect(EffectType::Flash, hasKeyColor ? keyColor : _base, color, intervalMs * 2, durationMs);
+		effect.fromBase = true;
+		StartKeyEffect(keyName, effect, hasKeyColor ? &keyColor : nullptr);
+	}
+	_tickCondition.notify_one();
+}
+
+void EffectEngine::PulseKey(LogiLed::KeyName keyName, EffectColor start, EffectColor finish, unsigned int durationMs, bool infinite)
+{
+	EffectColor keyColor;
+	const bool hasKeyColor = _sink.GetKeyColor(keyName, keyColor);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		//an infinite pulse goes from start to finish and back, a finite one fades once and ends.
+		//a finite duration of 0 would read as LOGI_LED_DURATION_INFINITE, it ends on the next tick instead
+		const unsigned int fadeMs = durationMs != LOGI_LED_DURATION_INFINITE ? durationMs : 1;
+		StartKeyEffect(keyName, infinite
+			? NewEffect(EffectType::Pulse, start, finish, durationMs * 2, LOGI_LED_DURATION_INFINITE)
+			: NewEffect(EffectType::Fade, start, finish, fadeMs, fadeMs),
+			hasKeyColor ? &keyColor : nullptr);
+	}
+	_tickCondition.notify_one();
+}
+
+void EffectEngine::StopEffects()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_generation++;
+	}
+	_tickCondition.notify_one();
+}
+
+void EffectEngine::StopEffectsOnKey(LogiLed::KeyName keyName)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const int index = FindKeySlot(keyName, false);
+		if (index < 0) {
+			return;
+		}
+		_keys[index].effect.stopRequested = true;
+	}
+	_tickCondition.notify_one();
+}
+
+bool EffectEngine::SetBaseLighting(EffectColor color)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_base = color;
+	return _lighting.type != EffectType::None;
+}
+
+bool EffectEngine::SetBaseKey(LogiLed::KeyName keyName, EffectColor color)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const int index = FindKeySlot(keyName, false);
+	if (index < 0) {
+		return false;
+	}
+
+	_keys[index].base = color;
+	return true;
+}
+
+void EffectEngine::Tick()
+{
+	bool restore;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		restore = TickLocked();
+	}
+	if (restore) {
+		_sink.RestoreLighting();
+	}
+}
+
+int EffectEngine::FindKeySlot(LogiLed::KeyName keyName, bool insert)
+{
+	static_assert((MAX_KEY_EFFECTS & (MAX_KEY_EFFECTS - 1)) == 0, "MAX_KEY_EFFECTS must be a power of two");
+
+	//key names are sparse scan codes, a multiplicative hash spreads them over the table
+	unsigned int index = ((unsigned int)keyName * 2654435761u >> 16) & (MAX_KEY_EFFECTS - 1);
+	int freeIndex = -1;
+
+	for (unsigned int probe = 0; probe < MAX_KEY_EFFECTS; probe++) {
+		const KeySlot& slot = _keys[index];
+		if (slot.state == SlotState::Active && slot.keyName == keyName) {
+			return index;
+		}
+		if (slot.state != SlotState::Active && freeIndex < 0) {
+			freeIndex = index;
+		}
+		if (slot.state == SlotState::Empty) {
+			break;
+		}
+		index = (index + 1) & (MAX_KEY_EFFECTS - 1);
+	}
+
+	return insert ? freeIndex : -1;
+}
+
+void EffectEngine::StartKeyEffect(LogiLed::KeyName keyName, const Effect& effect, const EffectColor* keyColor)
+{
+	const int index = FindKeySlot(keyName, true);
+	if (index < 0) {
+		LOG(fmt::format("Too many key effects running, dropping the one for key {}", (int)keyName));
+		return;
+	}
+
+	KeySlot& slot = _keys[index];
+	if (slot.state != SlotState::Active) {
+		slot.state = SlotState::Active;
+		slot.keyName = keyName;
+		//the key goes back to its own color, keys the game never set go back to the background
+		slot.base = keyColor ? *keyColor : _base;
+		slot.effect = effect;
+		_activeKeys++;
+		return;
+	}
+
+	//replacing a running effect keeps what it last drew, so unchanged colors aren't sent again
+	const bool hasRendered = slot.effect.hasRendered;
+	const EffectColor rendered = slot.effect.rendered;
+	slot.effect = effect;
+	slot.effect.hasRendered = hasRendered;
+	slot.effect.rendered = rendered;
+}
+
+EffectEngine::Effect EffectEngine::NewEffect(EffectType type, EffectColor from, EffectColor to, unsigned int periodMs, unsigned int durationMs)
+{
+	Effect effect;
+	effect.type = type;
+	effect.from = from;
+	effect.to = to;
+	effect.startMs = _clock.NowMs();
+	effect.periodMs = periodMs;
+	effect.durationMs = durationMs;
+	effect.generation = _generation;
+	return effect;
+}
+
+bool EffectEngine::IsRunningLocked()
+{
+	return _lighting.type != EffectType::None || _activeKeys > 0;
+}
+
+bool EffectEngine::RenderLocked(Effect& effect, EffectColor base, unsigned long long nowMs, EffectColor& color)
+{
+	const unsigned long long elapsed = nowMs > effect.startMs ? nowMs - effect.startMs : 0;
+
+	if (effect.generation != _generation ||
+		effect.stopRequested ||
+		(effect.durationMs != LOGI_LED_DURATION_INFINITE && elapsed >= effect.durationMs)) {
+		effect.type = EffectType::None;
+		color = base;
+		return false;
+	}
+
+	//0 shows the from color, 255 the to color
+	unsigned int weight = 255;
+	if (effect.type == EffectType::Fade && effect.durationMs != 0) {
+		weight = (unsigned int)(elapsed * 255 / effect.durationMs);
+	}
+	else if (effect.periodMs != 0) {
+		const unsigned int position = (unsigned int)(elapsed % effect.periodMs);
+		const unsigned int half = effect.periodMs / 2;
+
+		if (effect.type == EffectType::Flash) {
+			weight = position < half ? 255 : 0;
+		}
+		else {
+			weight = position < half
+				? position * 255 / half
+				: (effect.periodMs - position) * 255 / (effect.periodMs - half);
+		}
+	}
+
+	const EffectColor from = effect.fromBase ? base : effect.from;
+	color.red = (unsigned char)(from.red + ((int)effect.to.red - from.red) * (int)weight / 255);
+	color.green = (unsigned char)(from.green + ((int)effect.to.green - from.green) * (int)weight / 255);
+	color.blue = (unsigned char)(from.blue + ((int)effect.to.blue - from.blue) * (int)weight / 255);
+	return true;
+}
+
+bool EffectEngine::TickLocked()
+{
+	const unsigned long long nowMs = _clock.NowMs();
+	bool rendered = false;
+	bool removed = false;
+	bool restore = false;
+	EffectColor color;
+
+	//a finished effect on all lighting leaves restoring to the sink, a single background
+	//color would recolor every key on a per-key target
+	if (_lighting.type != EffectType::None) {
+		const bool running = RenderLocked(_lighting, _base, nowMs, color);
+		if (!running) {
+			restore = true;
+		}
+		else if (!_lighting.hasRendered || memcmp(&color, &_lighting.rendered, sizeof(color)) != 0) {
+			_sink.SetLighting(color);
+			rendered = true;
+		}
+		_lighting.hasRendered = running;
+		_lighting.rendered = color;
+	}
+
+	for (unsigned int i = 0; i < MAX_KEY_EFFECTS && _activeKeys > 0; i++) {
+		KeySlot& slot = _keys[i];
+		if (slot.state != SlotState::Active) {
+			continue;
+		}
+
+		const bool running = RenderLocked(slot.effect, slot.base, nowMs, color);
+		if (!running || !slot.effect.hasRendered || memcmp(&color, &slot.effect.rendered, sizeof(color)) != 0) {
+			_sink.SetKey(slot.keyName, color);
+			rendered = true;
+		}
+		slot.effect.hasRendered = running;
+		slot.effect.rendered = color;
+
+		if (!running) {
+			slot.state = SlotState::Removed;
+			_activeKeys--;
+			removed = true;
+		}
+	}
+
+	//removed slots only lengthen probes, once the table is idle it starts over
+	if (removed && _activeKeys == 0) {
+		for (unsigned int i = 0; i < MAX_KEY_EFFECTS; i++) {
+			_keys[i].state = SlotState::Empty;
+		}
+	}
+
+	if (rendered) {
+		_sink.Flush();
+	}
+	return restore;
+}
+
+void EffectEngine::TickLoop()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopRequested) {
+		if (!IsRunningLocked()) {
+			_tickCondition.wait(lock);
+			continue;
+		}
+
+		if (TickLocked()) {
+			lock.unlock();
+			_sink.RestoreLighting();
+			lock.lock();
+		}
+		_tickCondition.wait_for(lock, std::chrono::milliseconds(EFFECT_TICK_MS));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+#include "Constants.h"
+#include "LogitechLEDLib.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct EffectColor {
+	unsigned char red;
+	unsigned char green;
+	unsigned char blue;
+};
+
+//Time source for the effect engine, a VirtualEffectClock lets effects be stepped by hand.
+class EffectClock
+{
+public:
+	virtual ~EffectClock() {}
+
+	virtual unsigned long long NowMs() = 0;
+};
+
+class SteadyEffectClock : public EffectClock
+{
+public:
+	unsigned long long NowMs() override;
+};
+
+class VirtualEffectClock : public EffectClock
+{
+private:
+	std::atomic<unsigned long long> _nowMs{ 0 };
+public:
+	unsigned long long NowMs() override;
+	void Advance(unsigned long long ms);
+};
+
+//Receives the colors the engine renders. Flush is called once per tick after every effect had its turn.
+class EffectSink
+{
+public:
+	virtual ~EffectSink() {}
+
+	virtual void SetLighting(EffectColor color) = 0;
+	virtual void SetKey(LogiLed::KeyName keyName, EffectColor color) = 0;
+	virtual void Flush() = 0;
+	//the color the game set for the key itself, false when it only has the background.
+	//called without the engine locked
+	virtual bool GetKeyColor(LogiLed::KeyName keyName, EffectColor& color) = 0;
+	//puts back everything the game set once an effect on all lighting is over, called without the engine locked
+	virtual void RestoreLighting() = 0;
+};
+
+//Runs Flash and Pulse effects in the wrapper, hosts only ever see plain colors.
+//One thread renders every active effect at EFFECT_TICK_MS and only sends colors that changed,
+//it sleeps while no effect is running. Stopping an effect only marks it, the next tick
+//puts the color the game set underneath it back. An effect on all lighting covered every key,
+//so when it ends the sink restores the whole lighting state instead.
+class EffectEngine
+{
+private:
+	enum class EffectType { None, Flash, Pulse, Fade };
+	enum class SlotState { Empty, Active, Removed };
+
+	struct Effect {
+		EffectType type = EffectType::None;
+		//flash and pulse lighting go between the base color and the effect color
+		bool fromBase = false;
+		EffectColor from = {};
+		EffectColor to = {};
+		unsigned long long startMs = 0;
+		unsigned int periodMs = 0;
+		//LOGI_LED_DURATION_INFINITE runs until stopped
+		unsigned int durationMs = 0;
+		unsigned int generation = 0;
+		bool stopRequested = false;
+		bool hasRendered = false;
+		EffectColor rendered = {};
+	};
+
+	//per-key effects live in an open addressed table, keyed on the key name
+	struct KeySlot {
+		SlotState state = SlotState::Empty;
+		LogiLed::KeyName keyName = (LogiLed::KeyName)0;
+		EffectColor base = {};
+		Effect effect;
+	};
+
+	EffectSink& _sink;
+	EffectClock& _clock;
+
+	Effect _lighting;
+	EffectColor _base = {};
+	KeySlot _keys[MAX_KEY_EFFECTS];
+	unsigned int _activeKeys = 0;
+	//bumped by StopEffects, effects started before it are wound down by the next tick
+	unsigned int _generation = 0;
+
+	std::mutex _mutex;
+	std::condition_variable _tickCondition;
+	std::thread _tickThread;
+	bool _stopRequested = false;
+
+	int FindKeySlot(LogiLed::KeyName keyName, bool insert);
+	void StartKeyEffect(LogiLed::KeyName keyName, const Effect& effect, const EffectColor* keyColor);
+	Effect NewEffect(EffectType type, EffectColor from, EffectColor to, unsigned int periodMs, unsigned int durationMs);
+	bool IsRunningLocked();
+	//false once the effect is over, the base color has been rendered by then
+	bool RenderLocked(Effect& effect, EffectColor base, unsigned long long nowMs, EffectColor& color);
+	//true when an effect on all lighting ended, the sink has to restore the lighting then
+	bool TickLocked();
+	void TickLoop();
+public:
+	EffectEngine(EffectSink& sink, EffectClock& clock);
+	~EffectEngine();
+
+	void Start();
+	void Stop();
+
+	void FlashLighting(EffectColor color, unsigned int durationMs, unsigned int intervalMs);
+	void PulseLighting(EffectColor color, unsigned int durationMs, unsigned int intervalMs);
+	void FlashKey(LogiLed::KeyName keyName, EffectColor color, unsigned int durationMs, unsigned int intervalMs);
+	void PulseKey(LogiLed::KeyName keyName, EffectColor start, EffectColor finish, unsigned int durationMs, bool infinite);
+	void StopEffects();
+	void StopEffectsOnKey(LogiLed::KeyName keyName);
+
+	//colors the game sets are what effects return to. True when an effect covers them
+	//right now, the caller then leaves sending them to the engine.
+	bool SetBaseLighting(EffectColor color);
+	bool SetBaseKey(LogiLed::KeyName keyName, EffectColor color);
+
+	//renders one frame at the clock's current time, called by the tick thread
+	void Tick();
+};
\ No newline at end of file
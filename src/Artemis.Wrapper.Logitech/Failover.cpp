@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "Failover.h"
+#include "Logger.h"
+
+Failover::Failover(OriginalDllWrapper& originalDll, ReplayFunction replay) : _originalDll(originalDll), _replay(replay)
+{
+}
+
+Failover::OriginalCall::OriginalCall(Failover& failover)
+{
+	//the host's path doesn't wait for anything
+	if (!failover._active) {
+		return;
+	}
+
+	_lock = std::unique_lock<std::mutex>(failover._originalMutex);
+	_active = failover._active;
+}
+
+Failover::OriginalCall::operator bool() const
+{
+	return _active;
+}
+
+Failover::~Failover()
+{
+	//we can't join from DllMain, the process is going away anyway.
+	if (_workerThread.joinable()) {
+		_workerThread.detach();
+	}
+}
+
+void Failover::Start()
+{
+	if (_workerThread.joinable()) {
+		return;
+	}
+
+	_stopRequested = false;
+	_workerThread = std::thread(&Failover::WorkerLoop, this);
+}
+
+void Failover::Stop()
+{
+	if (!_workerThread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_condition.notify_one();
+	_workerThread.join();
+
+	Deactivate();
+	LOG(fmt::format("Failed over to the original dll {} times", GetFailoverCount()));
+}
+
+void Failover::SetConnected(bool connected)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_connected == connected) {
+			return;
+		}
+		_connected = connected;
+	}
+	_condition.notify_one();
+}
+
+void Failover::Deactivate()
+{
+	std::lock_guard<std::mutex> lock(_originalMutex);
+	_active = false;
+	if (_originalInitialized) {
+		_originalDll.LogiLedShutdown();
+		_originalInitialized = false;
+	}
+}
+
+bool Failover::IsActive()
+{
+	return _active;
+}
+
+unsigned int Failover::GetFailoverCount()
+{
+	return _failoverCount;
+}
+
+bool Failover::InitializeOriginal()
+{
+	std::lock_guard<std::mutex> originalLock(_originalMutex);
+	if (_originalInitialized) {
+		return true;
+	}
+	if (_originalFailed) {
+		return false;
+	}
+
+	_originalDll.LoadDll();
+	_originalInitialized = _originalDll.IsDllLoaded() && _originalDll.LogiLedInit();
+	_originalFailed = !_originalInitialized;
+	if (!_originalInitialized) {
+		LOG("Could not initialize the original dll, lighting waits for the host");
+	}
+	return _originalInitialized;
+}
+
+//The host can come back while the DLL is loading, it then lets go of the devices right away.
+bool Failover::Activate()
+{
+	std::lock_guard<std::mutex> originalLock(_originalMutex);
+	if (!_originalInitialized) {
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_connected || _stopRequested) {
+			_originalDll.LogiLedShutdown();
+			_originalInitialized = false;
+			return false;
+		}
+	}
+
+	_active = true;
+	_failoverCount++;
+	return true;
+}
+
+void Failover::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopRequested) {
+		_condition.wait(lock, [this] {
+			return
+				_stopRequested ||
+				(_connected && _active) ||
+				(!_connected && !_active && !_originalFailed);
+		});
+		if (_stopRequested) {
+			break;
+		}
+
+		if (_connected) {
+			//the client resyncs the host itself, usually it has already switched back by now
+			lock.unlock();
+			LOG("Host is back, switching away from the original dll");
+			Deactivate();
+			lock.lock();
+			continue;
+		}
+
+		//most reconnects are over long before this
+		if (_condition.wait_for(lock, std::chrono::milliseconds(FAILOVER_DELAY_MS), [this] { return _stopRequested || _connected; })) {
+			continue;
+		}
+
+		lock.unlock();
+		LOG("Host is gone, switching to the original dll");
+		if (InitializeOriginal()) {
+			_replay();
+		}
+		lock.lock();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include "Constants.h"
+#include "OriginalDllWrapper.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//Moves the game's lighting to the original Logitech DLL while the host is gone, and back once it returns.
+//Loading the DLL and replaying the state happen on a worker thread, the game never waits for either.
+class Failover
+{
+public:
+	//Called on the worker thread once the original DLL is initialized. It calls Activate with the lighting
+	//state locked and replays the state to the original DLL when that succeeded, so no call falls in between.
+	typedef void (*ReplayFunction)();
+
+	//Held by every call that goes to the original DLL, Deactivate waits for them so nothing reaches
+	//the DLL after its shutdown. True while the failover is active.
+	class OriginalCall
+	{
+	private:
+		std::unique_lock<std::mutex> _lock;
+		bool _active = false;
+	public:
+		explicit OriginalCall(Failover& failover);
+		explicit operator bool() const;
+	};
+private:
+	OriginalDllWrapper& _originalDll;
+	ReplayFunction _replay;
+
+	std::atomic<bool> _active{ false };
+	bool _connected = true;
+	bool _originalInitialized = false;
+	//the DLL is only looked for once per session, a missing one won't show up later
+	bool _originalFailed = false;
+	std::atomic<unsigned int> _failoverCount{ 0 };
+
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	//the worker and the client's resync can both switch sides, only one touches the original DLL at a time
+	std::mutex _originalMutex;
+	std::thread _workerThread;
+	bool _stopRequested = false;
+
+	bool InitializeOriginal();
+	void WorkerLoop();
+public:
+	Failover(OriginalDllWrapper& originalDll, ReplayFunction replay);
+	~Failover();
+
+	void Start();
+	//the original DLL is shut down again if it was used
+	void Stop();
+
+	//called whenever the host connection comes or goes
+	void SetConnected(bool connected);
+	//false when the host came back while the DLL was loading
+	bool Activate();
+	//the original DLL lets go of the devices, called before the host is resynced so the state can't go to the original
+	void Deactivate();
+	//true while lighting goes to the original DLL
+	bool IsActive();
+	unsigned int GetFailoverCount();
+};
\ No newline at end of file
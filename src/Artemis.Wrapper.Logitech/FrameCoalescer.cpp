@@ -0,0 +1,267 @@
+#include "pch.h"
+#include "FrameCoalescer.h"
+#include "LogiCommands.h"
+#include "Logger.h"
+#include "PacketCodec.h"
+
+//device types in the order of their zone buffers
+static const LogiLed::DeviceType ZoneDevices[] = {
+	LogiLed::Keyboard,
+	LogiLed::Mouse,
+	LogiLed::Mousemat,
+	LogiLed::Headset,
+	LogiLed::Speaker,
+};
+
+static int GetZoneDevice(LogiLed::DeviceType deviceType)
+{
+	for (unsigned int i = 0; i < sizeof(ZoneDevices) / sizeof(ZoneDevices[0]); i++) {
+		if (ZoneDevices[i] == deviceType) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+FrameCoalescer::FrameCoalescer(ArtemisPipeClient& client) : _client(client)
+{
+}
+
+FrameCoalescer::~FrameCoalescer()
+{
+	//we can't join from DllMain, the process is going away anyway.
+	if (_flushThread.joinable()) {
+		_flushThread.detach();
+	}
+}
+
+void FrameCoalescer::Start(unsigned int flushRate, TickFunction onTick)
+{
+	//the host starts every program at all devices
+	_targetDevice = LOGI_DEVICETYPE_ALL;
+
+	if (_flushThread.joinable() || flushRate == 0) {
+		return;
+	}
+
+	LOG(fmt::format("Coalescing per-key updates at {} Hz", flushRate));
+	_flushIntervalMs = 1000 / flushRate;
+	if (_flushIntervalMs == 0) {
+		_flushIntervalMs = 1;
+	}
+
+	_stopRequested = false;
+	_onTick = onTick;
+	_flushThread = std::thread(&FrameCoalescer::FlushLoop, this);
+}
+
+void FrameCoalescer::Stop()
+{
+	if (!_flushThread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_flushCondition.notify_one();
+	_flushThread.join();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_flushIntervalMs = 0;
+	FlushLocked();
+}
+
+bool FrameCoalescer::IsEnabled()
+{
+	return _flushIntervalMs != 0;
+}
+
+void FrameCoalescer::SetTargetDevice(int targetDevice)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	FlushLocked();
+	_targetDevice = targetDevice;
+
+	SetTargetDevicePacket::Payload payload;
+	PacketSegment segment = SetTargetDevicePacket::Encode(payload, targetDevice);
+	_client.Write(SetTargetDevicePacket::command, &segment, 1);
+}
+
+bool FrameCoalescer::IsTargeted(int deviceType)
+{
+	return (_targetDevice & deviceType) != 0;
+}
+
+bool FrameCoalescer::SetLighting(unsigned char red, unsigned char green, unsigned char blue)
+{
+	//recoloring keys has to stay in order with the keys around it
+	if (!IsEnabled() || _targetDevice == LOGI_DEVICETYPE_PERKEY_RGB) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_hasBackground = true;
+	_background[0] = red;
+	_background[1] = green;
+	_background[2] = blue;
+	return true;
+}
+
+bool FrameCoalescer::SetZone(LogiLed::DeviceType deviceType, int zone, unsigned char red, unsigned char green, unsigned char blue)
+{
+	const int device = GetZoneDevice(deviceType);
+	if (!IsEnabled() || device < 0 || zone < 0 || zone >= MAX_TARGET_ZONES) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	unsigned char* color = _zones[device][zone];
+	color[0] = red;
+	color[1] = green;
+	color[2] = blue;
+	_zonesSet[device] |= 1u << zone;
+	return true;
+}
+
+bool FrameCoalescer::SetKey(unsigned int command, int keyCode, unsigned char red, unsigned char green, unsigned char blue)
+{
+	//hosts without SetLightingForKeys get the per-key packets as they are
+	if (!IsEnabled() || !_client.HasFeature(FEATURE_BATCHING)) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const unsigned char led = _client.HasFeature(FEATURE_LED_INDEX) ? GetLedIndex(command, keyCode) : (unsigned char)NO_LED;
+	if (led != NO_LED) {
+		//the game is drawing this LED again, so the previous frame is complete
+		if (_ledsSet[led / 8] & (1 << (led % 8))) {
+			FlushLocked();
+		}
+
+		_ledsSet[led / 8] |= (unsigned char)(1 << (led % 8));
+		unsigned char* record = &_leds[_ledCount++ * LedRecordSize];
+		record[0] = led;
+		record[1] = red;
+		record[2] = green;
+		record[3] = blue;
+		return true;
+	}
+
+	for (unsigned int i = 0; i < _keyCount; i++) {
+		if (_keys[i].keyCode == keyCode && _keys[i].command == command) {
+			//the game is drawing this key again, so the previous frame is complete
+			FlushLocked();
+			break;
+		}
+	}
+
+	if (_keyCount == MAX_COALESCED_KEYS) {
+		FlushLocked();
+	}
+
+	KeyRecord& key = _keys[_keyCount++];
+	key.keyCode = keyCode;
+	key.command = (unsigned char)command;
+	key.red = red;
+	key.green = green;
+	key.blue = blue;
+	return true;
+}
+
+void FrameCoalescer::Flush()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	FlushLocked();
+}
+
+void FrameCoalescer::FlushLocked()
+{
+	//zones and the background don't touch keys, so they can go out ahead of them
+	if (_hasBackground) {
+		SetLightingPacket::Payload payload;
+		PacketSegment segment = SetLightingPacket::Encode(payload, _background[0], _background[1], _background[2]);
+		_client.Write(SetLightingPacket::command, &segment, 1);
+		_hasBackground = false;
+	}
+
+	for (unsigned int device = 0; device < ZoneDeviceCount; device++) {
+		for (unsigned int zones = _zonesSet[device]; zones != 0; zones &= zones - 1) {
+			int zone = 0;
+			while ((zones & (1u << zone)) == 0) {
+				zone++;
+			}
+
+			const unsigned char* color = _zones[device][zone];
+			SetLightingForTargetZonePacket::Payload payload;
+			PacketSegment segment = SetLightingForTargetZonePacket::Encode(payload, ZoneDevices[device], zone, color[0], color[1], color[2]);
+			_client.Write(SetLightingForTargetZonePacket::command, &segment, 1);
+		}
+		_zonesSet[device] = 0;
+	}
+
+	FlushKeysLocked();
+}
+
+void FrameCoalescer::FlushKeysLocked()
+{
+	if (_keyCount == 0 && _ledCount == 0) {
+		return;
+	}
+
+	//reconnected to a host that can't take them, the next frame goes out per key
+	if (!_client.HasFeature(FEATURE_BATCHING)) {
+		_keyCount = 0;
+		_ledCount = 0;
+		memset(_ledsSet, 0, sizeof(_ledsSet));
+		return;
+	}
+
+	if (_ledCount > 0) {
+		//dropped after reconnecting to a host without the index, the next frame uses the other records
+		if (_client.HasFeature(FEATURE_LED_INDEX)) {
+			PacketSegment leds = { _leds, _ledCount * LedRecordSize };
+			_client.Write(LogiCommands::SetLightingForLeds, &leds, 1);
+		}
+		_ledCount = 0;
+		memset(_ledsSet, 0, sizeof(_ledsSet));
+	}
+
+	if (_keyCount == 0) {
+		return;
+	}
+
+	unsigned int compactLength;
+	if (_client.HasFeature(FEATURE_COMPACT_HEADER) && EncodeCompactKeys(_keys, _keyCount, _compact, compactLength)) {
+		PacketSegment compact = { _compact, compactLength };
+		_client.Write(LogiCommands::SetLightingForKeysCompact, &compact, 1);
+		_keyCount = 0;
+		return;
+	}
+
+	//the records already have their wire layout, so they go out straight from _keys
+	PacketSegment payload[2] = {
+		{ &_keyCount, sizeof(_keyCount) },
+		{ _keys, (unsigned int)(sizeof(KeyRecord) * _keyCount) },
+	};
+
+	_client.Write(LogiCommands::SetLightingForKeys, payload, 2);
+	_keyCount = 0;
+}
+
+void FrameCoalescer::FlushLoop()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopRequested) {
+		_flushCondition.wait_for(lock, std::chrono::milliseconds(_flushIntervalMs));
+		FlushLocked();
+
+		if (_onTick) {
+			lock.unlock();
+			_onTick();
+			lock.lock();
+		}
+	}
+}
\ No newline at end of file
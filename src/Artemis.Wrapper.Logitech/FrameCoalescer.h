@@ -0,0 +1,75 @@
+#pragma once
+#include "Constants.h"
+#include "ArtemisPipeClient.h"
+#include "LedIndex.h"
+#include "LogitechLEDLib.h"
+#include "PacketCodec.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//Collects per-key color calls into one frame and sends it as a single SetLightingForKeys packet,
+//either when the flush timer fires or when the game starts drawing the next frame.
+//Hosts that negotiated the compact header get SetLightingForKeysCompact with 5 byte key records instead.
+//Keys with a dense LED index are kept apart in a flat array and sent as SetLightingForLeds when the host knows the index.
+//Background colors and zone colors have buffers of their own, only the last value set before a flush goes out.
+class FrameCoalescer
+{
+public:
+	//called by the flush thread after every flush, without the coalescer locked
+	typedef void (*TickFunction)();
+private:
+	static_assert(PACKET_HEADER_SIZE + sizeof(unsigned int) + sizeof(KeyRecord) * MAX_COALESCED_KEYS <= PACKET_QUEUE_SLOT_SIZE, "A full frame must fit in one queue slot");
+
+	//[u8 led][r][g][b], one per LED at most since drawing an LED twice ends the frame
+	static const unsigned int LedRecordSize = 4;
+
+	ArtemisPipeClient& _client;
+	KeyRecord _keys[MAX_COALESCED_KEYS];
+	unsigned int _keyCount = 0;
+	unsigned char _compact[COMPACT_KEYS_MAX_SIZE(MAX_COALESCED_KEYS)];
+	unsigned char _leds[LED_COUNT * LedRecordSize];
+	unsigned int _ledCount = 0;
+	unsigned char _ledsSet[(LED_COUNT + 7) / 8] = {};
+
+	//the host only recolors keys with SetLighting while the target is exactly per-key,
+	//for every other target it sets one background color
+	std::atomic<int> _targetDevice{ LOGI_DEVICETYPE_ALL };
+	bool _hasBackground = false;
+	unsigned char _background[3];
+
+	//[device][zone][r,g,b] for the device types that have zones, with one bit per zone set since the last flush
+	static const unsigned int ZoneDeviceCount = 5;
+	static_assert(MAX_TARGET_ZONES <= 32, "Zones set are tracked in a 32 bit mask");
+	unsigned char _zones[ZoneDeviceCount][MAX_TARGET_ZONES][3];
+	unsigned int _zonesSet[ZoneDeviceCount] = {};
+	std::mutex _mutex;
+
+	std::atomic<unsigned int> _flushIntervalMs{ 0 };
+	TickFunction _onTick = nullptr;
+	std::thread _flushThread;
+	std::condition_variable _flushCondition;
+	bool _stopRequested = false;
+
+	void FlushLocked();
+	void FlushKeysLocked();
+	void FlushLoop();
+public:
+	explicit FrameCoalescer(ArtemisPipeClient& client);
+	~FrameCoalescer();
+
+	void Start(unsigned int flushRate, TickFunction onTick);
+	void Stop();
+	bool IsEnabled();
+
+	//sends the target to the host after anything that was buffered for the previous one
+	void SetTargetDevice(int targetDevice);
+	bool IsTargeted(int deviceType);
+
+	//these return false when coalescing is off and the caller should send the call itself
+	bool SetLighting(unsigned char red, unsigned char green, unsigned char blue);
+	bool SetZone(LogiLed::DeviceType deviceType, int zone, unsigned char red, unsigned char green, unsigned char blue);
+	bool SetKey(unsigned int command, int keyCode, unsigned char red, unsigned char green, unsigned char blue);
+	void Flush();
+};
\ No newline at end of file
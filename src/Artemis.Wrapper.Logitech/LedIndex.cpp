@@ -0,0 +1,427 @@
+#include "pch.h"
+#include "LedIndex.h"
+#include "LogiCommands.h"
+#include "LogitechLEDLib.h"
+
+namespace
+{
+	struct LedCode {
+		unsigned int code;
+		unsigned char led;
+	};
+
+	//Upper bound for the modulus search, every table below needs far less.
+	constexpr unsigned int MaxPerfectHashSize = 512;
+
+	//Smallest modulus that gives every code its own slot, found while compiling.
+	template <size_t Count>
+	constexpr unsigned int FindModulus(const LedCode(&codes)[Count])
+	{
+		for (unsigned int modulus = Count; modulus <= MaxPerfectHashSize; modulus++) {
+			bool used[MaxPerfectHashSize] = {};
+			bool perfect = true;
+			for (size_t i = 0; i < Count && perfect; i++) {
+				const unsigned int slot = codes[i].code % modulus;
+				perfect = !used[slot];
+				used[slot] = true;
+			}
+			if (perfect) {
+				return modulus;
+			}
+		}
+		return 0;
+	}
+
+	template <size_t Count>
+	constexpr unsigned int CountLeds(const LedCode(&codes)[Count])
+	{
+		unsigned int count = 0;
+		for (size_t i = 0; i < Count; i++) {
+			if (codes[i].led >= count) {
+				count = codes[i].led + 1;
+			}
+		}
+		return count;
+	}
+
+	//Each slot keeps the code it was filled with, a lookup is one modulo and one compare.
+	template <unsigned int Modulus>
+	struct PerfectHashTable
+	{
+		LedCode slots[Modulus];
+
+		template <size_t Count>
+		constexpr PerfectHashTable(const LedCode(&codes)[Count]) : slots{}
+		{
+			for (unsigned int i = 0; i < Modulus; i++) {
+				slots[i] = { 0, NO_LED };
+			}
+			for (size_t i = 0; i < Count; i++) {
+				slots[codes[i].code % Modulus] = codes[i];
+			}
+		}
+
+		unsigned char Find(unsigned int code) const
+		{
+			const LedCode& slot = slots[code % Modulus];
+			return slot.code == code ? slot.led : (unsigned char)NO_LED;
+		}
+	};
+
+	//key names, as the host maps them in LogitechLedIds
+	constexpr LedCode KeyNameCodes[] = {
+		{ LogiLed::ESC, 0 },
+		{ LogiLed::F1, 1 },
+		{ LogiLed::F2, 2 },
+		{ LogiLed::F3, 3 },
+		{ LogiLed::F4, 4 },
+		{ LogiLed::F5, 5 },
+		{ LogiLed::F6, 6 },
+		{ LogiLed::F7, 7 },
+		{ LogiLed::F8, 8 },
+		{ LogiLed::F9, 9 },
+		{ LogiLed::F10, 10 },
+		{ LogiLed::F11, 11 },
+		{ LogiLed::TILDE, 12 },
+		{ LogiLed::ONE, 13 },
+		{ LogiLed::TWO, 14 },
+		{ LogiLed::THREE, 15 },
+		{ LogiLed::FOUR, 16 },
+		{ LogiLed::FIVE, 17 },
+		{ LogiLed::SIX, 18 },
+		{ LogiLed::SEVEN, 19 },
+		{ LogiLed::EIGHT, 20 },
+		{ LogiLed::NINE, 21 },
+		{ LogiLed::ZERO, 22 },
+		{ LogiLed::MINUS, 23 },
+		{ LogiLed::TAB, 24 },
+		{ LogiLed::Q, 25 },
+		{ LogiLed::W, 26 },
+		{ LogiLed::E, 27 },
+		{ LogiLed::R, 28 },
+		{ LogiLed::T, 29 },
+		{ LogiLed::Y, 30 },
+		{ LogiLed::U, 31 },
+		{ LogiLed::I, 32 },
+		{ LogiLed::O, 33 },
+		{ LogiLed::P, 34 },
+		{ LogiLed::OPEN_BRACKET, 35 },
+		{ LogiLed::CAPS_LOCK, 36 },
+		{ LogiLed::A, 37 },
+		{ LogiLed::S, 38 },
+		{ LogiLed::D, 39 },
+		{ LogiLed::F, 40 },
+		{ LogiLed::G, 41 },
+		{ LogiLed::H, 42 },
+		{ LogiLed::J, 43 },
+		{ LogiLed::K, 44 },
+		{ LogiLed::L, 45 },
+		{ LogiLed::SEMICOLON, 46 },
+		{ LogiLed::APOSTROPHE, 47 },
+		{ LogiLed::LEFT_SHIFT, 48 },
+		{ LogiLed::Z, 49 },
+		{ LogiLed::X, 50 },
+		{ LogiLed::C, 51 },
+		{ LogiLed::V, 52 },
+		{ LogiLed::B, 53 },
+		{ LogiLed::N, 54 },
+		{ LogiLed::M, 55 },
+		{ LogiLed::COMMA, 56 },
+		{ LogiLed::PERIOD, 57 },
+		{ LogiLed::FORWARD_SLASH, 58 },
+		{ LogiLed::LEFT_CONTROL, 59 },
+		{ LogiLed::LEFT_WINDOWS, 60 },
+		{ LogiLed::LEFT_ALT, 61 },
+		{ LogiLed::SPACE, 62 },
+		{ LogiLed::RIGHT_ALT, 63 },
+		{ LogiLed::RIGHT_WINDOWS, 64 },
+		{ LogiLed::APPLICATION_SELECT, 65 },
+		{ LogiLed::F12, 66 },
+		{ LogiLed::PRINT_SCREEN, 67 },
+		{ LogiLed::SCROLL_LOCK, 68 },
+		{ LogiLed::PAUSE_BREAK, 69 },
+		{ LogiLed::INSERT, 70 },
+		{ LogiLed::HOME, 71 },
+		{ LogiLed::PAGE_UP, 72 },
+		{ LogiLed::CLOSE_BRACKET, 73 },
+		{ LogiLed::BACKSLASH, 74 },
+		{ LogiLed::ENTER, 75 },
+		{ LogiLed::EQUALS, 76 },
+		{ LogiLed::BACKSPACE, 77 },
+		{ LogiLed::KEYBOARD_DELETE, 78 },
+		{ LogiLed::END, 79 },
+		{ LogiLed::PAGE_DOWN, 80 },
+		{ LogiLed::RIGHT_SHIFT, 81 },
+		{ LogiLed::RIGHT_CONTROL, 82 },
+		{ LogiLed::ARROW_UP, 83 },
+		{ LogiLed::ARROW_LEFT, 84 },
+		{ LogiLed::ARROW_DOWN, 85 },
+		{ LogiLed::ARROW_RIGHT, 86 },
+		{ LogiLed::NUM_LOCK, 87 },
+		{ LogiLed::NUM_SLASH, 88 },
+		{ LogiLed::NUM_ASTERISK, 89 },
+		{ LogiLed::NUM_MINUS, 90 },
+		{ LogiLed::NUM_PLUS, 91 },
+		{ LogiLed::NUM_ENTER, 92 },
+		{ LogiLed::NUM_SEVEN, 93 },
+		{ LogiLed::NUM_EIGHT, 94 },
+		{ LogiLed::NUM_NINE, 95 },
+		{ LogiLed::NUM_FOUR, 96 },
+		{ LogiLed::NUM_FIVE, 97 },
+		{ LogiLed::NUM_SIX, 98 },
+		{ LogiLed::NUM_ONE, 99 },
+		{ LogiLed::NUM_TWO, 100 },
+		{ LogiLed::NUM_THREE, 101 },
+		{ LogiLed::NUM_ZERO, 102 },
+		{ LogiLed::NUM_PERIOD, 103 },
+		{ LogiLed::G_1, 104 },
+		{ LogiLed::G_2, 105 },
+		{ LogiLed::G_3, 106 },
+		{ LogiLed::G_4, 107 },
+		{ LogiLed::G_5, 108 },
+		{ LogiLed::G_6, 109 },
+		{ LogiLed::G_7, 110 },
+		{ LogiLed::G_8, 111 },
+		{ LogiLed::G_9, 112 },
+		{ LogiLed::G_LOGO, 113 },
+		{ LogiLed::G_BADGE, 114 },
+	};
+
+	//DirectInput scan codes, as the host maps them in DirectInputScanCodes
+	constexpr LedCode ScanCodes[] = {
+		{ 0x01, 0 }, //DIK_ESCAPE
+		{ 0x02, 13 }, //DIK_1
+		{ 0x03, 14 }, //DIK_2
+		{ 0x04, 15 }, //DIK_3
+		{ 0x05, 16 }, //DIK_4
+		{ 0x06, 17 }, //DIK_5
+		{ 0x07, 18 }, //DIK_6
+		{ 0x08, 19 }, //DIK_7
+		{ 0x09, 20 }, //DIK_8
+		{ 0x0A, 21 }, //DIK_9
+		{ 0x0B, 22 }, //DIK_0
+		{ 0x0C, 23 }, //DIK_MINUS
+		{ 0x0D, 76 }, //DIK_EQUALS
+		{ 0x0E, 77 }, //DIK_BACK
+		{ 0x0F, 24 }, //DIK_TAB
+		{ 0x10, 25 }, //DIK_Q
+		{ 0x11, 26 }, //DIK_W
+		{ 0x12, 27 }, //DIK_E
+		{ 0x13, 28 }, //DIK_R
+		{ 0x14, 29 }, //DIK_T
+		{ 0x15, 30 }, //DIK_Y
+		{ 0x16, 31 }, //DIK_U
+		{ 0x17, 32 }, //DIK_I
+		{ 0x18, 33 }, //DIK_O
+		{ 0x19, 34 }, //DIK_P
+		{ 0x1A, 35 }, //DIK_LBRACKET
+		{ 0x1B, 73 }, //DIK_RBRACKET
+		{ 0x1C, 75 }, //DIK_RETURN
+		{ 0x1D, 59 }, //DIK_LContol
+		{ 0x1E, 37 }, //DIK_A
+		{ 0x1F, 38 }, //DIK_S
+		{ 0x20, 39 }, //DIK_D
+		{ 0x21, 40 }, //DIK_F
+		{ 0x22, 41 }, //DIK_G
+		{ 0x23, 42 }, //DIK_H
+		{ 0x24, 43 }, //DIK_J
+		{ 0x25, 44 }, //DIK_K
+		{ 0x26, 45 }, //DIK_L
+		{ 0x27, 46 }, //DIK_SEMICOLON
+		{ 0x28, 47 }, //DIK_APOSTROPHE
+		{ 0x29, 12 }, //DIK_GRAVE
+		{ 0x2A, 48 }, //DIK_LSHIFT
+		{ 0x2B, 115 }, //DIK_BACKSLASH
+		{ 0x2C, 49 }, //DIK_Z
+		{ 0x2D, 50 }, //DIK_X
+		{ 0x2E, 51 }, //DIK_C
+		{ 0x2F, 52 }, //DIK_V
+		{ 0x30, 53 }, //DIK_B
+		{ 0x31, 54 }, //DIK_N
+		{ 0x32, 55 }, //DIK_M
+		{ 0x33, 56 }, //DIK_COMMA
+		{ 0x34, 57 }, //DIK_PERIOD
+		{ 0x35, 58 }, //DIK_SLASH
+		{ 0x36, 81 }, //DIK_RSHIFT
+		{ 0x37, 89 }, //DIK_MULTIPLY
+		{ 0x38, 61 }, //DIK_LMENU
+		{ 0x39, 62 }, //DIK_SPACE
+		{ 0x3A, 36 }, //DIK_CAPITAL
+		{ 0x3B, 1 }, //DIK_F1
+		{ 0x3C, 2 }, //DIK_F2
+		{ 0x3D, 3 }, //DIK_F3
+		{ 0x3E, 4 }, //DIK_F4
+		{ 0x3F, 5 }, //DIK_F5
+		{ 0x40, 6 }, //DIK_F6
+		{ 0x41, 7 }, //DIK_F7
+		{ 0x42, 8 }, //DIK_F8
+		{ 0x43, 9 }, //DIK_F9
+		{ 0x44, 10 }, //DIK_F10
+		{ 0x45, 87 }, //DIK_NUMLOCK
+		{ 0x46, 68 }, //DIK_SCROLL
+		{ 0x47, 93 }, //DIK_NUMPAD7
+		{ 0x48, 94 }, //DIK_NUMPAD8
+		{ 0x49, 95 }, //DIK_NUMPAD9
+		{ 0x4A, 90 }, //DIK_SUBTRACT
+		{ 0x4B, 96 }, //DIK_NUMPAD4
+		{ 0x4C, 97 }, //DIK_NUMPAD5
+		{ 0x4D, 98 }, //DIK_NUMPAD6
+		{ 0x4E, 91 }, //DIK_ADD
+		{ 0x4F, 99 }, //DIK_NUMPAD1
+		{ 0x50, 100 }, //DIK_NUMPAD2
+		{ 0x51, 101 }, //DIK_NUMPAD3
+		{ 0x52, 102 }, //DIK_NUMPAD0
+		{ 0x53, 103 }, //DIK_DECIMAL
+		{ 0x57, 11 }, //DIK_F11
+		{ 0x58, 66 }, //DIK_F12
+		{ 0x9C, 92 }, //DIK_NUMPADENTER
+		{ 0x9D, 82 }, //DIK_RCONTROL
+		{ 0xB5, 88 }, //DIK_DIVIDE
+		{ 0xB8, 63 }, //DIK_RMENU
+		{ 0xC5, 69 }, //DIK_PAUSE
+		{ 0xC7, 71 }, //DIK_HOME
+		{ 0xC8, 83 }, //DIK_UP
+		{ 0xC9, 72 }, //DIK_PRIOR
+		{ 0xCB, 84 }, //DIK_LEFT
+		{ 0xCD, 86 }, //DIK_RIGHT
+		{ 0xCF, 79 }, //DIK_END
+		{ 0xD0, 85 }, //DIK_DOWN
+		{ 0xD1, 80 }, //DIK_NEXT
+		{ 0xD2, 70 }, //DIK_INSERT
+		{ 0xD3, 78 }, //DIK_DELETE
+		{ 0xDB, 60 }, //DIK_LWIN
+		{ 0xDC, 64 }, //DIK_RWIN
+		{ 0xDD, 65 }, //DIK_APPS
+	};
+
+	//USB HID usages, as the host maps them in HidCodes
+	constexpr LedCode HidCodes[] = {
+		{ 0x29, 0 }, //KEY_ESC
+		{ 0x3A, 1 }, //KEY_F1
+		{ 0x3B, 2 }, //KEY_F2
+		{ 0x3C, 3 }, //KEY_F3
+		{ 0x3D, 4 }, //KEY_F4
+		{ 0x3E, 5 }, //KEY_F5
+		{ 0x3F, 6 }, //KEY_F6
+		{ 0x40, 7 }, //KEY_F7
+		{ 0x41, 8 }, //KEY_F8
+		{ 0x43, 10 }, //KEY_F10
+		{ 0x44, 11 }, //KEY_F11
+		{ 0x45, 66 }, //KEY_F12
+		{ 0x46, 67 }, //KEY_SYSRQ
+		{ 0x47, 68 }, //KEY_SCROLLLOCK
+		{ 0x48, 69 }, //KEY_PAUSE
+		{ 0x35, 12 }, //KEY_GRAVE
+		{ 0x1E, 13 }, //KEY_1
+		{ 0x1F, 14 }, //KEY_2
+		{ 0x20, 15 }, //KEY_3
+		{ 0x21, 16 }, //KEY_4
+		{ 0x22, 17 }, //KEY_5
+		{ 0x23, 18 }, //KEY_6
+		{ 0x24, 19 }, //KEY_7
+		{ 0x25, 20 }, //KEY_8
+		{ 0x26, 21 }, //KEY_9
+		{ 0x27, 22 }, //KEY_0
+		{ 0x2D, 23 }, //KEY_MINUS
+		{ 0x2E, 76 }, //KEY_EQUAL
+		{ 0x2A, 77 }, //KEY_BACKSPACE
+		{ 0x49, 70 }, //KEY_INSERT
+		{ 0x4A, 71 }, //KEY_HOME
+		{ 0x4B, 72 }, //KEY_PAGEUP
+		{ 0x53, 87 }, //KEY_NUMLOCK
+		{ 0x54, 88 }, //KEY_KPSLASH
+		{ 0x55, 89 }, //KEY_KPASTERISK
+		{ 0x56, 90 }, //KEY_KPMINUS
+		{ 0x2B, 24 }, //KEY_TAB
+		{ 0x14, 25 }, //KEY_Q
+		{ 0x1A, 26 }, //KEY_W
+		{ 0x08, 27 }, //KEY_E
+		{ 0x15, 28 }, //KEY_R
+		{ 0x17, 29 }, //KEY_T
+		{ 0x1C, 30 }, //KEY_Y
+		{ 0x18, 31 }, //KEY_U
+		{ 0x0C, 32 }, //KEY_I
+		{ 0x12, 33 }, //KEY_O
+		{ 0x13, 34 }, //KEY_P
+		{ 0x2F, 35 }, //KEY_LEFTBRACE
+		{ 0x30, 73 }, //KEY_RIGHTBRACE
+		{ 0x31, 74 }, //KEY_BACKSLASH
+		{ 0x4C, 78 }, //KEY_DELETE
+		{ 0x4D, 79 }, //KEY_END
+		{ 0x4E, 80 }, //KEY_PAGEDOWN
+		{ 0x5F, 93 }, //KEY_KP7
+		{ 0x60, 94 }, //KEY_KP8
+		{ 0x61, 95 }, //KEY_KP9
+		{ 0x57, 91 }, //KEY_KPPLUS
+		{ 0x39, 36 }, //KEY_CAPSLOCK
+		{ 0x04, 37 }, //KEY_A
+		{ 0x16, 38 }, //KEY_S
+		{ 0x07, 39 }, //KEY_D
+		{ 0x09, 40 }, //KEY_F
+		{ 0x0A, 41 }, //KEY_G
+		{ 0x0B, 42 }, //KEY_H
+		{ 0x0D, 43 }, //KEY_J
+		{ 0x0E, 44 }, //KEY_K
+		{ 0x0F, 45 }, //KEY_L
+		{ 0x33, 46 }, //KEY_SEMICOLON
+		{ 0x34, 47 }, //KEY_APOSTROPHE
+		{ 0x28, 75 }, //KEY_ENTER
+		{ 0x5C, 96 }, //KEY_KP4
+		{ 0x5D, 97 }, //KEY_KP5
+		{ 0x5E, 98 }, //KEY_KP6
+		{ 0xE1, 48 }, //KEY_LEFTSHIFT
+		{ 0x1D, 49 }, //KEY_Z
+		{ 0x1B, 50 }, //KEY_X
+		{ 0x06, 51 }, //KEY_C
+		{ 0x19, 52 }, //KEY_V
+		{ 0x05, 53 }, //KEY_B
+		{ 0x11, 54 }, //KEY_N
+		{ 0x10, 55 }, //KEY_M
+		{ 0x36, 56 }, //KEY_COMMA
+		{ 0x37, 57 }, //KEY_DOT
+		{ 0x38, 58 }, //KEY_SLASH
+		{ 0xE5, 81 }, //KEY_RIGHTSHIFT
+		{ 0x52, 83 }, //KEY_UP
+		{ 0x59, 99 }, //KEY_KP1
+		{ 0x5A, 100 }, //KEY_KP2
+		{ 0x5B, 101 }, //KEY_KP3
+		{ 0x58, 92 }, //KEY_KPENTER
+		{ 0xE0, 59 }, //KEY_LEFTCTRL
+		{ 0xE3, 60 }, //KEY_LEFTMETA
+		{ 0xE2, 61 }, //KEY_LEFTALT
+		{ 0x2C, 62 }, //KEY_SPACE
+		{ 0xE6, 63 }, //KEY_RIGHTALT
+		{ 0xE7, 64 }, //KEY_RIGHTMETA
+		{ 0xE4, 82 }, //KEY_RIGHTCTRL
+		{ 0x50, 84 }, //KEY_LEFT
+		{ 0x51, 85 }, //KEY_DOWN
+		{ 0x4F, 86 }, //KEY_RIGHT
+		{ 0x63, 102 }, //KEY_KPDOT
+		{ 0x62, 103 }, //KEY_KP0
+	};
+
+	constexpr unsigned int KeyNameModulus = FindModulus(KeyNameCodes);
+	constexpr unsigned int ScanCodeModulus = FindModulus(ScanCodes);
+	constexpr unsigned int HidCodeModulus = FindModulus(HidCodes);
+	static_assert(KeyNameModulus != 0 && ScanCodeModulus != 0 && HidCodeModulus != 0, "No perfect hash within MaxPerfectHashSize");
+	static_assert(CountLeds(KeyNameCodes) <= LED_COUNT && CountLeds(ScanCodes) <= LED_COUNT && CountLeds(HidCodes) <= LED_COUNT, "LED_COUNT is out of date");
+	static_assert(LED_COUNT < NO_LED, "LED indices must fit in a byte");
+
+	constexpr PerfectHashTable<KeyNameModulus> KeyNameTable(KeyNameCodes);
+	constexpr PerfectHashTable<ScanCodeModulus> ScanCodeTable(ScanCodes);
+	constexpr PerfectHashTable<HidCodeModulus> HidCodeTable(HidCodes);
+}
+
+unsigned char GetLedIndex(unsigned int command, int keyCode)
+{
+	switch (command) {
+	case LogiCommands::SetLightingForKeyWithKeyName:
+		return KeyNameTable.Find((unsigned int)keyCode);
+	case LogiCommands::SetLightingForKeyWithScanCode:
+		return ScanCodeTable.Find((unsigned int)keyCode);
+	case LogiCommands::SetLightingForKeyWithHidCode:
+		return HidCodeTable.Find((unsigned int)keyCode);
+	default:
+		return NO_LED;
+	}
+}
\ No newline at end of file
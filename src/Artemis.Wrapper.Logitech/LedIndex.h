@@ -0,0 +1,9 @@
+#pragma once
+
+//Dense LED index shared with LedMapping.DenseLedIds on the host. Scan codes, HID codes and
+//key names all translate to it, so per-key records no longer need the command they came from.
+#define LED_COUNT 116
+#define NO_LED 0xFF
+
+//NO_LED for codes the host has no LED for. Quartz codes never map, the host can't place them either.
+unsigned char GetLedIndex(unsigned int command, int keyCode);
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "LightingState.h"
+#include "BitmapKeyMap.h"
+#include "LogiCommands.h"
+
+void LightingState::SetTargetDevice(int targetDevice)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_current.targetDevice = targetDevice;
+}
+
+void LightingState::SetLighting(EffectColor color)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_current.targetDevice != LOGI_DEVICETYPE_PERKEY_RGB) {
+		_current.hasBackground = true;
+		_current.background = color;
+		return;
+	}
+
+	for (unsigned int i = 0; i < _current.keyCount; i++) {
+		_current.keys[i].color = color;
+	}
+
+	if (_current.hasBitmap) {
+		for (unsigned int i = 0; i < LOGI_LED_BITMAP_KEYS; i++) {
+			//BGRA
+			unsigned char* pixel = &_current.bitmap[i * LOGI_LED_BITMAP_BYTES_PER_KEY];
+			pixel[0] = color.blue;
+			pixel[1] = color.green;
+			pixel[2] = color.red;
+			pixel[3] = 0xFF;
+		}
+	}
+}
+
+void LightingState::SetBitmap(const unsigned char bitmap[])
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	memcpy(_current.bitmap, bitmap, LOGI_LED_BITMAP_SIZE);
+	_current.hasBitmap = true;
+
+	//the bitmap draws over keys set before it, unless they are excluded. Key names are scan codes,
+	//other key codes can't be placed in the bitmap and are kept.
+	for (unsigned int i = _current.keyCount; i-- > 0;) {
+		const KeyOverride& key = _current.keys[i];
+		if (key.command != LogiCommands::SetLightingForKeyWithKeyName && key.command != LogiCommands::SetLightingForKeyWithScanCode) {
+			continue;
+		}
+
+		const int bitmapKey = GetBitmapKey((LogiLed::KeyName)key.keyCode);
+		if (bitmapKey >= 0 && !IsExcludedLocked(bitmapKey)) {
+			_current.keys[i] = _current.keys[--_current.keyCount];
+		}
+	}
+}
+
+void LightingState::SetKey(unsigned int command, int keyCode, EffectColor color)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const int index = FindKeyLocked(command, keyCode);
+	if (index >= 0) {
+		_current.keys[index].color = color;
+		return;
+	}
+
+	//past this many distinct keys new ones still reach the host, they just aren't restored
+	if (_current.keyCount == MAX_KEY_OVERRIDES) {
+		return;
+	}
+
+	KeyOverride& key = _current.keys[_current.keyCount++];
+	key.keyCode = keyCode;
+	key.command = command;
+	key.color = color;
+}
+
+void LightingState::SetZone(LogiLed::DeviceType deviceType, int zone, EffectColor color)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for (unsigned int i = 0; i < _current.zoneCount; i++) {
+		if (_current.zones[i].deviceType == deviceType && _current.zones[i].zone == zone) {
+			_current.zones[i].color = color;
+			return;
+		}
+	}
+
+	//like keys, zones past this still reach the host and aren't restored
+	if (_current.zoneCount == MAX_ZONE_OVERRIDES) {
+		return;
+	}
+
+	ZoneOverride& zoneOverride = _current.zones[_current.zoneCount++];
+	zoneOverride.deviceType = deviceType;
+	zoneOverride.zone = zone;
+	zoneOverride.color = color;
+}
+
+void LightingState::ExcludeKeys(const LogiLed::KeyName keys[], int keyCount)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for (int i = 0; i < keyCount; i++) {
+		const int bitmapKey = GetBitmapKey(keys[i]);
+		if (bitmapKey >= 0) {
+			_excluded[bitmapKey / 8] |= (unsigned char)(1 << (bitmapKey % 8));
+		}
+	}
+}
+
+void LightingState::Clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_current = Snapshot();
+	_savedTop = 0;
+	_savedCount = 0;
+	_savedKeyCount = 0;
+	memset(_excluded, 0, sizeof(_excluded));
+}
+
+void LightingState::Save()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_savedTop = (_savedTop + 1) % LIGHTING_STATE_STACK_DEPTH;
+	_saved[_savedTop] = _current;
+	if (_savedCount < LIGHTING_STATE_STACK_DEPTH) {
+		_savedCount++;
+	}
+}
+
+bool LightingState::Restore(ReplayFunction replay)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_savedCount == 0) {
+		return false;
+	}
+
+	_current = _saved[_savedTop];
+	_savedTop = (_savedTop + LIGHTING_STATE_STACK_DEPTH - 1) % LIGHTING_STATE_STACK_DEPTH;
+	_savedCount--;
+
+	replay(_current);
+	return true;
+}
+
+void LightingState::Replay(ReplayFunction replay)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	replay(_current);
+}
+
+bool LightingState::SendSnapshot(SnapshotFunction send)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_current.keyCount > MaxSnapshotKeys) {
+		return false;
+	}
+
+	unsigned char header[SnapshotHeaderSize];
+	unsigned int buffPtr = 0;
+
+	memcpy(&header[buffPtr], &_current.targetDevice, sizeof(_current.targetDevice));
+	buffPtr += sizeof(_current.targetDevice);
+
+	header[buffPtr++] = (unsigned char)((_current.hasBackground ? SnapshotHasBackground : 0) | (_current.hasBitmap ? SnapshotHasBitmap : 0));
+	header[buffPtr++] = _current.background.red;
+	header[buffPtr++] = _current.background.green;
+	header[buffPtr++] = _current.background.blue;
+
+	memcpy(&header[buffPtr], _excluded, BITMAP_DELTA_MASK_SIZE);
+
+	unsigned char keys[sizeof(unsigned int) + MaxSnapshotKeys * SnapshotKeyRecordSize];
+	buffPtr = 0;
+
+	memcpy(&keys[buffPtr], &_current.keyCount, sizeof(_current.keyCount));
+	buffPtr += sizeof(_current.keyCount);
+
+	for (unsigned int i = 0; i < _current.keyCount; i++) {
+		const KeyOverride& key = _current.keys[i];
+
+		memcpy(&keys[buffPtr], &key.keyCode, sizeof(key.keyCode));
+		buffPtr += sizeof(key.keyCode);
+
+		keys[buffPtr++] = (unsigned char)key.command;
+		keys[buffPtr++] = key.color.red;
+		keys[buffPtr++] = key.color.green;
+		keys[buffPtr++] = key.color.blue;
+	}
+
+	PacketSegment segments[3] = {
+		{ header, SnapshotHeaderSize },
+		{ _current.bitmap, _current.hasBitmap ? (unsigned int)LOGI_LED_BITMAP_SIZE : 0u },
+		{ keys, buffPtr },
+	};
+	send(segments, 3);
+	return true;
+}
+
+bool LightingState::GetKeyColor(LogiLed::KeyName keyName, EffectColor& color)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return FindKeyColorLocked(keyName, color);
+}
+
+void LightingState::SaveKey(LogiLed::KeyName keyName)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const EffectColor color = GetKeyColorLocked(keyName);
+	for (unsigned int i = 0; i < _savedKeyCount; i++) {
+		if (_savedKeys[i].keyName == keyName) {
+			_savedKeys[i].color = color;
+			return;
+		}
+	}
+
+	if (_savedKeyCount == MAX_SAVED_KEYS) {
+		return;
+	}
+
+	_savedKeys[_savedKeyCount].keyName = keyName;
+	_savedKeys[_savedKeyCount].color = color;
+	_savedKeyCount++;
+}
+
+bool LightingState::RestoreKey(LogiLed::KeyName keyName, EffectColor& color)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		unsigned int i = 0;
+		while (i < _savedKeyCount && _savedKeys[i].keyName != keyName) {
+			i++;
+		}
+		if (i == _savedKeyCount) {
+			return false;
+		}
+		color = _savedKeys[i].color;
+	}
+
+	SetKey(LogiCommands::SetLightingForKeyWithKeyName, keyName, color);
+	return true;
+}
+
+int LightingState::FindKeyLocked(unsigned int command, int keyCode)
+{
+	for (unsigned int i = 0; i < _current.keyCount; i++) {
+		if (_current.keys[i].keyCode == keyCode && _current.keys[i].command == command) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool LightingState::IsExcludedLocked(int bitmapKey)
+{
+	return (_excluded[bitmapKey / 8] & (1 << (bitmapKey % 8))) != 0;
+}
+
+bool LightingState::FindKeyColorLocked(LogiLed::KeyName keyName, EffectColor& color)
+{
+	int index = FindKeyLocked(LogiCommands::SetLightingForKeyWithKeyName, keyName);
+	if (index < 0) {
+		index = FindKeyLocked(LogiCommands::SetLightingForKeyWithScanCode, keyName);
+	}
+	if (index >= 0) {
+		color = _current.keys[index].color;
+		return true;
+	}
+
+	const int bitmapKey = GetBitmapKey(keyName);
+	if (_current.hasBitmap && bitmapKey >= 0 && !IsExcludedLocked(bitmapKey)) {
+		//BGRA
+		const unsigned char* pixel = &_current.bitmap[bitmapKey * LOGI_LED_BITMAP_BYTES_PER_KEY];
+		color = { pixel[2], pixel[1], pixel[0] };
+		return true;
+	}
+
+	return false;
+}
+
+EffectColor LightingState::GetKeyColorLocked(LogiLed::KeyName keyName)
+{
+	EffectColor color;
+	if (FindKeyColorLocked(keyName, color)) {
+		return color;
+	}
+	return _current.background;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include "Constants.h"
+#include "LogitechLEDLib.h"
+#include "BitmapDeltaEncoder.h"
+#include "PacketSegment.h"
+#include "EffectEngine.h"
+#include <mutex>
+
+//Lighting the game has set, kept in the wrapper so Save and Restore never need the host.
+//Calls are applied the way the host applies them, SetLighting on a per-key target recolors
+//every key that was set so far instead of the background.
+class LightingState
+{
+public:
+	struct KeyOverride {
+		int keyCode;
+		//the SetLightingForKeyWith... command the key code belongs to
+		unsigned int command;
+		EffectColor color;
+	};
+
+	struct ZoneOverride {
+		LogiLed::DeviceType deviceType;
+		int zone;
+		EffectColor color;
+	};
+
+	struct Snapshot {
+		int targetDevice = LOGI_DEVICETYPE_ALL;
+		bool hasBackground = false;
+		EffectColor background = {};
+		bool hasBitmap = false;
+		unsigned char bitmap[LOGI_LED_BITMAP_SIZE];
+		unsigned int keyCount = 0;
+		KeyOverride keys[MAX_KEY_OVERRIDES];
+		//zones don't go in the SetLightingSnapshot payload, they follow it as SetLightingForTargetZone
+		unsigned int zoneCount = 0;
+		ZoneOverride zones[MAX_ZONE_OVERRIDES];
+	};
+
+	//sends a restored snapshot to the host, called while the state is locked
+	typedef void (*ReplayFunction)(const Snapshot& snapshot);
+	//writes an encoded SetLightingSnapshot payload, called while the state is locked
+	typedef void (*SnapshotFunction)(const PacketSegment segments[], unsigned int segmentCount);
+
+	//[int targetDevice][u8 flags][r][g][b][exclusion mask] in front of the optional bitmap
+	//and the [u32 count][int keyCode][u8 command][r][g][b] key records
+	static const unsigned int SnapshotHeaderSize = sizeof(int) + 4 + BITMAP_DELTA_MASK_SIZE;
+	static const unsigned int SnapshotKeyRecordSize = 8;
+	static const unsigned int SnapshotHasBackground = 0x01;
+	static const unsigned int SnapshotHasBitmap = 0x02;
+	//more keys than this don't fit in a queue slot next to a bitmap
+	static const unsigned int MaxSnapshotKeys = (PACKET_QUEUE_SLOT_SIZE - PACKET_HEADER_SIZE - SnapshotHeaderSize - LOGI_LED_BITMAP_SIZE - sizeof(unsigned int)) / SnapshotKeyRecordSize;
+private:
+	struct SavedKey {
+		LogiLed::KeyName keyName;
+		EffectColor color;
+	};
+
+	Snapshot _current;
+	//SaveCurrentLighting pushes, RestoreLighting pops, the oldest snapshot is dropped once it is full
+	Snapshot _saved[LIGHTING_STATE_STACK_DEPTH];
+	unsigned int _savedTop = 0;
+	unsigned int _savedCount = 0;
+	SavedKey _savedKeys[MAX_SAVED_KEYS];
+	unsigned int _savedKeyCount = 0;
+	//one bit per bitmap key, excluded keys keep their own color when a bitmap is set
+	unsigned char _excluded[BITMAP_DELTA_MASK_SIZE] = {};
+	std::mutex _mutex;
+
+	int FindKeyLocked(unsigned int command, int keyCode);
+	bool IsExcludedLocked(int bitmapKey);
+	bool FindKeyColorLocked(LogiLed::KeyName keyName, EffectColor& color);
+	EffectColor GetKeyColorLocked(LogiLed::KeyName keyName);
+public:
+	void SetTargetDevice(int targetDevice);
+	void SetLighting(EffectColor color);
+	void SetBitmap(const unsigned char bitmap[]);
+	void SetKey(unsigned int command, int keyCode, EffectColor color);
+	void SetZone(LogiLed::DeviceType deviceType, int zone, EffectColor color);
+	void ExcludeKeys(const LogiLed::KeyName keys[], int keyCount);
+	void Clear();
+
+	void Save();
+	//false when nothing was saved
+	bool Restore(ReplayFunction replay);
+	//sends the current state without touching what was saved
+	void Replay(ReplayFunction replay);
+	//the current state and exclusions as one packet, false when there are too many keys for it
+	bool SendSnapshot(SnapshotFunction send);
+	//false when the key shows the background, it has no color of its own from a key call or the bitmap
+	bool GetKeyColor(LogiLed::KeyName keyName, EffectColor& color);
+	void SaveKey(LogiLed::KeyName keyName);
+	//false when the key was never saved, otherwise it is set back to color
+	bool RestoreKey(LogiLed::KeyName keyName, EffectColor& color);
+};
\ No newline at end of file
@@ -15,7 +15,11 @@ inline void log_to_file(std::string data) {
 
 	std::time_t t = std::time(nullptr);
 	struct tm newTime;
+#ifdef _WIN32
 	localtime_s(&newTime, &t);
+#else
+	localtime_r(&t, &newTime);
+#endif
 	std::string timeHeader = fmt::format("[{:%Y-%m-%d %H:%M:%S}] ", newTime);
 
 	logFile << timeHeader << data << '\n';
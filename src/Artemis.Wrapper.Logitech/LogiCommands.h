@@ -33,4 +33,12 @@ enum LogiCommands : unsigned int {
 	StopEffectsOnKey,
 	SetLightingForTargetZone,
 	Shutdown,
+	AttachSharedMemory,
+	SetLightingForKeys,
+	Batch,
+	SetLightingFromBitmapDelta,
+	InitAck,
+	SetLightingForKeysCompact,
+	SetLightingForLeds,
+	SetLightingSnapshot,
 };
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "NamedPipeTransport.h"
+#include "Constants.h"
+#include "Logger.h"
+
+NamedPipeTransport::~NamedPipeTransport()
+{
+	Close();
+	if (_event != NULL) {
+		CloseHandle(_event);
+	}
+}
+
+const char* NamedPipeTransport::GetName()
+{
+	return "pipe";
+}
+
+bool NamedPipeTransport::Open()
+{
+	if (_event == NULL) {
+		_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+		if (_event == NULL) {
+			LOG(fmt::format("Failed to create the pipe io event. Error: {}", GetLastError()));
+			return false;
+		}
+	}
+
+	_pipe = CreateFile(
+		PIPE_NAME,
+		GENERIC_READ | GENERIC_WRITE,
+		0,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_OVERLAPPED,
+		NULL);
+	_duplex = _pipe != NULL && _pipe != INVALID_HANDLE_VALUE;
+
+	//an inbound-only pipe from an older host refuses read access
+	if (!_duplex && GetLastError() == ERROR_ACCESS_DENIED) {
+		_pipe = CreateFile(
+			PIPE_NAME,
+			GENERIC_WRITE,
+			0,
+			NULL,
+			OPEN_EXISTING,
+			FILE_FLAG_OVERLAPPED,
+			NULL);
+	}
+	return _pipe != NULL && _pipe != INVALID_HANDLE_VALUE;
+}
+
+void NamedPipeTransport::Close()
+{
+	if (_pipe != NULL && _pipe != INVALID_HANDLE_VALUE) {
+		CloseHandle(_pipe);
+	}
+	_pipe = NULL;
+}
+
+Transport::WriteStatus NamedPipeTransport::Write(const void* data, unsigned int length, unsigned int timeoutMs)
+{
+	memset(&_overlapped, 0, sizeof(_overlapped));
+	_overlapped.hEvent = _event;
+	_writeLength = length;
+
+	if (!WriteFile(_pipe, data, length, NULL, &_overlapped) && GetLastError() != ERROR_IO_PENDING) {
+		LOG(fmt::format("Error writing to pipe: \'{}\'. Wrote 0 bytes out of {}", GetLastError(), length));
+		return WriteStatus::Failed;
+	}
+	return WaitForWrite(timeoutMs);
+}
+
+Transport::WriteStatus NamedPipeTransport::WaitForWrite(unsigned int timeoutMs)
+{
+	if (WaitForSingleObject(_event, timeoutMs) == WAIT_TIMEOUT) {
+		return WriteStatus::Pending;
+	}
+
+	DWORD writtenLength = 0;
+	BOOL result = GetOverlappedResult(_pipe, &_overlapped, &writtenLength, FALSE);
+	if ((!result) || (writtenLength < _writeLength)) {
+		LOG(fmt::format("Error writing to pipe: \'{}\'. Wrote {} bytes out of {}", result, writtenLength, _writeLength));
+		return WriteStatus::Failed;
+	}
+	return WriteStatus::Written;
+}
+
+void NamedPipeTransport::CancelWrite()
+{
+	//the caller's buffer is only free again once the write is really over
+	DWORD writtenLength = 0;
+	CancelIoEx(_pipe, &_overlapped);
+	GetOverlappedResult(_pipe, &_overlapped, &writtenLength, TRUE);
+}
+
+bool NamedPipeTransport::Read(void* buffer, unsigned int length, unsigned int timeoutMs)
+{
+	//the pipe is overlapped, so the read waits on the event like a write does and is cancelled at the deadline.
+	//in byte mode the reply can arrive in pieces
+	const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+	char* buffPtr = (char*)buffer;
+	DWORD remaining = length;
+	while (remaining > 0) {
+		OVERLAPPED overlapped = { 0 };
+		overlapped.hEvent = _event;
+		if (!ReadFile(_pipe, buffPtr, remaining, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+			return false;
+		}
+
+		const ULONGLONG now = GetTickCount64();
+		DWORD readLength = 0;
+		if (WaitForSingleObject(_event, now < deadline ? (DWORD)(deadline - now) : 0) == WAIT_TIMEOUT) {
+			//the buffer is only free again once the read is really over
+			CancelIoEx(_pipe, &overlapped);
+			GetOverlappedResult(_pipe, &overlapped, &readLength, TRUE);
+			return false;
+		}
+		if (!GetOverlappedResult(_pipe, &overlapped, &readLength, FALSE) || readLength == 0) {
+			return false;
+		}
+		buffPtr += readLength;
+		remaining -= readLength;
+	}
+	return true;
+}
+
+bool NamedPipeTransport::IsDuplex()
+{
+	return _duplex;
+}
\ No newline at end of file
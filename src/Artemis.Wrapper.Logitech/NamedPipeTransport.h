@@ -0,0 +1,24 @@
+#pragma once
+#include "Transport.h"
+
+//Opened for overlapped I/O, so a host that stops reading can't hold a write forever. Windows only.
+class NamedPipeTransport : public Transport
+{
+private:
+	HANDLE _pipe = NULL;
+	bool _duplex = false;
+	HANDLE _event = NULL;
+	OVERLAPPED _overlapped;
+	DWORD _writeLength = 0;
+public:
+	~NamedPipeTransport();
+
+	const char* GetName() override;
+	bool Open() override;
+	void Close() override;
+	WriteStatus Write(const void* data, unsigned int length, unsigned int timeoutMs) override;
+	WriteStatus WaitForWrite(unsigned int timeoutMs) override;
+	void CancelWrite() override;
+	bool Read(void* buffer, unsigned int length, unsigned int timeoutMs) override;
+	bool IsDuplex() override;
+};
@@ -0,0 +1,366 @@
+#include "pch.h"
+#include "OriginalDllTee.h"
+#include "BitmapKeyMap.h"
+#include "Logger.h"
+#include "PacketCodec.h"
+
+OriginalDllTee::OriginalDllTee(OriginalDllWrapper& originalDll, ResyncFunction resync) : _originalDll(originalDll), _resync(resync)
+{
+}
+
+OriginalDllTee::~OriginalDllTee()
+{
+	//we can't join from DllMain, the process is going away anyway.
+	if (_workerThread.joinable()) {
+		_workerThread.detach();
+	}
+}
+
+void OriginalDllTee::Start()
+{
+	if (_workerThread.joinable()) {
+		return;
+	}
+
+	_stopRequested = false;
+	_started = true;
+	_workerThread = std::thread(&OriginalDllTee::WorkerLoop, this);
+}
+
+void OriginalDllTee::Stop()
+{
+	if (!_workerThread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopRequested = true;
+	}
+	_condition.notify_one();
+	_workerThread.join();
+	_started = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queueCount = 0;
+		_replaceableFrom = 0;
+		_bitmapCount = 0;
+		_excludedCount = 0;
+		_excludedSent = 0;
+		_resyncRequested = false;
+	}
+
+	if (_originalInitialized) {
+		_originalDll.LogiLedShutdown();
+		_originalInitialized = false;
+	}
+	LOG(fmt::format("Forwarded {} calls to the original dll, replaced {}, dropped the queue {} times", GetForwardedCalls(), GetReplacedCalls(), GetOverflows()));
+}
+
+bool OriginalDllTee::IsStarted()
+{
+	return _started;
+}
+
+void OriginalDllTee::SetTargetDevice(int targetDevice)
+{
+	if (!_started) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Call* tail = TailLocked(CallKind::TargetDevice);
+		if (tail) {
+			tail->code = targetDevice;
+			_replacedCalls++;
+		}
+		else {
+			QueueLocked(CallKind::TargetDevice, targetDevice, 0, {}, true);
+		}
+	}
+	_condition.notify_one();
+}
+
+void OriginalDllTee::SetLighting(EffectColor color)
+{
+	if (!_started) {
+		return;
+	}
+
+	{
+		//on a per-key target it recolors the keys before it, so it stays in order with them
+		std::lock_guard<std::mutex> lock(_mutex);
+		Call* tail = TailLocked(CallKind::Lighting);
+		if (tail) {
+			tail->color = color;
+			_replacedCalls++;
+		}
+		else {
+			QueueLocked(CallKind::Lighting, 0, 0, color, true);
+		}
+	}
+	_condition.notify_one();
+}
+
+void OriginalDllTee::SetBitmap(const unsigned char bitmap[])
+{
+	if (!_started) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Call* tail = TailLocked(CallKind::Bitmap);
+		if (tail) {
+			memcpy(_bitmaps[tail->code], bitmap, LOGI_LED_BITMAP_SIZE);
+			_replacedCalls++;
+		}
+		else {
+			if (_bitmapCount == TEE_QUEUE_BITMAPS || _queueCount == TEE_QUEUE_CAPACITY) {
+				OverflowLocked();
+			}
+			memcpy(_bitmaps[_bitmapCount], bitmap, LOGI_LED_BITMAP_SIZE);
+			QueueLocked(CallKind::Bitmap, _bitmapCount++, 0, {}, true);
+		}
+	}
+	_condition.notify_one();
+}
+
+void OriginalDllTee::SetKey(unsigned int command, int keyCode, EffectColor color)
+{
+	if (!_started) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!ReplaceLocked(CallKind::Key, keyCode, command, color)) {
+			QueueLocked(CallKind::Key, keyCode, command, color, false);
+		}
+	}
+	_condition.notify_one();
+}
+
+void OriginalDllTee::SetZone(LogiLed::DeviceType deviceType, int zone, EffectColor color)
+{
+	if (!_started) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!ReplaceLocked(CallKind::Zone, zone, deviceType, color)) {
+			QueueLocked(CallKind::Zone, zone, deviceType, color, false);
+		}
+	}
+	_condition.notify_one();
+}
+
+void OriginalDllTee::ExcludeKeys(const LogiLed::KeyName keys[], int keyCount)
+{
+	if (!_started) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const unsigned int previousCount = _excludedCount;
+
+		//keys outside the bitmap don't change what it draws
+		for (int i = 0; i < keyCount; i++) {
+			if (GetBitmapKey(keys[i]) < 0) {
+				continue;
+			}
+
+			unsigned int j = 0;
+			while (j < _excludedCount && _excluded[j] != keys[i]) {
+				j++;
+			}
+			if (j == _excludedCount && _excludedCount < LOGI_LED_BITMAP_KEYS) {
+				_excluded[_excludedCount++] = keys[i];
+			}
+		}
+
+		if (_excludedCount == previousCount) {
+			return;
+		}
+
+		Call* tail = TailLocked(CallKind::ExcludeKeys);
+		if (tail) {
+			tail->code = _excludedCount;
+		}
+		else {
+			QueueLocked(CallKind::ExcludeKeys, _excludedCount, 0, {}, true);
+		}
+	}
+	_condition.notify_one();
+}
+
+void OriginalDllTee::Replay(const LightingState::Snapshot& snapshot)
+{
+	SetTargetDevice(LOGI_DEVICETYPE_ALL);
+
+	if (snapshot.hasBackground) {
+		SetLighting(snapshot.background);
+	}
+
+	if (snapshot.hasBitmap) {
+		SetBitmap(snapshot.bitmap);
+	}
+
+	for (unsigned int i = 0; i < snapshot.keyCount; i++) {
+		SetKey(snapshot.keys[i].command, snapshot.keys[i].keyCode, snapshot.keys[i].color);
+	}
+
+	for (unsigned int i = 0; i < snapshot.zoneCount; i++) {
+		SetZone(snapshot.zones[i].deviceType, snapshot.zones[i].zone, snapshot.zones[i].color);
+	}
+
+	SetTargetDevice(snapshot.targetDevice);
+}
+
+unsigned long long OriginalDllTee::GetForwardedCalls()
+{
+	return _forwardedCalls;
+}
+
+unsigned long long OriginalDllTee::GetReplacedCalls()
+{
+	return _replacedCalls;
+}
+
+unsigned int OriginalDllTee::GetOverflows()
+{
+	return _overflows;
+}
+
+OriginalDllTee::Call* OriginalDllTee::TailLocked(CallKind kind)
+{
+	if (_queueCount == 0 || _queue[_queueCount - 1].kind != kind) {
+		return nullptr;
+	}
+	return &_queue[_queueCount - 1];
+}
+
+bool OriginalDllTee::ReplaceLocked(CallKind kind, int code, unsigned int detail, EffectColor color)
+{
+	for (unsigned int i = _queueCount; i-- > _replaceableFrom;) {
+		Call& call = _queue[i];
+		if (call.kind == kind && call.code == code && call.detail == detail) {
+			call.color = color;
+			_replacedCalls++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void OriginalDllTee::QueueLocked(CallKind kind, int code, unsigned int detail, EffectColor color, bool ordered)
+{
+	if (_queueCount == TEE_QUEUE_CAPACITY) {
+		OverflowLocked();
+	}
+
+	Call& call = _queue[_queueCount++];
+	call.kind = kind;
+	call.code = code;
+	call.detail = detail;
+	call.color = color;
+
+	if (ordered) {
+		_replaceableFrom = _queueCount;
+	}
+}
+
+void OriginalDllTee::OverflowLocked()
+{
+	//the original DLL can't keep up, the worker queues the latest state once it gets here.
+	//zones aren't part of it, calls queued from now on still go out in front of it.
+	_queueCount = 0;
+	_replaceableFrom = 0;
+	_bitmapCount = 0;
+	_resyncRequested = true;
+	_overflows++;
+
+	if (_excludedCount > 0) {
+		QueueLocked(CallKind::ExcludeKeys, _excludedCount, 0, {}, true);
+	}
+}
+
+void OriginalDllTee::Send(const Call& call)
+{
+	const int red = ByteToPercent(call.color.red);
+	const int green = ByteToPercent(call.color.green);
+	const int blue = ByteToPercent(call.color.blue);
+
+	switch (call.kind) {
+	case CallKind::TargetDevice:
+		_originalDll.LogiLedSetTargetDevice(call.code);
+		break;
+	case CallKind::Lighting:
+		_originalDll.LogiLedSetLighting(red, green, blue);
+		break;
+	case CallKind::Bitmap:
+		_originalDll.LogiLedSetLightingFromBitmap(_sendingBitmaps[call.code]);
+		break;
+	case CallKind::Key:
+		_originalDll.SetLightingForKey(call.detail, call.code, red, green, blue);
+		break;
+	case CallKind::Zone:
+		_originalDll.LogiLedSetLightingForTargetZone((LogiLed::DeviceType)call.detail, call.code, red, green, blue);
+		break;
+	case CallKind::ExcludeKeys:
+		if ((unsigned int)call.code > _excludedSent) {
+			_originalDll.LogiLedExcludeKeysFromBitmap(&_sendingExcluded[_excludedSent], call.code - _excludedSent);
+			_excludedSent = call.code;
+		}
+		break;
+	}
+}
+
+void OriginalDllTee::WorkerLoop()
+{
+	//LGS and G HUB can take a while to come up, the game doesn't wait for it
+	_originalDll.LoadDll();
+	_originalInitialized = _originalDll.IsDllLoaded() && _originalDll.LogiLedInit();
+	if (!_originalInitialized) {
+		LOG("Could not initialize the original dll, lighting only goes to the host");
+		_started = false;
+		return;
+	}
+	LOG("Forwarding lighting to the original dll");
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_condition.wait(lock, [this] { return _queueCount > 0 || _resyncRequested || _stopRequested; });
+		if (_stopRequested) {
+			break;
+		}
+
+		if (_resyncRequested) {
+			_resyncRequested = false;
+			lock.unlock();
+			_resync();
+			lock.lock();
+			continue;
+		}
+
+		const unsigned int count = _queueCount;
+		memcpy(_sending, _queue, count * sizeof(Call));
+		memcpy(_sendingBitmaps, _bitmaps, _bitmapCount * LOGI_LED_BITMAP_SIZE);
+		memcpy(_sendingExcluded, _excluded, _excludedCount * sizeof(LogiLed::KeyName));
+		_queueCount = 0;
+		_replaceableFrom = 0;
+		_bitmapCount = 0;
+		lock.unlock();
+
+		for (unsigned int i = 0; i < count; i++) {
+			Send(_sending[i]);
+		}
+		_forwardedCalls += count;
+
+		lock.lock();
+	}
+}
\ No newline at end of file
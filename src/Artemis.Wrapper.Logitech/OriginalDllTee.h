@@ -0,0 +1,101 @@
+#pragma once
+#include "Constants.h"
+#include "OriginalDllWrapper.h"
+#include "EffectEngine.h"
+#include "LightingState.h"
+#include "LogitechLEDLib.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//Forwards lighting to the original Logitech DLL next to the host, for devices only LGS or G HUB drive.
+//Calls are queued in order and made by a worker thread, so a slow original DLL never holds up the game
+//or the pipe. A key, zone or repeated call replaces the queued one it overwrites as long as nothing
+//that depends on the order was queued in between. A full queue is dropped and the state queued instead.
+class OriginalDllTee
+{
+public:
+	//queues the whole lighting state through Replay, called on the worker thread
+	typedef void (*ResyncFunction)();
+private:
+	enum class CallKind : unsigned char {
+		TargetDevice,
+		Lighting,
+		Bitmap,
+		Key,
+		Zone,
+		ExcludeKeys,
+	};
+
+	struct Call {
+		CallKind kind;
+		//target device, key code, zone, bitmap slot or the number of excluded keys
+		int code;
+		//the SetLightingForKeyWith... command or the device type of a zone
+		unsigned int detail;
+		EffectColor color;
+	};
+
+	OriginalDllWrapper& _originalDll;
+	ResyncFunction _resync;
+
+	Call _queue[TEE_QUEUE_CAPACITY];
+	unsigned int _queueCount = 0;
+	//queued calls from here on can be replaced, the ones before go out as they are
+	unsigned int _replaceableFrom = 0;
+	unsigned char _bitmaps[TEE_QUEUE_BITMAPS][LOGI_LED_BITMAP_SIZE];
+	unsigned int _bitmapCount = 0;
+	//exclusions only add up, a queued ExcludeKeys call sends the ones added since the last
+	LogiLed::KeyName _excluded[LOGI_LED_BITMAP_KEYS];
+	unsigned int _excludedCount = 0;
+	bool _resyncRequested = false;
+	//only touched by the worker until it is joined
+	bool _originalInitialized = false;
+
+	//the worker takes the whole queue at once and calls the original DLL with nothing locked
+	Call _sending[TEE_QUEUE_CAPACITY];
+	unsigned char _sendingBitmaps[TEE_QUEUE_BITMAPS][LOGI_LED_BITMAP_SIZE];
+	LogiLed::KeyName _sendingExcluded[LOGI_LED_BITMAP_KEYS];
+	unsigned int _excludedSent = 0;
+
+	std::atomic<bool> _started{ false };
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::thread _workerThread;
+	bool _stopRequested = false;
+
+	std::atomic<unsigned long long> _forwardedCalls{ 0 };
+	std::atomic<unsigned long long> _replacedCalls{ 0 };
+	std::atomic<unsigned int> _overflows{ 0 };
+
+	Call* TailLocked(CallKind kind);
+	bool ReplaceLocked(CallKind kind, int code, unsigned int detail, EffectColor color);
+	void QueueLocked(CallKind kind, int code, unsigned int detail, EffectColor color, bool ordered);
+	void OverflowLocked();
+	void Send(const Call& call);
+	void WorkerLoop();
+public:
+	OriginalDllTee(OriginalDllWrapper& originalDll, ResyncFunction resync);
+	~OriginalDllTee();
+
+	//the original DLL is loaded and initialized by the worker, calls queue up until then
+	void Start();
+	//the original DLL is shut down again, calls still queued are dropped
+	void Stop();
+	bool IsStarted();
+
+	//these do nothing until Start
+	void SetTargetDevice(int targetDevice);
+	void SetLighting(EffectColor color);
+	void SetBitmap(const unsigned char bitmap[]);
+	void SetKey(unsigned int command, int keyCode, EffectColor color);
+	void SetZone(LogiLed::DeviceType deviceType, int zone, EffectColor color);
+	void ExcludeKeys(const LogiLed::KeyName keys[], int keyCount);
+	//queues a snapshot the way the wrapper replays it to the host
+	void Replay(const LightingState::Snapshot& snapshot);
+
+	unsigned long long GetForwardedCalls();
+	unsigned long long GetReplacedCalls();
+	unsigned int GetOverflows();
+};
\ No newline at end of file
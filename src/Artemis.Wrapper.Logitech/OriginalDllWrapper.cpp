@@ -2,6 +2,7 @@
 #include "pch.h"
 #include "OriginalDllWrapper.h"
 #include "Constants.h"
+#include "LogiCommands.h"
 #include "Logger.h"
 #include "Utils.h"
 
@@ -35,7 +36,7 @@ void OriginalDllWrapper::LoadDll() {
 
 	dll.Load(buffer);
 
-	if (!IsDllLoaded()) {
+	if (!dll.IsLoaded()) {
 		LOG("Failed to load original dll");
 		return;
 	}
@@ -43,6 +44,7 @@ void OriginalDllWrapper::LoadDll() {
 	LOG("Loaded original dll");
 
 	LoadFunctions();
+	loaded = true;
 
 	LOG("Loaded original dll functions");
 }
@@ -88,5 +90,21 @@ void OriginalDllWrapper::LoadFunctions() {
 }
 
 bool OriginalDllWrapper::IsDllLoaded(){
-	return dll.IsLoaded();
+	return loaded;
+}
+
+bool OriginalDllWrapper::SetLightingForKey(unsigned int command, int keyCode, int redPercentage, int greenPercentage, int bluePercentage)
+{
+	switch (command) {
+	case LogiCommands::SetLightingForKeyWithScanCode:
+		return LogiLedSetLightingForKeyWithScanCode(keyCode, redPercentage, greenPercentage, bluePercentage);
+	case LogiCommands::SetLightingForKeyWithHidCode:
+		return LogiLedSetLightingForKeyWithHidCode(keyCode, redPercentage, greenPercentage, bluePercentage);
+	case LogiCommands::SetLightingForKeyWithQuartzCode:
+		return LogiLedSetLightingForKeyWithQuartzCode(keyCode, redPercentage, greenPercentage, bluePercentage);
+	case LogiCommands::SetLightingForKeyWithKeyName:
+		return LogiLedSetLightingForKeyWithKeyName((LogiLed::KeyName)keyCode, redPercentage, greenPercentage, bluePercentage);
+	default:
+		return false;
+	}
 }
\ No newline at end of file
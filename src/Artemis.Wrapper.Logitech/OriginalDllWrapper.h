@@ -1,11 +1,14 @@
 #pragma once
 #include "LogitechLEDLib.h"
 #include "DllHelper.h"
+#include <atomic>
 #include <string>
 
 class OriginalDllWrapper {
 private:
 	DllHelper dll;
+	//set once the functions are loaded, the dll may be loaded on another thread while the game calls in
+	std::atomic<bool> loaded{ false };
 	void LoadFunctions();
 public:
 	void LoadDll();
@@ -49,4 +52,7 @@ public:
 	decltype(LogiLedSetLightingForTargetZone)* LogiLedSetLightingForTargetZone;
 
 	decltype(LogiLedShutdown)* LogiLedShutdown;
+
+	//calls the SetLightingForKeyWith... function command stands for
+	bool SetLightingForKey(unsigned int command, int keyCode, int redPercentage, int greenPercentage, int bluePercentage);
 };
\ No newline at end of file
@@ -0,0 +1,161 @@
+#pragma once
+#include "LogiCommands.h"
+#include "LogitechLEDLib.h"
+#include "PacketSegment.h"
+#include <string.h>
+
+//Every fixed size packet is declared once at the bottom of this file as its command plus a list of
+//field types. The payload size is computed at compile time and Encode writes each field at a constant
+//offset, so the size and the memcpy's can't drift apart like the hand written encoders did.
+
+template <typename... Fields>
+struct PayloadSize;
+
+template <>
+struct PayloadSize<> {
+	static const unsigned int value = 0;
+};
+
+template <typename Field, typename... Rest>
+struct PayloadSize<Field, Rest...> {
+	static const unsigned int value = sizeof(Field) + PayloadSize<Rest...>::value;
+};
+
+inline void EncodeFields(unsigned char*)
+{
+}
+
+template <typename Field, typename... Rest>
+inline void EncodeFields(unsigned char* buff, const Field& field, const Rest&... rest)
+{
+	memcpy(buff, &field, sizeof(Field));
+	EncodeFields(buff + sizeof(Field), rest...);
+}
+
+template <LogiCommands Command, typename... Fields>
+struct PacketSchema
+{
+	static const unsigned int command = Command;
+	static const unsigned int payloadSize = PayloadSize<Fields...>::value;
+
+	//never zero sized, so commands without fields compile too
+	struct Payload {
+		unsigned char data[payloadSize == 0 ? 1 : payloadSize];
+	};
+
+	static PacketSegment Encode(Payload& payload, Fields... fields)
+	{
+		EncodeFields(payload.data, fields...);
+		PacketSegment segment = { payload.data, payloadSize };
+		return segment;
+	}
+};
+
+//LEB128, 7 bits per byte with the high bit set on all but the last. Returns the bytes written, at most 5.
+inline unsigned int EncodeVarint(unsigned int value, unsigned char* buff)
+{
+	unsigned int buffPtr = 0;
+	while (value >= 0x80) {
+		buff[buffPtr++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	buff[buffPtr++] = (unsigned char)value;
+	return buffPtr;
+}
+
+//[varint length of the rest][command][low byte of the sequence], returns the bytes written
+inline unsigned int EncodeCompactHeader(unsigned int command, unsigned int bodyLength, unsigned int sequence, unsigned char header[])
+{
+	const unsigned char opcode = (unsigned char)command;
+	const unsigned char shortSequence = (unsigned char)sequence;
+
+	unsigned int buffPtr = EncodeVarint(sizeof(opcode) + sizeof(shortSequence) + bodyLength, header);
+	header[buffPtr++] = opcode;
+	header[buffPtr++] = shortSequence;
+	return buffPtr;
+}
+
+//One record of SetLightingForKeys, sent as is.
+struct KeyRecord {
+	int keyCode;
+	unsigned char command;
+	unsigned char red;
+	unsigned char green;
+	unsigned char blue;
+};
+static_assert(sizeof(KeyRecord) == 8, "Key record layout is shared with the host");
+
+//compact frames are runs of [command][count] followed by [u16 keyCode][r][g][b] records,
+//worst case every key starts a run of its own
+#define COMPACT_KEY_RECORD_SIZE (sizeof(unsigned short) + 3)
+#define COMPACT_KEYS_MAX_SIZE(keyCount) ((keyCount) * (2 + COMPACT_KEY_RECORD_SIZE))
+
+//Packs key records for SetLightingForKeysCompact, false when a key code doesn't fit in 16 bits.
+//The G logo and badge key names are past it, frames holding them go out in full.
+inline bool EncodeCompactKeys(const KeyRecord keys[], unsigned int keyCount, unsigned char buff[], unsigned int& length)
+{
+	unsigned int buffPtr = 0;
+	unsigned int runStart = 0;
+
+	for (unsigned int i = 0; i < keyCount; i++) {
+		const KeyRecord& key = keys[i];
+		if (key.keyCode < 0 || key.keyCode > 0xFFFF) {
+			return false;
+		}
+
+		if (i == 0 || buff[runStart] != key.command || buff[runStart + 1] == 0xFF) {
+			runStart = buffPtr;
+			buff[buffPtr++] = key.command;
+			buff[buffPtr++] = 0;
+		}
+		buff[runStart + 1]++;
+
+		const unsigned short keyCode = (unsigned short)key.keyCode;
+		memcpy(&buff[buffPtr], &keyCode, sizeof(keyCode));
+		buffPtr += sizeof(keyCode);
+
+		buff[buffPtr++] = key.red;
+		buff[buffPtr++] = key.green;
+		buff[buffPtr++] = key.blue;
+	}
+
+	length = buffPtr;
+	return true;
+}
+
+//rounds to the nearest value, out of range percentages are clamped
+inline unsigned char PercentToByte(int percentage)
+{
+	if (percentage <= 0) {
+		return 0;
+	}
+	if (percentage >= 100) {
+		return 255;
+	}
+	return (unsigned char)((percentage * 255 + 50) / 100);
+}
+
+//the other way around for the original dll, a percentage survives the round trip
+inline int ByteToPercent(unsigned char value)
+{
+	return (value * 100 + 127) / 255;
+}
+
+typedef PacketSchema<LogiCommands::SetTargetDevice, int> SetTargetDevicePacket;
+typedef PacketSchema<LogiCommands::SetLighting, unsigned char, unsigned char, unsigned char> SetLightingPacket;
+typedef PacketSchema<LogiCommands::SetLightingForKeyWithScanCode, int, unsigned char, unsigned char, unsigned char> SetLightingForKeyWithScanCodePacket;
+typedef PacketSchema<LogiCommands::SetLightingForKeyWithHidCode, int, unsigned char, unsigned char, unsigned char> SetLightingForKeyWithHidCodePacket;
+typedef PacketSchema<LogiCommands::SetLightingForKeyWithQuartzCode, int, unsigned char, unsigned char, unsigned char> SetLightingForKeyWithQuartzCodePacket;
+typedef PacketSchema<LogiCommands::SetLightingForKeyWithKeyName, LogiLed::KeyName, unsigned char, unsigned char, unsigned char> SetLightingForKeyWithKeyNamePacket;
+typedef PacketSchema<LogiCommands::SetLightingForTargetZone, LogiLed::DeviceType, int, unsigned char, unsigned char, unsigned char> SetLightingForTargetZonePacket;
+
+//The host decodes these byte for byte, so the 32 and 64 bit builds must agree on every one of them.
+static_assert(sizeof(int) == 4, "Field sizes differ from what the host expects");
+static_assert(sizeof(LogiLed::KeyName) == 4 && sizeof(LogiLed::DeviceType) == 4, "Enum fields must be 4 bytes");
+static_assert(SetTargetDevicePacket::payloadSize == 4, "SetTargetDevice layout changed");
+static_assert(SetLightingPacket::payloadSize == 3, "SetLighting layout changed");
+static_assert(SetLightingForKeyWithScanCodePacket::payloadSize == 7, "SetLightingForKeyWithScanCode layout changed");
+static_assert(SetLightingForKeyWithHidCodePacket::payloadSize == 7, "SetLightingForKeyWithHidCode layout changed");
+static_assert(SetLightingForKeyWithQuartzCodePacket::payloadSize == 7, "SetLightingForKeyWithQuartzCode layout changed");
+static_assert(SetLightingForKeyWithKeyNamePacket::payloadSize == 7, "SetLightingForKeyWithKeyName layout changed");
+static_assert(SetLightingForTargetZonePacket::payloadSize == 11, "SetLightingForTargetZone layout changed");
\ No newline at end of file
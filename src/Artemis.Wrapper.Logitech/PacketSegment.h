@@ -0,0 +1,8 @@
+#pragma once
+
+//One piece of a packet payload. The client gathers segments straight into a queue slot
+//or the shared memory ring, so callers never stage the whole packet in a buffer of their own.
+struct PacketSegment {
+	const void* data;
+	unsigned int length;
+};
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "Platform.h"
+#include <cstdlib>
+
+#ifdef _WIN32
+unsigned long long GetTickMs()
+{
+	return GetTickCount64();
+}
+
+long long GetTimestamp()
+{
+	LARGE_INTEGER timestamp;
+	QueryPerformanceCounter(&timestamp);
+	return timestamp.QuadPart;
+}
+
+unsigned int GetProcessIdentifier()
+{
+	return GetCurrentProcessId();
+}
+
+int CompareIgnoreCase(const char* left, const char* right)
+{
+	return _stricmp(left, right);
+}
+
+std::string GetEnvironmentString(const char* name)
+{
+	//the first call returns the size including the terminator, the second the length without it
+	DWORD size = GetEnvironmentVariableA(name, NULL, 0);
+	while (size != 0) {
+		std::string value(size, '\0');
+		DWORD length = GetEnvironmentVariableA(name, &value[0], size);
+		if (length < size) {
+			value.resize(length);
+			return value;
+		}
+		//the variable grew in between
+		size = length;
+	}
+	return std::string();
+}
+#else
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+unsigned long long GetTickMs()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+long long GetTimestamp()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+unsigned int GetProcessIdentifier()
+{
+	return (unsigned int)getpid();
+}
+
+int CompareIgnoreCase(const char* left, const char* right)
+{
+	return strcasecmp(left, right);
+}
+
+std::string GetEnvironmentString(const char* name)
+{
+	const char* value = getenv(name);
+	return value != nullptr ? std::string(value) : std::string();
+}
+#endif
+
+int GetEnvironmentInt(const char* name, int defaultValue)
+{
+	std::string value = GetEnvironmentString(name);
+	if (value.empty()) return defaultValue;
+	return atoi(value.c_str());
+}
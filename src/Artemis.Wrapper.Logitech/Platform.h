@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+//The few OS services the client core needs, so it builds without windows.h.
+//Everything Windows specific beyond these lives with the transports and the dll itself.
+
+//monotonic milliseconds, GetTickCount64 on Windows
+unsigned long long GetTickMs();
+//stamped into packet headers. QueryPerformanceCounter on Windows and CLOCK_MONOTONIC nanoseconds
+//elsewhere, which is what the host's Stopwatch.GetTimestamp compares them against
+long long GetTimestamp();
+unsigned int GetProcessIdentifier();
+//case insensitive like program names on Windows, 0 when equal
+int CompareIgnoreCase(const char* left, const char* right);
+
+std::string GetEnvironmentString(const char* name);
+int GetEnvironmentInt(const char* name, int defaultValue);
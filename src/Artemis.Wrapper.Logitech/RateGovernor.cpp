@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "RateGovernor.h"
+#include "Constants.h"
+#include "Logger.h"
+#include "Platform.h"
+#include <limits.h>
+#include <stdlib.h>
+
+static SteadyEffectClock steadyClock;
+
+RateGovernor::RateGovernor() : _clock(steadyClock)
+{
+}
+
+RateGovernor::RateGovernor(EffectClock& clock) : _clock(clock)
+{
+}
+
+void RateGovernor::SetBudget(RateBudget budget)
+{
+	_budget = budget;
+
+	//programs start with a full second of budget
+	_packetTokens = (unsigned long long)budget.packetsPerSecond * 1000;
+	_byteTokens = (unsigned long long)budget.bytesPerSecond * 1000;
+	_refillMs = _clock.NowMs();
+}
+
+RateBudget RateGovernor::GetBudget()
+{
+	return _budget;
+}
+
+void RateGovernor::Refill()
+{
+	const unsigned long long nowMs = _clock.NowMs();
+	const unsigned long long elapsedMs = nowMs - _refillMs;
+	if (elapsedMs == 0) {
+		return;
+	}
+	_refillMs = nowMs;
+
+	//tokens are thousandths, so a budget per second refills by itself per millisecond
+	const unsigned long long packetLimit = (unsigned long long)_budget.packetsPerSecond * 1000;
+	const unsigned long long byteLimit = (unsigned long long)_budget.bytesPerSecond * 1000;
+	_packetTokens += elapsedMs * _budget.packetsPerSecond;
+	_byteTokens += elapsedMs * _budget.bytesPerSecond;
+	if (_packetTokens > packetLimit) {
+		_packetTokens = packetLimit;
+	}
+	if (_byteTokens > byteLimit) {
+		_byteTokens = byteLimit;
+	}
+}
+
+bool RateGovernor::TryConsume(unsigned int bytes)
+{
+	Refill();
+
+	const unsigned long long packetCost = _budget.packetsPerSecond == 0 ? 0 : 1000;
+	const unsigned long long byteCost = _budget.bytesPerSecond == 0 ? 0 : (unsigned long long)bytes * 1000;
+	if (_packetTokens < packetCost || _byteTokens < byteCost) {
+		return false;
+	}
+
+	_packetTokens -= packetCost;
+	_byteTokens -= byteCost;
+	return true;
+}
+
+void RateGovernor::Consume(unsigned int bytes)
+{
+	Refill();
+
+	const unsigned long long packetCost = _budget.packetsPerSecond == 0 ? 0 : 1000;
+	const unsigned long long byteCost = _budget.bytesPerSecond == 0 ? 0 : (unsigned long long)bytes * 1000;
+	_packetTokens = _packetTokens > packetCost ? _packetTokens - packetCost : 0;
+	_byteTokens = _byteTokens > byteCost ? _byteTokens - byteCost : 0;
+}
+
+bool RateGovernor::HasReserve(unsigned int ms)
+{
+	Refill();
+
+	return
+		_packetTokens >= (unsigned long long)_budget.packetsPerSecond * ms &&
+		_byteTokens >= (unsigned long long)_budget.bytesPerSecond * ms;
+}
+
+bool RateGovernor::ParseCount(const std::string& text, unsigned int& count)
+{
+	//strtoul alone would read "abc" as 0, which is unlimited
+	if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+
+	const unsigned long long value = strtoull(text.c_str(), nullptr, 10);
+	if (value > UINT_MAX) {
+		return false;
+	}
+	count = (unsigned int)value;
+	return true;
+}
+
+RateBudget RateGovernor::ParseBudget(const std::string& config, const std::string& programName)
+{
+	RateBudget budget = { DEFAULT_RATE_BUDGET_PACKETS, DEFAULT_RATE_BUDGET_BYTES };
+	bool matchedProgram = false;
+
+	size_t entryStart = 0;
+	while (entryStart < config.length()) {
+		size_t entryEnd = config.find(';', entryStart);
+		if (entryEnd == std::string::npos) {
+			entryEnd = config.length();
+		}
+		const std::string entry = config.substr(entryStart, entryEnd - entryStart);
+		entryStart = entryEnd + 1;
+		if (entry.empty()) {
+			continue;
+		}
+
+		std::string program;
+		std::string counts = entry;
+		const size_t equals = entry.find('=');
+		if (equals != std::string::npos) {
+			program = entry.substr(0, equals);
+			counts = entry.substr(equals + 1);
+		}
+
+		RateBudget entryBudget;
+		const size_t colon = counts.find(':');
+		if ((equals != std::string::npos && program.empty()) || colon == std::string::npos ||
+			!ParseCount(counts.substr(0, colon), entryBudget.packetsPerSecond) ||
+			!ParseCount(counts.substr(colon + 1), entryBudget.bytesPerSecond)) {
+			LOG(fmt::format("Ignoring malformed rate budget entry \'{}\'", entry));
+			continue;
+		}
+
+		//a program's own entry wins over the default, wherever either one is
+		if (!program.empty()) {
+			if (CompareIgnoreCase(program.c_str(), programName.c_str()) != 0) {
+				continue;
+			}
+			matchedProgram = true;
+		}
+		else if (matchedProgram) {
+			continue;
+		}
+
+		budget = entryBudget;
+	}
+
+	return budget;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "EffectEngine.h"
+#include <string>
+
+//Packets and bytes a program may send per second, 0 leaves that side unlimited.
+struct RateBudget {
+	unsigned int packetsPerSecond;
+	unsigned int bytesPerSecond;
+};
+
+//Token buckets for packets and bytes, each holding up to one second of its budget.
+//Not thread safe, the pipe client only uses it while its queue is locked.
+//Time comes from an EffectClock, a VirtualEffectClock lets tests refill the buckets by hand.
+class RateGovernor
+{
+private:
+	EffectClock& _clock;
+	RateBudget _budget = {};
+	//in thousandths of a token, so a millisecond of refill is never lost to rounding
+	unsigned long long _packetTokens = 0;
+	unsigned long long _byteTokens = 0;
+	unsigned long long _refillMs = 0;
+
+	void Refill();
+	//false unless the text is a plain decimal number that fits
+	static bool ParseCount(const std::string& text, unsigned int& count);
+public:
+	RateGovernor();
+	explicit RateGovernor(EffectClock& clock);
+
+	void SetBudget(RateBudget budget);
+	RateBudget GetBudget();
+
+	//false when either bucket can't cover the packet, nothing is taken then
+	bool TryConsume(unsigned int bytes);
+	//for packets that have to go out regardless, the buckets bottom out at empty
+	void Consume(unsigned int bytes);
+	//true once both buckets hold at least this many milliseconds of budget
+	bool HasReserve(unsigned int ms);
+
+	//entries are [program=]packets:bytes separated by ';', the entry without a program is the default.
+	//malformed entries are skipped, they never turn into an unlimited budget
+	static RateBudget ParseBudget(const std::string& config, const std::string& programName);
+};
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include "pch.h"
+#include "SharedMemoryRing.h"
+#include "Constants.h"
+#include "Logger.h"
+#include "Platform.h"
+#include <chrono>
+#include <thread>
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+	Close();
+}
+
+#ifdef _WIN32
+#include "Utils.h"
+
+bool SharedMemoryRing::Create(const std::string& name, unsigned int capacity)
+{
+	Close();
+
+	std::wstring wideName = utf8_decode(name);
+	_mapping = CreateFileMappingW(
+		INVALID_HANDLE_VALUE,
+		NULL,
+		PAGE_READWRITE,
+		0,
+		sizeof(SharedMemoryRingHeader) + capacity,
+		wideName.c_str());
+	if (_mapping == NULL) {
+		LOG(fmt::format("Failed to create shared memory \'{}\'. Error: {}", name, GetLastError()));
+		return false;
+	}
+
+	unsigned char* view = (unsigned char*)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	_event = CreateEventW(NULL, FALSE, FALSE, (wideName + utf8_decode(SHARED_MEMORY_EVENT_SUFFIX)).c_str());
+	if (view == NULL || _event == NULL) {
+		LOG(fmt::format("Failed to map shared memory \'{}\'. Error: {}", name, GetLastError()));
+		Close();
+		return false;
+	}
+
+	_header = (SharedMemoryRingHeader*)view;
+	_data = view + sizeof(SharedMemoryRingHeader);
+	_capacity = capacity;
+	_name = name;
+
+	_header->capacity = capacity;
+	_header->writeIndex.store(0);
+	_header->readIndex.store(0);
+	_header->magic = SHARED_MEMORY_RING_MAGIC;
+	_lastReadIndex = 0;
+	_readProgressTick = GetTickMs();
+
+	LOG(fmt::format("Created shared memory ring \'{}\' of {} bytes", name, capacity));
+	return true;
+}
+
+void SharedMemoryRing::Close()
+{
+	if (_header != NULL) {
+		UnmapViewOfFile(_header);
+	}
+	if (_event != NULL) {
+		CloseHandle(_event);
+	}
+	if (_mapping != NULL) {
+		CloseHandle(_mapping);
+	}
+	_header = NULL;
+	_data = NULL;
+	_event = NULL;
+	_mapping = NULL;
+	_capacity = 0;
+}
+
+static void SignalHost(void* event)
+{
+	SetEvent(event);
+}
+#elif defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+bool SharedMemoryRing::Create(const std::string& name, unsigned int capacity)
+{
+	Close();
+
+	const size_t size = sizeof(SharedMemoryRingHeader) + capacity;
+	int descriptor = shm_open(name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+	if (descriptor < 0) {
+		LOG(fmt::format("Failed to create shared memory \'{}\'. Error: {}", name, errno));
+		return false;
+	}
+
+	//the mapping keeps the memory alive, the descriptor isn't needed once it is made
+	void* view = ftruncate(descriptor, size) == 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+	close(descriptor);
+	_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (view == MAP_FAILED || _event < 0) {
+		LOG(fmt::format("Failed to map shared memory \'{}\'. Error: {}", name, errno));
+		if (view != MAP_FAILED) {
+			munmap(view, size);
+		}
+		shm_unlink(name.c_str());
+		Close();
+		return false;
+	}
+
+	_header = (SharedMemoryRingHeader*)view;
+	_data = (unsigned char*)view + sizeof(SharedMemoryRingHeader);
+	_capacity = capacity;
+	_name = name;
+
+	_header->capacity = capacity;
+	_header->writeIndex.store(0);
+	_header->readIndex.store(0);
+	_header->magic = SHARED_MEMORY_RING_MAGIC;
+	_lastReadIndex = 0;
+	_readProgressTick = GetTickMs();
+
+	LOG(fmt::format("Created shared memory ring \'{}\' of {} bytes", name, capacity));
+	return true;
+}
+
+void SharedMemoryRing::Close()
+{
+	if (_header != NULL) {
+		munmap(_header, sizeof(SharedMemoryRingHeader) + _capacity);
+		//unlike a file mapping the name outlives every mapping, the host keeps its own until it detaches
+		shm_unlink(_name.c_str());
+	}
+	if (_event >= 0) {
+		close(_event);
+	}
+	_header = NULL;
+	_data = NULL;
+	_event = -1;
+	_capacity = 0;
+}
+
+static void SignalHost(int event)
+{
+	//the counter only fills up for a host that never reads it, IsStalled catches that one
+	const uint64_t one = 1;
+	const ssize_t written = write(event, &one, sizeof(one));
+	(void)written;
+}
+#else
+bool SharedMemoryRing::Create(const std::string& name, unsigned int capacity)
+{
+	LOG(fmt::format("Shared memory '{}' needs Windows or Linux", name));
+	return false;
+}
+
+void SharedMemoryRing::Close()
+{
+}
+
+static void SignalHost(int)
+{
+}
+#endif
+
+bool SharedMemoryRing::IsOpen()
+{
+	return _header != NULL;
+}
+
+bool SharedMemoryRing::Write(const PacketSegment segments[], unsigned int segmentCount)
+{
+	unsigned int length = 0;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		length += segments[i].length;
+	}
+
+	unsigned int write = _header->writeIndex.load(std::memory_order_relaxed);
+	unsigned int read = _header->readIndex.load(std::memory_order_acquire);
+	if (_capacity - (write - read) < length) {
+		return false;
+	}
+
+	unsigned int position = write;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		CopyIn(position, (const unsigned char*)segments[i].data, segments[i].length);
+		position += segments[i].length;
+	}
+
+	_header->writeIndex.store(write + length);
+
+	//if the host had caught up with us it is waiting on the event, otherwise it will see the new packet on its own
+	if (_header->readIndex.load() == write) {
+		SignalHost(_event);
+	}
+	return true;
+}
+
+void SharedMemoryRing::CopyIn(unsigned int index, const unsigned char* data, unsigned int length)
+{
+	unsigned int position = index & (_capacity - 1);
+	unsigned int firstPart = length < _capacity - position ? length : _capacity - position;
+	memcpy(_data + position, data, firstPart);
+	memcpy(_data, data + firstPart, length - firstPart);
+}
+
+bool SharedMemoryRing::WaitUntilEmpty(unsigned int timeoutMs)
+{
+	unsigned long long deadline = GetTickMs() + timeoutMs;
+	while (_header->readIndex.load() != _header->writeIndex.load()) {
+		if (GetTickMs() >= deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+bool SharedMemoryRing::IsStalled(unsigned int timeoutMs)
+{
+	const unsigned int read = _header->readIndex.load();
+	const unsigned long long now = GetTickMs();
+
+	//an empty ring or one the host is working through is fine however long ago it was written
+	if (read != _lastReadIndex || read == _header->writeIndex.load()) {
+		_lastReadIndex = read;
+		_readProgressTick = now;
+		return false;
+	}
+	return now - _readProgressTick >= timeoutMs;
+}
+
+const std::string& SharedMemoryRing::GetName()
+{
+	return _name;
+}
+
+#ifndef _WIN32
+int SharedMemoryRing::GetEventDescriptor()
+{
+	return _event;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include "PacketSegment.h"
+#include <atomic>
+#include <string>
+
+//Layout shared with the host, offsets are fixed so both bitnesses and the C# reader agree.
+struct SharedMemoryRingHeader {
+	unsigned int magic;
+	unsigned int capacity;
+	unsigned char padding0[56];
+	std::atomic<unsigned int> writeIndex;
+	unsigned char padding1[60];
+	std::atomic<unsigned int> readIndex;
+	unsigned char padding2[60];
+};
+static_assert(sizeof(SharedMemoryRingHeader) == 192, "Shared memory ring header layout changed");
+
+//Single producer / single consumer ring of framed packets in a named file mapping.
+//The host is only signalled when it may have drained the ring and gone to sleep.
+//On Linux the ring is POSIX shared memory and the signal an eventfd, which has no name a host could
+//open it by, so no transport offers it there and only the tests map it.
+//Nothing on the pipe tells a dead host apart from an idle one while the ring is in use,
+//so the writer asks IsStalled whether packets are left unread.
+class SharedMemoryRing
+{
+private:
+#ifdef _WIN32
+	//a file mapping and an auto reset event, kept as void* so the header builds without windows.h
+	void* _mapping = nullptr;
+	void* _event = nullptr;
+#else
+	int _event = -1;
+#endif
+	SharedMemoryRingHeader* _header = nullptr;
+	unsigned char* _data = nullptr;
+	unsigned int _capacity = 0;
+	std::string _name;
+	//where the host was reading the last time IsStalled looked, and since when
+	unsigned int _lastReadIndex = 0;
+	unsigned long long _readProgressTick = 0;
+
+	void CopyIn(unsigned int index, const unsigned char* data, unsigned int length);
+public:
+	~SharedMemoryRing();
+
+	bool Create(const std::string& name, unsigned int capacity);
+	void Close();
+	bool IsOpen();
+	//the segments are written back to back as one packet
+	bool Write(const PacketSegment segments[], unsigned int segmentCount);
+	bool WaitUntilEmpty(unsigned int timeoutMs);
+	//true once packets have waited timeoutMs without the host reading any of them, checked by the writer
+	bool IsStalled(unsigned int timeoutMs);
+	const std::string& GetName();
+#ifndef _WIN32
+	//the host is handed a duplicate, over SCM_RIGHTS or a fork
+	int GetEventDescriptor();
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "Transport.h"
+#include "Constants.h"
+#include "Logger.h"
+#include "LogiCommands.h"
+#include "UnixSocketTransport.h"
+#ifdef _WIN32
+#include "NamedPipeTransport.h"
+#endif
+
+std::unique_ptr<Transport> Transport::Create(const std::string& name)
+{
+	if (name == "unix") {
+		return std::unique_ptr<Transport>(new UnixSocketTransport());
+	}
+	if (name == "loopback") {
+		return std::unique_ptr<Transport>(new LoopbackTransport());
+	}
+#ifdef _WIN32
+	if (!name.empty() && name != "pipe") {
+		LOG(fmt::format("Unknown transport \'{}\', using the named pipe", name));
+	}
+	return std::unique_ptr<Transport>(new NamedPipeTransport());
+#else
+	//named pipes are Windows only
+	if (!name.empty()) {
+		LOG(fmt::format("Unknown transport \'{}\', using the unix socket", name));
+	}
+	return std::unique_ptr<Transport>(new UnixSocketTransport());
+#endif
+}
+
+bool Transport::WriteWithin(const void* data, unsigned int length, unsigned int timeoutMs)
+{
+	WriteStatus status = Write(data, length, timeoutMs);
+	if (status == WriteStatus::Pending) {
+		CancelWrite();
+	}
+	return status == WriteStatus::Written;
+}
+
+#pragma region LoopbackTransport
+const char* LoopbackTransport::GetName()
+{
+	return "loopback";
+}
+
+bool LoopbackTransport::Open()
+{
+	_hasReply = false;
+	return true;
+}
+
+void LoopbackTransport::Close()
+{
+}
+
+Transport::WriteStatus LoopbackTransport::Write(const void* data, unsigned int length, unsigned int timeoutMs)
+{
+	_packets++;
+	_bytes += length;
+
+	unsigned int command;
+	memcpy(&command, (const unsigned char*)data + sizeof(unsigned int), sizeof(command));
+	if (command != LogiCommands::Init || length < sizeof(unsigned int) * 4) {
+		return WriteStatus::Written;
+	}
+
+	//version and features are the last two fields of Init
+	const unsigned int arraySize = INIT_ACK_SIZE;
+	const unsigned int replyCommand = LogiCommands::InitAck;
+	const unsigned int version = PROTOCOL_VERSION;
+	unsigned int features;
+	memcpy(&features, (const unsigned char*)data + length - sizeof(features), sizeof(features));
+	features &= ~FEATURE_SHARED_MEMORY;
+	unsigned int buffPtr = 0;
+
+	memcpy(&_reply[buffPtr], &arraySize, sizeof(arraySize));
+	buffPtr += sizeof(arraySize);
+
+	memcpy(&_reply[buffPtr], &replyCommand, sizeof(replyCommand));
+	buffPtr += sizeof(replyCommand);
+
+	memcpy(&_reply[buffPtr], &version, sizeof(version));
+	buffPtr += sizeof(version);
+
+	memcpy(&_reply[buffPtr], &features, sizeof(features));
+	buffPtr += sizeof(features);
+
+	_hasReply = true;
+	return WriteStatus::Written;
+}
+
+bool LoopbackTransport::Read(void* buffer, unsigned int length, unsigned int timeoutMs)
+{
+	if (!_hasReply || length != INIT_ACK_SIZE) {
+		return false;
+	}
+
+	memcpy(buffer, _reply, length);
+	_hasReply = false;
+	return true;
+}
+
+unsigned long long LoopbackTransport::GetPackets()
+{
+	return _packets;
+}
+
+unsigned long long LoopbackTransport::GetBytes()
+{
+	return _bytes;
+}
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include "Constants.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+//Byte stream to the host. Open, Write and Close are only called from one thread at a time.
+//Only standard types here, so the client core builds and can be load tested without windows.h.
+class Transport
+{
+public:
+	enum class WriteStatus { Written, Pending, Failed };
+
+	virtual ~Transport() {}
+
+	virtual const char* GetName() = 0;
+	virtual bool Open() = 0;
+	virtual void Close() = 0;
+	//waits up to timeoutMs for the whole packet to be written, Failed means the connection is gone.
+	//Pending leaves the write in flight with data still in use, it has to be waited on or canceled
+	//before anything else is written.
+	virtual WriteStatus Write(const void* data, unsigned int length, unsigned int timeoutMs) = 0;
+	virtual WriteStatus WaitForWrite(unsigned int timeoutMs) { return WriteStatus::Written; }
+	//gives up on a pending write, part of it may have gone out so the connection has to be closed
+	virtual void CancelWrite() {}
+	//false unless the packet was written in time, a write that is still pending is canceled
+	bool WriteWithin(const void* data, unsigned int length, unsigned int timeoutMs);
+	//reads exactly length bytes, only used for the handshake
+	virtual bool Read(void* buffer, unsigned int length, unsigned int timeoutMs) = 0;
+	//hosts from before the handshake only accept write-only pipe clients
+	virtual bool IsDuplex() { return true; }
+	//shared memory needs a host on the other side to drain it
+	virtual bool CanAttachSharedMemory() { return true; }
+
+	//"pipe" (default on Windows), "unix" (default elsewhere) or "loopback"
+	static std::unique_ptr<Transport> Create(const std::string& name);
+};
+
+//Swallows every packet without a syscall, to measure the client on its own.
+//It answers the handshake like a current host would, minus shared memory.
+class LoopbackTransport : public Transport
+{
+private:
+	//read by whoever measures the client while the sender thread writes
+	std::atomic<unsigned long long> _packets{ 0 };
+	std::atomic<unsigned long long> _bytes{ 0 };
+	unsigned char _reply[INIT_ACK_SIZE];
+	bool _hasReply = false;
+public:
+	const char* GetName() override;
+	bool Open() override;
+	void Close() override;
+	WriteStatus Write(const void* data, unsigned int length, unsigned int timeoutMs) override;
+	bool Read(void* buffer, unsigned int length, unsigned int timeoutMs) override;
+	bool CanAttachSharedMemory() override { return false; }
+
+	//every write counts once, a Batch envelope is one packet here
+	unsigned long long GetPackets();
+	unsigned long long GetBytes();
+};
@@ -0,0 +1,275 @@
+#include "pch.h"
+#include "UnixSocketTransport.h"
+#include "Constants.h"
+#include "Logger.h"
+#include "Platform.h"
+
+const char* UnixSocketTransport::GetName()
+{
+	return "unix";
+}
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+UnixSocketTransport::UnixSocketTransport() : _socket(INVALID_SOCKET), _overlapped(new OVERLAPPED())
+{
+}
+
+UnixSocketTransport::~UnixSocketTransport()
+{
+	Close();
+	if (_event != NULL) {
+		WSACloseEvent(_event);
+	}
+	if (_winsockStarted) {
+		WSACleanup();
+	}
+	delete _overlapped;
+}
+
+bool UnixSocketTransport::Open()
+{
+	if (!_winsockStarted) {
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+			LOG("Failed to start winsock");
+			return false;
+		}
+		_winsockStarted = true;
+	}
+
+	if (_event == NULL) {
+		_event = WSACreateEvent();
+		if (_event == WSA_INVALID_EVENT) {
+			_event = NULL;
+			LOG(fmt::format("Failed to create the socket write event. Error: {}", WSAGetLastError()));
+			return false;
+		}
+	}
+
+	//the host listens next to its other data, under %ProgramData%\Artemis
+	std::string path = GetEnvironmentString("ProgramData") + UNIX_SOCKET_RELATIVE_PATH;
+	sockaddr_un address = { 0 };
+	address.sun_family = AF_UNIX;
+	if (path.length() >= sizeof(address.sun_path)) {
+		LOG(fmt::format("Socket path \'{}\' is too long", path));
+		return false;
+	}
+	memcpy(address.sun_path, path.c_str(), path.length());
+
+	SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s == INVALID_SOCKET) {
+		LOG(fmt::format("Failed to create unix socket. Error: {}", WSAGetLastError()));
+		return false;
+	}
+
+	if (connect(s, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR) {
+		closesocket(s);
+		return false;
+	}
+
+	_socket = s;
+	return true;
+}
+
+void UnixSocketTransport::Close()
+{
+	if (_socket != INVALID_SOCKET) {
+		closesocket((SOCKET)_socket);
+	}
+	_socket = INVALID_SOCKET;
+}
+
+Transport::WriteStatus UnixSocketTransport::Write(const void* data, unsigned int length, unsigned int timeoutMs)
+{
+	memset(_overlapped, 0, sizeof(OVERLAPPED));
+	_overlapped->hEvent = _event;
+	_writeLength = length;
+	WSAResetEvent(_event);
+
+	WSABUF buffer;
+	buffer.len = length;
+	buffer.buf = (char*)data;
+	if (WSASend((SOCKET)_socket, &buffer, 1, NULL, 0, _overlapped, NULL) == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
+		LOG(fmt::format("Error writing to socket: \'{}\'. Wrote 0 bytes out of {}", WSAGetLastError(), length));
+		return WriteStatus::Failed;
+	}
+	return WaitForWrite(timeoutMs);
+}
+
+Transport::WriteStatus UnixSocketTransport::WaitForWrite(unsigned int timeoutMs)
+{
+	if (WSAWaitForMultipleEvents(1, &_event, TRUE, timeoutMs, FALSE) == WSA_WAIT_TIMEOUT) {
+		return WriteStatus::Pending;
+	}
+
+	DWORD sent = 0;
+	DWORD flags = 0;
+	if (!WSAGetOverlappedResult((SOCKET)_socket, _overlapped, &sent, FALSE, &flags) || sent < _writeLength) {
+		LOG(fmt::format("Error writing to socket: \'{}\'. Wrote {} bytes out of {}", WSAGetLastError(), sent, _writeLength));
+		return WriteStatus::Failed;
+	}
+	return WriteStatus::Written;
+}
+
+void UnixSocketTransport::CancelWrite()
+{
+	DWORD sent = 0;
+	DWORD flags = 0;
+	CancelIoEx((HANDLE)_socket, _overlapped);
+	WSAGetOverlappedResult((SOCKET)_socket, _overlapped, &sent, TRUE, &flags);
+}
+
+bool UnixSocketTransport::Read(void* buffer, unsigned int length, unsigned int timeoutMs)
+{
+	DWORD timeout = timeoutMs;
+	setsockopt((SOCKET)_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+	char* buffPtr = (char*)buffer;
+	DWORD remaining = length;
+	while (remaining > 0) {
+		int received = recv((SOCKET)_socket, buffPtr, (int)remaining, 0);
+		if (received <= 0) {
+			return false;
+		}
+		buffPtr += received;
+		remaining -= received;
+	}
+	return true;
+}
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+UnixSocketTransport::UnixSocketTransport()
+{
+}
+
+UnixSocketTransport::~UnixSocketTransport()
+{
+	Close();
+}
+
+bool UnixSocketTransport::Open()
+{
+	//where .NET puts CommonApplicationData for the host outside Windows
+	const std::string path = UNIX_SOCKET_POSIX_PATH;
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.length() >= sizeof(address.sun_path)) {
+		LOG(fmt::format("Socket path \'{}\' is too long", path));
+		return false;
+	}
+	memcpy(address.sun_path, path.c_str(), path.length());
+
+	int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (s < 0) {
+		LOG(fmt::format("Failed to create unix socket. Error: {}", errno));
+		return false;
+	}
+
+	if (connect(s, (sockaddr*)&address, sizeof(address)) != 0) {
+		close(s);
+		return false;
+	}
+
+	//writes and the handshake read wait in poll, never in the socket call itself
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+	_socket = s;
+	return true;
+}
+
+void UnixSocketTransport::Close()
+{
+	if (_socket >= 0) {
+		close(_socket);
+	}
+	_socket = -1;
+	_pending = nullptr;
+	_pendingLength = 0;
+}
+
+//waits for the socket until the deadline, false once it has passed
+static bool PollUntil(int socket, short events, unsigned long long deadline)
+{
+	const unsigned long long now = GetTickMs();
+	if (now >= deadline) {
+		return false;
+	}
+
+	pollfd descriptor = { socket, events, 0 };
+	return poll(&descriptor, 1, (int)(deadline - now)) >= 0 || errno == EINTR;
+}
+
+Transport::WriteStatus UnixSocketTransport::Write(const void* data, unsigned int length, unsigned int timeoutMs)
+{
+	_pending = (const unsigned char*)data;
+	_pendingLength = length;
+	_writeLength = length;
+	return WaitForWrite(timeoutMs);
+}
+
+Transport::WriteStatus UnixSocketTransport::WaitForWrite(unsigned int timeoutMs)
+{
+	const unsigned long long deadline = GetTickMs() + timeoutMs;
+	while (_pendingLength > 0) {
+		//a host that went away must not raise SIGPIPE in the game
+		const ssize_t sent = send(_socket, _pending, _pendingLength, MSG_NOSIGNAL);
+		if (sent > 0) {
+			_pending += sent;
+			_pendingLength -= (unsigned int)sent;
+			continue;
+		}
+
+		if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			LOG(fmt::format("Error writing to socket: \'{}\'. Wrote {} bytes out of {}", errno, _writeLength - _pendingLength, _writeLength));
+			return WriteStatus::Failed;
+		}
+
+		if (!PollUntil(_socket, POLLOUT, deadline)) {
+			return WriteStatus::Pending;
+		}
+	}
+	return WriteStatus::Written;
+}
+
+void UnixSocketTransport::CancelWrite()
+{
+	//send copies into the socket buffer, the caller's data is free as soon as we stop
+	_pending = nullptr;
+	_pendingLength = 0;
+}
+
+bool UnixSocketTransport::Read(void* buffer, unsigned int length, unsigned int timeoutMs)
+{
+	const unsigned long long deadline = GetTickMs() + timeoutMs;
+	char* buffPtr = (char*)buffer;
+	unsigned int remaining = length;
+	while (remaining > 0) {
+		const ssize_t received = recv(_socket, buffPtr, remaining, 0);
+		if (received > 0) {
+			buffPtr += received;
+			remaining -= (unsigned int)received;
+			continue;
+		}
+
+		//0 is the host closing the socket
+		if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+			return false;
+		}
+
+		if (!PollUntil(_socket, POLLIN, deadline)) {
+			return false;
+		}
+	}
+	return true;
+}
+#endif
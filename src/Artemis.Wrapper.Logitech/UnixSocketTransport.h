@@ -0,0 +1,36 @@
+#pragma once
+#include "Transport.h"
+
+//AF_UNIX stream socket to the host. Windows 10 has these through winsock, elsewhere it is a plain POSIX socket.
+class UnixSocketTransport : public Transport
+{
+private:
+#ifdef _WIN32
+	unsigned long long _socket;
+	bool _winsockStarted = false;
+	//a WSAEVENT and a WSAOVERLAPPED, left opaque so this header builds without winsock
+	void* _event = nullptr;
+	struct _OVERLAPPED* _overlapped = nullptr;
+#else
+	int _socket = -1;
+	//the rest of a write that timed out, sent by WaitForWrite
+	const unsigned char* _pending = nullptr;
+	unsigned int _pendingLength = 0;
+#endif
+	unsigned int _writeLength = 0;
+public:
+	UnixSocketTransport();
+	~UnixSocketTransport();
+
+	const char* GetName() override;
+	bool Open() override;
+	void Close() override;
+	WriteStatus Write(const void* data, unsigned int length, unsigned int timeoutMs) override;
+	WriteStatus WaitForWrite(unsigned int timeoutMs) override;
+	void CancelWrite() override;
+	bool Read(void* buffer, unsigned int length, unsigned int timeoutMs) override;
+#ifndef _WIN32
+	//a host outside Windows can't open the ring by name, see SharedMemoryRing
+	bool CanAttachSharedMemory() override { return false; }
+#endif
+};
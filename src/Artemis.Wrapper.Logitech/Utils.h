@@ -1,6 +1,8 @@
 #pragma once
 #include "pch.h"
+#include "Platform.h"
 #include<string>
+#include<cstdlib>
 
 //https://stackoverflow.com/questions/215963
 inline std::string utf8_encode(const std::wstring& wstr)
@@ -35,4 +37,4 @@ inline std::string GetCallerPath()
 	int bytes = GetModuleFileNameW(NULL, filenameBuffer, MAX_PATH);
 
 	return trim(utf8_encode(filenameBuffer));
-}
\ No newline at end of file
+}
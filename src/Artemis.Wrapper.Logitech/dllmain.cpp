@@ -9,16 +9,473 @@
 #include "Utils.h"
 #include "OriginalDllWrapper.h"
 #include "ArtemisPipeClient.h"
+#include "FrameCoalescer.h"
+#include "EffectEngine.h"
+#include "LightingState.h"
+#include "PacketCodec.h"
+#include "Failover.h"
+#include "OriginalDllTee.h"
+#include "ClientStartup.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <string>
-#include <vector>
 
 #pragma region Static variables
 static OriginalDllWrapper originalDllWrapper;
 static ArtemisPipeClient artemisPipeClient;
+static FrameCoalescer frameCoalescer(artemisPipeClient);
 static bool isInitialized = false;
 static std::string program_name = "";
+
+//where lighting goes, Init picks it in the background
+enum class LightingSink {
+	None,
+	Pending,
+	Artemis,
+	Original,
+};
+static std::atomic<LightingSink> lightingSink{ LightingSink::None };
+static std::mutex lightingSinkMutex;
+static std::condition_variable lightingSinkCondition;
+//set by Shutdown, a resolver that hasn't found the host gives up instead of loading the original dll
+static std::atomic<bool> resolveCancelled{ false };
+//when Init handed resolving to the background, only for the log
+static ULONGLONG resolveStartTick = 0;
+
+static void ReplayCurrentLighting();
+static Failover failover(originalDllWrapper, ReplayCurrentLighting);
+static void ResyncTee();
+static OriginalDllTee originalDllTee(originalDllWrapper, ResyncTee);
 #pragma endregion
 
+//Every packet goes through here so pending per-key updates are never reordered after it.
+static void WritePacket(unsigned int command, const PacketSegment segments[], unsigned int segmentCount)
+{
+	frameCoalescer.Flush();
+	artemisPipeClient.Write(command, segments, segmentCount);
+}
+
+template <typename Schema, typename... Fields>
+static void WritePacket(Fields... fields)
+{
+	typename Schema::Payload payload;
+	PacketSegment segment = Schema::Encode(payload, fields...);
+	WritePacket(Schema::command, &segment, 1);
+}
+
+//Per-key colors are coalesced into frames when the host supports them and sent one by one otherwise.
+static void WriteKey(unsigned int command, int keyCode, EffectColor color)
+{
+	originalDllTee.SetKey(command, keyCode, color);
+	if (Failover::OriginalCall original{ failover }) {
+		originalDllWrapper.SetLightingForKey(command, keyCode, ByteToPercent(color.red), ByteToPercent(color.green), ByteToPercent(color.blue));
+		return;
+	}
+
+	if (frameCoalescer.SetKey(command, keyCode, color.red, color.green, color.blue)) {
+		return;
+	}
+
+	switch (command) {
+	case LogiCommands::SetLightingForKeyWithScanCode:
+		WritePacket<SetLightingForKeyWithScanCodePacket>(keyCode, color.red, color.green, color.blue);
+		break;
+	case LogiCommands::SetLightingForKeyWithHidCode:
+		WritePacket<SetLightingForKeyWithHidCodePacket>(keyCode, color.red, color.green, color.blue);
+		break;
+	case LogiCommands::SetLightingForKeyWithQuartzCode:
+		WritePacket<SetLightingForKeyWithQuartzCodePacket>(keyCode, color.red, color.green, color.blue);
+		break;
+	case LogiCommands::SetLightingForKeyWithKeyName:
+		WritePacket<SetLightingForKeyWithKeyNamePacket>((LogiLed::KeyName)keyCode, color.red, color.green, color.blue);
+		break;
+	}
+}
+
+//Zone colors are buffered per device type, zones past MAX_TARGET_ZONES are sent as they come.
+static void WriteZone(LogiLed::DeviceType deviceType, int zone, EffectColor color)
+{
+	originalDllTee.SetZone(deviceType, zone, color);
+	if (Failover::OriginalCall original{ failover }) {
+		originalDllWrapper.LogiLedSetLightingForTargetZone(deviceType, zone, ByteToPercent(color.red), ByteToPercent(color.green), ByteToPercent(color.blue));
+		return;
+	}
+
+	if (!frameCoalescer.SetZone(deviceType, zone, color.red, color.green, color.blue)) {
+		WritePacket<SetLightingForTargetZonePacket>(deviceType, zone, color.red, color.green, color.blue);
+	}
+}
+
+//Background colors are buffered like keys unless the host has to recolor keys with them.
+static void WriteLighting(EffectColor color)
+{
+	originalDllTee.SetLighting(color);
+	if (Failover::OriginalCall original{ failover }) {
+		originalDllWrapper.LogiLedSetLighting(ByteToPercent(color.red), ByteToPercent(color.green), ByteToPercent(color.blue));
+		return;
+	}
+
+	if (!frameCoalescer.SetLighting(color.red, color.green, color.blue)) {
+		WritePacket<SetLightingPacket>(color.red, color.green, color.blue);
+	}
+}
+
+//The coalescer keeps routing by the target on either side.
+static void WriteTargetDevice(int targetDevice)
+{
+	originalDllTee.SetTargetDevice(targetDevice);
+	frameCoalescer.SetTargetDevice(targetDevice);
+	if (Failover::OriginalCall original{ failover }) {
+		originalDllWrapper.LogiLedSetTargetDevice(targetDevice);
+	}
+}
+
+static void WriteBitmap(const unsigned char bitmap[])
+{
+	originalDllTee.SetBitmap(bitmap);
+	if (Failover::OriginalCall original{ failover }) {
+		//the original dll takes a mutable bitmap
+		unsigned char copy[LOGI_LED_BITMAP_SIZE];
+		memcpy(copy, bitmap, LOGI_LED_BITMAP_SIZE);
+		originalDllWrapper.LogiLedSetLightingFromBitmap(copy);
+		return;
+	}
+
+	frameCoalescer.Flush();
+	artemisPipeClient.WriteBitmap(bitmap);
+}
+
+//Per-key calls only reach per-key devices, the SDK ignores them for every other target.
+static bool IsPerKeyTargeted()
+{
+	return frameCoalescer.IsTargeted(LOGI_DEVICETYPE_PERKEY_RGB);
+}
+
+//Effect frames take the same path as the game's own calls.
+class PipeEffectSink : public EffectSink
+{
+public:
+	void SetLighting(EffectColor color) override
+	{
+		WriteLighting(color);
+	}
+
+	void SetKey(LogiLed::KeyName keyName, EffectColor color) override
+	{
+		WriteKey(LogiCommands::SetLightingForKeyWithKeyName, keyName, color);
+	}
+
+	void Flush() override
+	{
+		frameCoalescer.Flush();
+	}
+
+	bool GetKeyColor(LogiLed::KeyName keyName, EffectColor& color) override;
+	void RestoreLighting() override;
+};
+
+static PipeEffectSink effectSink;
+static SteadyEffectClock effectClock;
+static EffectEngine effectEngine(effectSink, effectClock);
+static LightingState lightingState;
+static void OnConnectionChanged(bool connected);
+static void ResyncLighting();
+static void OnFlushTick();
+static ClientStartup clientStartup(artemisPipeClient, frameCoalescer, effectEngine, OnConnectionChanged, ResyncLighting, OnFlushTick);
+
+bool PipeEffectSink::GetKeyColor(LogiLed::KeyName keyName, EffectColor& color)
+{
+	return lightingState.GetKeyColor(keyName, color);
+}
+
+static EffectColor PercentToColor(int redPercentage, int greenPercentage, int bluePercentage)
+{
+	return { PercentToByte(redPercentage), PercentToByte(greenPercentage), PercentToByte(bluePercentage) };
+}
+
+//Sends a snapshot popped by RestoreLighting. A background sent to a per-key target would
+//recolor the keys instead, so the saved target is only set once everything else is out.
+static void ReplayLighting(const LightingState::Snapshot& snapshot)
+{
+	WriteTargetDevice(LOGI_DEVICETYPE_ALL);
+
+	if (snapshot.hasBackground && !effectEngine.SetBaseLighting(snapshot.background)) {
+		WriteLighting(snapshot.background);
+	}
+
+	if (snapshot.hasBitmap) {
+		WriteBitmap(snapshot.bitmap);
+	}
+
+	for (unsigned int i = 0; i < snapshot.keyCount; i++) {
+		WriteKey(snapshot.keys[i].command, snapshot.keys[i].keyCode, snapshot.keys[i].color);
+	}
+
+	//zones don't depend on the target
+	for (unsigned int i = 0; i < snapshot.zoneCount; i++) {
+		WriteZone(snapshot.zones[i].deviceType, snapshot.zones[i].zone, snapshot.zones[i].color);
+	}
+
+	WriteTargetDevice(snapshot.targetDevice);
+}
+
+//An effect on all lighting drew over every key, the game's own state goes back on top.
+//Without a background of its own the devices go back to off, where the effect started from.
+static void ReplayAfterEffect(const LightingState::Snapshot& snapshot)
+{
+	if (!snapshot.hasBackground) {
+		WriteTargetDevice(LOGI_DEVICETYPE_ALL);
+		WriteLighting({});
+	}
+	ReplayLighting(snapshot);
+	frameCoalescer.Flush();
+}
+
+void PipeEffectSink::RestoreLighting()
+{
+	lightingState.Replay(ReplayAfterEffect);
+}
+
+//Called with the state locked, like ReplayToOriginal, so every call the snapshot misses already goes to the original dll.
+static void ActivateFailover(const LightingState::Snapshot& snapshot)
+{
+	if (failover.Activate()) {
+		ReplayLighting(snapshot);
+	}
+}
+
+//Called by the failover once the original dll is initialized, it gets everything the game has set.
+static void ReplayCurrentLighting()
+{
+	lightingState.Replay(ActivateFailover);
+}
+
+static void QueueTeeSnapshot(const LightingState::Snapshot& snapshot)
+{
+	originalDllTee.Replay(snapshot);
+}
+
+//Called by the tee after it dropped calls the original dll couldn't keep up with.
+static void ResyncTee()
+{
+	lightingState.Replay(QueueTeeSnapshot);
+}
+
+static void OnConnectionChanged(bool connected)
+{
+	failover.SetConnected(connected);
+}
+
+//Keys still waiting in the coalescer were set before the snapshot was taken, it replaces them.
+static void WriteSnapshot(const PacketSegment segments[], unsigned int segmentCount)
+{
+	frameCoalescer.Flush();
+	artemisPipeClient.Write(LogiCommands::SetLightingSnapshot, segments, segmentCount);
+}
+
+//The snapshot has no room for zones, they go out right behind it.
+static void WriteSnapshotZones(const LightingState::Snapshot& snapshot)
+{
+	for (unsigned int i = 0; i < snapshot.zoneCount; i++) {
+		WriteZone(snapshot.zones[i].deviceType, snapshot.zones[i].zone, snapshot.zones[i].color);
+	}
+	frameCoalescer.Flush();
+}
+
+//The host converges in one packet instead of waiting for the game to draw every key again.
+//Older hosts get the state call by call.
+static void SendLightingState()
+{
+	if (artemisPipeClient.HasFeature(FEATURE_SNAPSHOT) && lightingState.SendSnapshot(WriteSnapshot)) {
+		lightingState.Replay(WriteSnapshotZones);
+		return;
+	}
+	lightingState.Replay(ReplayLighting);
+}
+
+//The host keeps every key until something replaces it, so a replay alone leaves whatever was set after
+//the save. Without a snapshot every key the host has takes the restored background, which is set or
+//cleared, before the saved state goes back on top.
+static void ClearAndReplayLighting(const LightingState::Snapshot& snapshot)
+{
+	const EffectColor background = snapshot.hasBackground ? snapshot.background : EffectColor{};
+	WriteTargetDevice(LOGI_DEVICETYPE_PERKEY_RGB);
+	WriteLighting(background);
+	WriteTargetDevice(LOGI_DEVICETYPE_ALL);
+	if (!effectEngine.SetBaseLighting(background)) {
+		WriteLighting(background);
+	}
+	ReplayLighting(snapshot);
+}
+
+//A running effect draws over the background, it takes the restored one as its base instead.
+static void RestoreEffectBase(const LightingState::Snapshot& snapshot)
+{
+	if (snapshot.hasBackground) {
+		effectEngine.SetBaseLighting(snapshot.background);
+	}
+}
+
+//The snapshot replaces the host's whole state in one frame. The original dll only gets calls,
+//so with the failover or the tee the state is cleared and replayed call by call.
+static bool RestoreSavedLighting()
+{
+	if (failover.IsActive() || originalDllTee.IsStarted() || !artemisPipeClient.HasFeature(FEATURE_SNAPSHOT)) {
+		return lightingState.Restore(ClearAndReplayLighting);
+	}
+
+	if (!lightingState.Restore(RestoreEffectBase)) {
+		return false;
+	}
+
+	if (lightingState.SendSnapshot(WriteSnapshot)) {
+		lightingState.Replay(WriteSnapshotZones);
+	}
+	else {
+		lightingState.Replay(ClearAndReplayLighting);
+	}
+	return true;
+}
+
+//Called by the client after it reopened the pipe.
+static void ResyncLighting()
+{
+	failover.Deactivate();
+	SendLightingState();
+}
+
+//Sends the whole lighting state as one frame once a throttled program's budget has recovered.
+static void ResumeIfThrottled()
+{
+	if (artemisPipeClient.TryEndThrottle()) {
+		lightingState.Replay(ReplayLighting);
+	}
+}
+
+//Past its rate budget a program only updates the lighting state, its calls are carried by the
+//frame sent when it resumes. The state has to be updated before asking.
+static bool IsThrottled()
+{
+	//the original dll has no budget
+	if (failover.IsActive() || !artemisPipeClient.IsThrottled()) {
+		return false;
+	}
+
+	ResumeIfThrottled();
+	return true;
+}
+
+static void SetLightingSink(LightingSink sink)
+{
+	{
+		std::lock_guard<std::mutex> lock(lightingSinkMutex);
+		lightingSink = sink;
+	}
+	lightingSinkCondition.notify_all();
+}
+
+//While Init is still resolving calls take the host's path, they only update the lighting state
+//and the client drops the packets. Whichever sink is picked gets the state in one go.
+static bool IsWrapping()
+{
+	const LightingSink sink = lightingSink;
+	return sink == LightingSink::Pending || sink == LightingSink::Artemis;
+}
+
+//Called by the flush thread, so the state also goes out after the game stopped calling. A game that
+//went quiet, or only repeats what is suppressed, still has its lighting sent once per keepalive interval.
+static void OnFlushTick()
+{
+	ResumeIfThrottled();
+
+	if (IsWrapping() && artemisPipeClient.TryTakeKeepalive()) {
+		SendLightingState();
+	}
+}
+
+//Called with the state locked, the sink switches once it has everything set so far.
+static void ReplayToOriginal(const LightingState::Snapshot& snapshot)
+{
+	originalDllWrapper.LogiLedSetTargetDevice(LOGI_DEVICETYPE_ALL);
+
+	if (snapshot.hasBackground) {
+		originalDllWrapper.LogiLedSetLighting(ByteToPercent(snapshot.background.red), ByteToPercent(snapshot.background.green), ByteToPercent(snapshot.background.blue));
+	}
+
+	if (snapshot.hasBitmap) {
+		//the original dll takes a mutable bitmap
+		unsigned char copy[LOGI_LED_BITMAP_SIZE];
+		memcpy(copy, snapshot.bitmap, LOGI_LED_BITMAP_SIZE);
+		originalDllWrapper.LogiLedSetLightingFromBitmap(copy);
+	}
+
+	for (unsigned int i = 0; i < snapshot.keyCount; i++) {
+		const LightingState::KeyOverride& key = snapshot.keys[i];
+		originalDllWrapper.SetLightingForKey(key.command, key.keyCode, ByteToPercent(key.color.red), ByteToPercent(key.color.green), ByteToPercent(key.color.blue));
+	}
+
+	for (unsigned int i = 0; i < snapshot.zoneCount; i++) {
+		const LightingState::ZoneOverride& zone = snapshot.zones[i];
+		originalDllWrapper.LogiLedSetLightingForTargetZone(zone.deviceType, zone.zone, ByteToPercent(zone.color.red), ByteToPercent(zone.color.green), ByteToPercent(zone.color.blue));
+	}
+
+	originalDllWrapper.LogiLedSetTargetDevice(snapshot.targetDevice);
+	SetLightingSink(LightingSink::Original);
+}
+
+//Runs what Init used to do on the game's thread: the pipe first, the original dll when there is no host.
+static void ResolveLightingSink()
+{
+	artemisPipeClient.Connect();
+
+	if (artemisPipeClient.IsConnected()) {
+		//with the tee the original dll already has everything when the host goes away
+		if (GetEnvironmentInt(TEE_ENV, 0)) {
+			originalDllTee.Start();
+		}
+		else if (GetEnvironmentInt(FAILOVER_ENV, 1)) {
+			failover.Start();
+		}
+
+		SetLightingSink(LightingSink::Artemis);
+		LOG(fmt::format("Connected to the host {} ms after Init", GetTickCount64() - resolveStartTick));
+		ResyncLighting();
+		return;
+	}
+
+	effectEngine.Stop();
+	frameCoalescer.Stop();
+
+	if (resolveCancelled) {
+		LOG("Shut down before the host was found, not loading the original dll");
+		lightingState.Clear();
+		SetLightingSink(LightingSink::None);
+		return;
+	}
+
+	LOG("Trying to load original dll...");
+
+	originalDllWrapper.LoadDll();
+
+	if (originalDllWrapper.IsDllLoaded() && originalDllWrapper.LogiLedInit()) {
+		lightingState.Replay(ReplayToOriginal);
+		lightingState.Clear();
+		LOG(fmt::format("Switched to the original dll {} ms after Init", GetTickCount64() - resolveStartTick));
+		return;
+	}
+
+	LOG("No host and no original dll, lighting calls will fail");
+	lightingState.Clear();
+	SetLightingSink(LightingSink::None);
+}
+
+//negative durations from the game count as LOGI_LED_DURATION_INFINITE
+static unsigned int ToMilliseconds(int ms)
+{
+	return ms < 0 ? LOGI_LED_DURATION_INFINITE : (unsigned int)ms;
+}
+
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
 {
 	switch (ul_reason_for_call)
@@ -53,73 +510,37 @@ bool LogiLedInitWithName(const char name[])
 	}
 
 	LOG("LogiLedInit Called");
-	if (program_name != ARTEMIS_EXE_NAME) {
-		artemisPipeClient.Connect();
-
-		if (artemisPipeClient.IsConnected()) {
-			unsigned int nameLength = (int)strlen(name) + 1;
-			const unsigned int command = LogiCommands::Init;
-			const unsigned int arraySize =
-				sizeof(arraySize) +
-				sizeof(command) +
-				nameLength;
-
-			std::vector<unsigned char> buff(arraySize, 0);
-			unsigned int buffPtr = 0;
-
-			memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-			buffPtr += sizeof(arraySize);
-
-			memcpy(&buff[buffPtr], &command, sizeof(command));
-			buffPtr += sizeof(command);
-
-			memcpy(&buff[buffPtr], name, nameLength);
-			buffPtr += nameLength;
-
-			artemisPipeClient.Write(buff.data(), arraySize);
-
-			isInitialized = true;
-			return true;
-		}
-	}
-	else {
+	if (program_name == ARTEMIS_EXE_NAME) {
 		LOG(fmt::format("Program name {} blacklisted.", program_name));
-	}
-
-	LOG("Trying to load original dll...");
 
-	originalDllWrapper.LoadDll();
+		//there is no host to wait for, the program gets the original dll's own answer
+		originalDllWrapper.LoadDll();
+		if (!originalDllWrapper.IsDllLoaded()) {
+			return false;
+		}
 
-	if (originalDllWrapper.IsDllLoaded()) {
 		isInitialized = true;
-		return originalDllWrapper.LogiLedInit();
+		const bool initialized = originalDllWrapper.LogiLedInit();
+		SetLightingSink(initialized ? LightingSink::Original : LightingSink::None);
+		return initialized;
 	}
-	isInitialized = false;
-	return false;
+
+	//the pipe and the original dll can take seconds, so the game gets a provisional success
+	resolveCancelled = false;
+	resolveStartTick = GetTickCount64();
+	SetLightingSink(LightingSink::Pending);
+	clientStartup.Start(name, program_name, ResolveLightingSink);
+
+	isInitialized = true;
+	return true;
 }
 
 
 bool LogiLedSetTargetDevice(int targetDevice)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetTargetDevice;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(targetDevice);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &targetDevice, sizeof(targetDevice));
-		buffPtr += sizeof(targetDevice);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		lightingState.SetTargetDevice(targetDevice);
+		WriteTargetDevice(targetDevice);
 		return true;
 	}
 
@@ -132,21 +553,8 @@ bool LogiLedSetTargetDevice(int targetDevice)
 
 bool LogiLedSaveCurrentLighting()
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SaveCurrentLighting;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		lightingState.Save();
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -157,30 +565,14 @@ bool LogiLedSaveCurrentLighting()
 
 bool LogiLedSetLighting(int redPercentage, int greenPercentage, int bluePercentage)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetLighting;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char);  //b
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		const EffectColor color = PercentToColor(redPercentage, greenPercentage, bluePercentage);
+		lightingState.SetLighting(color);
 
+		//a running effect shows the new color once it ends
+		if (!effectEngine.SetBaseLighting(color) && !IsThrottled()) {
+			WriteLighting(color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -191,22 +583,8 @@ bool LogiLedSetLighting(int redPercentage, int greenPercentage, int bluePercenta
 
 bool LogiLedRestoreLighting()
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::RestoreLighting;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		artemisPipeClient.Write(buff, arraySize);
-		return true;
+	if (IsWrapping()) {
+		return RestoreSavedLighting();
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
 		return originalDllWrapper.LogiLedRestoreLighting();
@@ -216,38 +594,11 @@ bool LogiLedRestoreLighting()
 
 bool LogiLedFlashLighting(int redPercentage, int greenPercentage, int bluePercentage, int milliSecondsDuration, int milliSecondsInterval)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::FlashLighting;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char) + //b
-			sizeof(milliSecondsDuration) +
-			sizeof(milliSecondsInterval);
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		memcpy(&buff[buffPtr], &milliSecondsDuration, sizeof(milliSecondsDuration));
-		buffPtr += sizeof(milliSecondsDuration);
-
-		memcpy(&buff[buffPtr], &milliSecondsInterval, sizeof(milliSecondsInterval));
-		buffPtr += sizeof(milliSecondsInterval);
-
-		artemisPipeClient.Write(buff, arraySize);
-
+	if (IsWrapping()) {
+		effectEngine.FlashLighting(
+			PercentToColor(redPercentage, greenPercentage, bluePercentage),
+			ToMilliseconds(milliSecondsDuration),
+			ToMilliseconds(milliSecondsInterval));
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -258,38 +609,11 @@ bool LogiLedFlashLighting(int redPercentage, int greenPercentage, int bluePercen
 
 bool LogiLedPulseLighting(int redPercentage, int greenPercentage, int bluePercentage, int milliSecondsDuration, int milliSecondsInterval)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::PulseLighting;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char) + //b
-			sizeof(milliSecondsDuration) +
-			sizeof(milliSecondsInterval);
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		memcpy(&buff[buffPtr], &milliSecondsDuration, sizeof(milliSecondsDuration));
-		buffPtr += sizeof(milliSecondsDuration);
-
-		memcpy(&buff[buffPtr], &milliSecondsInterval, sizeof(milliSecondsInterval));
-		buffPtr += sizeof(milliSecondsInterval);
-
-		artemisPipeClient.Write(buff, arraySize);
-
+	if (IsWrapping()) {
+		effectEngine.PulseLighting(
+			PercentToColor(redPercentage, greenPercentage, bluePercentage),
+			ToMilliseconds(milliSecondsDuration),
+			ToMilliseconds(milliSecondsInterval));
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -300,21 +624,8 @@ bool LogiLedPulseLighting(int redPercentage, int greenPercentage, int bluePercen
 
 bool LogiLedStopEffects()
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::StopEffects;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		effectEngine.StopEffects();
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -326,26 +637,15 @@ bool LogiLedStopEffects()
 
 bool LogiLedSetLightingFromBitmap(unsigned char bitmap[])
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetLightingFromBitmap;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			LOGI_LED_BITMAP_SIZE;
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], bitmap, LOGI_LED_BITMAP_SIZE);
-		buffPtr += LOGI_LED_BITMAP_SIZE;
+	if (IsWrapping()) {
+		if (!IsPerKeyTargeted()) {
+			return true;
+		}
 
-		artemisPipeClient.Write(buff, arraySize);
+		lightingState.SetBitmap(bitmap);
+		if (!IsThrottled()) {
+			WriteBitmap(bitmap);
+		}
 		return true;
 	}
 
@@ -357,34 +657,16 @@ bool LogiLedSetLightingFromBitmap(unsigned char bitmap[])
 
 bool LogiLedSetLightingForKeyWithScanCode(int keyCode, int redPercentage, int greenPercentage, int bluePercentage)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetLightingForKeyWithScanCode;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(keyCode) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char);  //b
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyCode, sizeof(keyCode));
-		buffPtr += sizeof(keyCode);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		if (!IsPerKeyTargeted()) {
+			return true;
+		}
 
+		const EffectColor color = PercentToColor(redPercentage, greenPercentage, bluePercentage);
+		lightingState.SetKey(LogiCommands::SetLightingForKeyWithScanCode, keyCode, color);
+		if (!IsThrottled()) {
+			WriteKey(LogiCommands::SetLightingForKeyWithScanCode, keyCode, color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -395,34 +677,16 @@ bool LogiLedSetLightingForKeyWithScanCode(int keyCode, int redPercentage, int gr
 
 bool LogiLedSetLightingForKeyWithHidCode(int keyCode, int redPercentage, int greenPercentage, int bluePercentage)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetLightingForKeyWithHidCode;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(keyCode) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char);  //b
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyCode, sizeof(keyCode));
-		buffPtr += sizeof(keyCode);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		if (!IsPerKeyTargeted()) {
+			return true;
+		}
 
+		const EffectColor color = PercentToColor(redPercentage, greenPercentage, bluePercentage);
+		lightingState.SetKey(LogiCommands::SetLightingForKeyWithHidCode, keyCode, color);
+		if (!IsThrottled()) {
+			WriteKey(LogiCommands::SetLightingForKeyWithHidCode, keyCode, color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -433,34 +697,16 @@ bool LogiLedSetLightingForKeyWithHidCode(int keyCode, int redPercentage, int gre
 
 bool LogiLedSetLightingForKeyWithQuartzCode(int keyCode, int redPercentage, int greenPercentage, int bluePercentage)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetLightingForKeyWithQuartzCode;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(keyCode) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char);  //b
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyCode, sizeof(keyCode));
-		buffPtr += sizeof(keyCode);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		if (!IsPerKeyTargeted()) {
+			return true;
+		}
 
+		const EffectColor color = PercentToColor(redPercentage, greenPercentage, bluePercentage);
+		lightingState.SetKey(LogiCommands::SetLightingForKeyWithQuartzCode, keyCode, color);
+		if (!IsThrottled()) {
+			WriteKey(LogiCommands::SetLightingForKeyWithQuartzCode, keyCode, color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -471,34 +717,18 @@ bool LogiLedSetLightingForKeyWithQuartzCode(int keyCode, int redPercentage, int
 
 bool LogiLedSetLightingForKeyWithKeyName(LogiLed::KeyName keyName, int redPercentage, int greenPercentage, int bluePercentage)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SetLightingForKeyWithKeyName;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::KeyName) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char);  //b
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyName, sizeof(keyName));
-		buffPtr += sizeof(keyName);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
+	if (IsWrapping()) {
+		if (!IsPerKeyTargeted()) {
+			return true;
+		}
 
-		artemisPipeClient.Write(buff, arraySize);
+		const EffectColor color = PercentToColor(redPercentage, greenPercentage, bluePercentage);
+		lightingState.SetKey(LogiCommands::SetLightingForKeyWithKeyName, keyName, color);
 
+		//a running effect shows the new color once it ends
+		if (!effectEngine.SetBaseKey(keyName, color) && !IsThrottled()) {
+			WriteKey(LogiCommands::SetLightingForKeyWithKeyName, keyName, color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -509,25 +739,8 @@ bool LogiLedSetLightingForKeyWithKeyName(LogiLed::KeyName keyName, int redPercen
 
 bool LogiLedSaveLightingForKey(LogiLed::KeyName keyName)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::SaveLightingForKey;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::KeyName);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyName, sizeof(keyName));
-		buffPtr += sizeof(keyName);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		lightingState.SaveKey(keyName);
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -538,25 +751,15 @@ bool LogiLedSaveLightingForKey(LogiLed::KeyName keyName)
 
 bool LogiLedRestoreLightingForKey(LogiLed::KeyName keyName)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::RestoreLightingForKey;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::KeyName);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyName, sizeof(keyName));
-		buffPtr += sizeof(keyName);
+	if (IsWrapping()) {
+		EffectColor color;
+		if (!lightingState.RestoreKey(keyName, color)) {
+			return false;
+		}
 
-		artemisPipeClient.Write(buff, arraySize);
+		if (!effectEngine.SetBaseKey(keyName, color) && !IsThrottled()) {
+			WriteKey(LogiCommands::SetLightingForKeyWithKeyName, keyName, color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -570,30 +773,14 @@ bool LogiLedExcludeKeysFromBitmap(LogiLed::KeyName* keyList, int listCount)
 	if (listCount == 0)
 		return false;
 
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::ExcludeKeysFromBitmap;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(listCount) + 
-			sizeof(LogiLed::KeyName) * listCount;
-
-		std::vector<unsigned char> buff(arraySize, 0);
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &listCount, sizeof(listCount));
-		buffPtr += sizeof(listCount);
-
-		memcpy(&buff[buffPtr], keyList, sizeof(LogiLed::KeyName) * listCount);
-		buffPtr += sizeof(LogiLed::KeyName) * listCount;
-
-		artemisPipeClient.Write(buff.data(), arraySize);
+	if (IsWrapping()) {
+		lightingState.ExcludeKeys(keyList, listCount);
+		frameCoalescer.Flush();
+		artemisPipeClient.ExcludeKeysFromBitmap(keyList, listCount);
+		originalDllTee.ExcludeKeys(keyList, listCount);
+		if (Failover::OriginalCall original{ failover }) {
+			originalDllWrapper.LogiLedExcludeKeysFromBitmap(keyList, listCount);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -605,42 +792,12 @@ bool LogiLedExcludeKeysFromBitmap(LogiLed::KeyName* keyList, int listCount)
 
 bool LogiLedFlashSingleKey(LogiLed::KeyName keyName, int redPercentage, int greenPercentage, int bluePercentage, int msDuration, int msInterval)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::FlashSingleKey;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::KeyName) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char) + //b
-			sizeof(msDuration) +
-			sizeof(msInterval);
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyName, sizeof(keyName));
-		buffPtr += sizeof(keyName);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		memcpy(&buff[buffPtr], &msDuration, sizeof(msDuration));
-		buffPtr += sizeof(msDuration);
-
-		memcpy(&buff[buffPtr], &msInterval, sizeof(msInterval));
-		buffPtr += sizeof(msInterval);
-
-		artemisPipeClient.Write(buff, arraySize);
-
+	if (IsWrapping()) {
+		effectEngine.FlashKey(
+			keyName,
+			PercentToColor(redPercentage, greenPercentage, bluePercentage),
+			ToMilliseconds(msDuration),
+			ToMilliseconds(msInterval));
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -651,49 +808,13 @@ bool LogiLedFlashSingleKey(LogiLed::KeyName keyName, int redPercentage, int gree
 
 bool LogiLedPulseSingleKey(LogiLed::KeyName keyName, int startRedPercentage, int startGreenPercentage, int startBluePercentage, int finishRedPercentage, int finishGreenPercentage, int finishBluePercentage, int msDuration, bool isInfinite)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::PulseSingleKey;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::KeyName) +
-			sizeof(unsigned char) + //r start
-			sizeof(unsigned char) + //g start
-			sizeof(unsigned char) + //b start
-			sizeof(unsigned char) + //r end
-			sizeof(unsigned char) + //g end
-			sizeof(unsigned char) + //b end
-			sizeof(msDuration) +
-			sizeof(isInfinite);
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyName, sizeof(keyName));
-		buffPtr += sizeof(keyName);
-
-		buff[buffPtr++] = (unsigned char)((double)startRedPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)startGreenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)startBluePercentage / 100.0 * 255.0);
-
-		buff[buffPtr++] = (unsigned char)((double)finishRedPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)finishGreenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)finishBluePercentage / 100.0 * 255.0);
-
-		memcpy(&buff[buffPtr], &msDuration, sizeof(msDuration));
-		buffPtr += sizeof(msDuration);
-
-		memcpy(&buff[buffPtr], &isInfinite, sizeof(isInfinite));
-		buffPtr += sizeof(isInfinite);
-
-		artemisPipeClient.Write(buff, arraySize);
-
+	if (IsWrapping()) {
+		effectEngine.PulseKey(
+			keyName,
+			PercentToColor(startRedPercentage, startGreenPercentage, startBluePercentage),
+			PercentToColor(finishRedPercentage, finishGreenPercentage, finishBluePercentage),
+			ToMilliseconds(msDuration),
+			isInfinite);
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -704,25 +825,8 @@ bool LogiLedPulseSingleKey(LogiLed::KeyName keyName, int startRedPercentage, int
 
 bool LogiLedStopEffectsOnKey(LogiLed::KeyName keyName)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::StopEffectsOnKey;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::KeyName);
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &keyName, sizeof(keyName));
-		buffPtr += sizeof(keyName);
-
-		artemisPipeClient.Write(buff, arraySize);
+	if (IsWrapping()) {
+		effectEngine.StopEffectsOnKey(keyName);
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -734,38 +838,12 @@ bool LogiLedStopEffectsOnKey(LogiLed::KeyName keyName)
 
 bool LogiLedSetLightingForTargetZone(LogiLed::DeviceType deviceType, int zone, int redPercentage, int greenPercentage, int bluePercentage)
 {
-	if (artemisPipeClient.IsConnected()) {
-		const unsigned int command = LogiCommands::FlashSingleKey;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			sizeof(LogiLed::DeviceType) +
-			sizeof(zone) +
-			sizeof(unsigned char) + //r
-			sizeof(unsigned char) + //g
-			sizeof(unsigned char);  //b
-
-		unsigned char buff[arraySize] = { 0 };
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
-
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
-
-		memcpy(&buff[buffPtr], &deviceType, sizeof(deviceType));
-		buffPtr += sizeof(deviceType);
-
-		memcpy(&buff[buffPtr], &zone, sizeof(zone));
-		buffPtr += sizeof(zone);
-
-		buff[buffPtr++] = (unsigned char)((double)redPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)greenPercentage / 100.0 * 255.0);
-		buff[buffPtr++] = (unsigned char)((double)bluePercentage / 100.0 * 255.0);
-
-		artemisPipeClient.Write(buff, arraySize);
-
+	if (IsWrapping()) {
+		const EffectColor color = PercentToColor(redPercentage, greenPercentage, bluePercentage);
+		lightingState.SetZone(deviceType, zone, color);
+		if (!IsThrottled()) {
+			WriteZone(deviceType, zone, color);
+		}
 		return true;
 	}
 	if (originalDllWrapper.IsDllLoaded()) {
@@ -782,34 +860,29 @@ void LogiLedShutdown()
 
 	LOG("LogiLedShutdown called");
 
-	if (artemisPipeClient.IsConnected()) {
-		LOG("Informing artemis and closing pipe...");
-
-		const char* c_str = program_name.c_str();
-		unsigned int strLength = (int)strlen(c_str) + 1;
-		const unsigned int command = LogiCommands::Shutdown;
-		const unsigned int arraySize =
-			sizeof(arraySize) +
-			sizeof(command) +
-			strLength;
-
-		std::vector<unsigned char> buff(arraySize, 0);
-		unsigned int buffPtr = 0;
-
-		memcpy(&buff[buffPtr], &arraySize, sizeof(arraySize));
-		buffPtr += sizeof(arraySize);
+	//the game may shut down before Init has resolved, the wait is at most one connection attempt
+	resolveCancelled = true;
+	{
+		std::unique_lock<std::mutex> lock(lightingSinkMutex);
+		lightingSinkCondition.wait(lock, [] { return lightingSink != LightingSink::Pending; });
+	}
 
-		memcpy(&buff[buffPtr], &command, sizeof(command));
-		buffPtr += sizeof(command);
+	if (lightingSink == LightingSink::Artemis) {
+		LOG("Informing artemis and closing pipe...");
+		failover.Stop();
+		originalDllTee.Stop();
+		effectEngine.Stop();
+		frameCoalescer.Stop();
 
-		memcpy(&buff[buffPtr], c_str, strLength);
-		buffPtr += strLength;
+		PacketSegment payload = { program_name.c_str(), (unsigned int)program_name.length() + 1 };
 
-		artemisPipeClient.Write(buff.data(), arraySize);
+		WritePacket(LogiCommands::Shutdown, &payload, 1);
 
 		artemisPipeClient.Disconnect();
+		lightingState.Clear();
 	}
 
+	SetLightingSink(LightingSink::None);
 	isInitialized = false;
 	return;
 }
@@ -8,6 +8,12 @@
 #define PCH_H
 
 // add headers that you want to pre-compile here
+// The client core only needs the standard library, so it also builds on Linux. windows.h is for the
+// dll entry points, the original dll and the Windows transports, which are only built on Windows.
+#include <string.h>
+#include <string>
+#ifdef _WIN32
 #include "framework.h"
+#endif
 
 #endif //PCH_H